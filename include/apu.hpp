@@ -0,0 +1,139 @@
+#pragma once
+#include "blip_buffer.hpp"
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class Scheduler;
+class StateWriter;
+class StateReader;
+
+// Audio processing unit: two square channels (the first with a frequency
+// sweep), the wave channel and the noise channel, registers 0xFF10-0xFF3F.
+//
+// The APU is run lazily, like the timer: nothing happens per CPU cycle.
+// Register accesses and endFrame() bring it up to the scheduler's current
+// time, running each channel from one waveform step to the next and the
+// 512 Hz frame sequencer (length, sweep, envelope) between them. Whenever a
+// channel's output level changes, the change goes into a BlipBuffer at the
+// exact cycle it happened, which turns the steps into band-limited samples
+// at SAMPLE_RATE.
+//
+// Samples are only synthesized while a sample callback is set; without one
+// (batch runs, benchmarks) the APU only keeps its registers and status
+// right.
+class APU {
+public:
+    static constexpr uint32_t CLOCK_RATE = 4194304;  // CPU cycles per second
+    static constexpr uint32_t SAMPLE_RATE = 48000;
+
+    // Receives interleaved stereo samples (left, right) as they're produced
+    using SampleCallback = std::function<void(const int16_t* samples, size_t frames)>;
+
+    APU();
+
+    // The scheduler is only used as the clock; the APU posts no events
+    void setScheduler(Scheduler* scheduler_ptr) { scheduler = scheduler_ptr; }
+
+    uint8_t readRegister(uint16_t address);
+    void writeRegister(uint16_t address, uint8_t value);
+
+    // Run the channels and frame sequencer up to the given CPU cycle
+    void sync(uint64_t now);
+
+    // Setting a callback starts synthesis from the current time; an empty
+    // one stops it
+    void setSampleCallback(SampleCallback callback);
+
+    // Hand everything synthesized up to `now` to the sample callback. Also
+    // happens on its own every FLUSH_CYCLES, so long runs don't pile up
+    void endFrame(uint64_t now);
+
+    // Run-ahead support: while output is suspended nothing is synthesized
+    // and the blip buffers are left alone, even across loaded states. Resuming
+    // at the time output was suspended carries on without a discontinuity
+    void suspendOutput();
+    void resumeOutput();
+    
+    // All channels off, sound still powered, registers cleared. For save
+    // states from before the APU existed
+    void reset();
+
+    // Save state support (see savestate.hpp)
+    void saveState(StateWriter& writer) const;
+    void loadState(StateReader& reader);
+
+private:
+    static constexpr uint64_t FRAME_SEQUENCER_PERIOD = CLOCK_RATE / 512;
+    static constexpr uint64_t FLUSH_CYCLES = 65536;  // Longest stretch kept in the blip buffers
+
+    struct Channel {
+        bool enabled = false;        // NR52 status bit
+        uint16_t length = 0;         // Length counter, the channel stops when it runs out
+        uint64_t next_step = 0;      // CPU cycle of the next waveform step
+        uint8_t position = 0;        // Duty step (0-7) or wave sample (0-31)
+        uint8_t volume = 0;          // Envelope volume (0-15)
+        uint8_t envelope_timer = 0;  // Frame sequencer ticks to the next envelope step
+        uint8_t output = 0;          // Current digital output (0-15)
+        int32_t left = 0;            // Level last sent to each blip buffer
+        int32_t right = 0;
+    };
+
+    Scheduler* scheduler = nullptr;
+    uint64_t now() const;
+
+    // 0xFF10-0xFF3F as last written (wave RAM at 0x20). Channel settings
+    // are read straight from here
+    std::array<uint8_t, 0x30> regs{};
+    std::array<Channel, 4> channels;
+
+    uint64_t last_sync = 0;            // CPU cycle everything has been run up to
+    uint8_t frame_sequencer_step = 0;  // Next of the 8 frame sequencer steps
+
+    // Square 1 sweep
+    uint16_t shadow_frequency = 0;
+    uint8_t sweep_timer = 0;
+    bool sweep_enabled = false;
+
+    uint16_t lfsr = 0x7FFF;  // Noise shift register
+
+    // Output side. Not machine state: rebuilt from the channel outputs
+    // whenever synthesis starts or a state is loaded
+    SampleCallback sample_callback;
+    BlipBuffer blip_left;
+    BlipBuffer blip_right;
+    uint64_t frame_start = 0;  // CPU cycle the blip buffers' current frame starts at
+    std::vector<int16_t> samples;
+    bool output_suspended = false;
+    
+    bool isSynthesizing() const { return sample_callback && !output_suspended; }
+
+    bool isPowered() const { return (regs[0x16] & 0x80) != 0; }
+
+    // Channel settings decoded from the registers
+    bool isDACEnabled(int channel) const;
+    uint16_t getFrequency(int channel) const;
+    uint32_t getPeriod(int channel) const;  // CPU cycles per waveform step, 0 = stopped
+    uint8_t digitalOutput(int channel) const;
+
+    // Run one channel's waveform to `to` (inclusive)
+    void runChannel(int channel, uint64_t to);
+
+    void trigger(int channel, uint64_t time);
+    void clockFrameSequencer(uint64_t time);
+    void clockLength();
+    void clockSweep();
+    void clockEnvelope();
+    uint16_t calculateSweep() const;
+    void powerOff(uint64_t time);
+
+    // Refresh a channel's output level at `time`, and its contribution to
+    // the mix if that changed (mix() also applies NR50/NR51 changes)
+    void updateOutput(int channel, uint64_t time);
+    void mix(int channel, uint64_t time);
+
+    // Start the blip buffers afresh from the current channel outputs
+    void restartOutput();
+    void flushSamples();
+};
@@ -0,0 +1,42 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Single-producer, single-consumer queue of interleaved stereo samples
+// between the emulation loop (producer) and the audio device callback
+// (consumer). Lock-free: each side only writes its own index, so the audio
+// thread never waits on the emulator and can't be stalled by it.
+//
+// A full queue drops what doesn't fit (turbo produces audio faster than it
+// is played); an empty one leaves the consumer to pad with silence.
+class AudioRing {
+public:
+    // Capacity in stereo frames, rounded up to a power of two
+    explicit AudioRing(size_t capacity_frames);
+
+    AudioRing(const AudioRing&) = delete;
+    AudioRing& operator=(const AudioRing&) = delete;
+
+    // Producer side. Returns the number of frames queued
+    size_t push(const int16_t* samples, size_t frames);
+
+    // Consumer side. Returns the number of frames copied into out
+    size_t pop(int16_t* out, size_t frames);
+
+    // Frames queued right now (only a snapshot when called from the producer)
+    size_t available() const {
+        return write_pos.load(std::memory_order_acquire) - read_pos.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+private:
+    std::vector<int16_t> buffer;  // Two samples per frame
+    size_t mask;
+
+    // Free-running frame counters, each on its own cache line
+    alignas(64) std::atomic<size_t> write_pos{0};
+    alignas(64) std::atomic<size_t> read_pos{0};
+};
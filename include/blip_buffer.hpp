@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Band-limited synthesis buffer, after Shay Green's blip_buf.
+//
+// Instead of sampling the APU output once per output sample (which aliases
+// badly - square waves at 4 MHz resolution folded down to 48 kHz), the APU
+// reports every change of its output level as a delta at the CPU cycle it
+// happened. Each delta is added to the buffer as a band-limited step: a
+// windowed-sinc impulse placed at the exact sub-sample position, which
+// readSamples() later integrates back into a waveform. Deltas within a frame
+// can be added in any order, so each channel can be run on its own.
+class BlipBuffer {
+public:
+    // Rates are in Hz: the clock deltas are timed in and the output sample
+    // rate. max_frame_clocks is the longest frame endFrame() will be given
+    BlipBuffer(uint32_t clock_rate, uint32_t sample_rate, uint32_t max_frame_clocks);
+
+    // Drop all samples and deltas, and reset the high-pass filter
+    void clear();
+
+    // Add a step of `delta` at `time` clocks from the start of the current
+    // frame. time must not be past the end of the frame being built
+    void addDelta(uint32_t time, int32_t delta) {
+        uint64_t fixed = static_cast<uint64_t>(time) * factor + offset;
+        int32_t* out = buffer.data() + (fixed >> FRAC_BITS);
+        const int16_t* taps = kernel[(fixed >> (FRAC_BITS - PHASE_BITS)) & (PHASES - 1)];
+        for (int i = 0; i < WIDTH; i++) {
+            out[i] += taps[i] * delta;
+        }
+    }
+
+    // End the current frame `time` clocks after it started. Its samples
+    // become available to readSamples() and the next frame starts there
+    void endFrame(uint32_t time);
+
+    size_t samplesAvailable() const { return static_cast<size_t>(offset >> FRAC_BITS); }
+
+    // Read up to count samples, stride apart in out (2 to interleave stereo),
+    // scaled by gain. Returns the number read
+    size_t readSamples(int16_t* out, size_t count, size_t stride, int32_t gain);
+
+private:
+    static constexpr int FRAC_BITS = 32;    // Fixed-point fraction of a sample position
+    static constexpr int PHASE_BITS = 6;
+    static constexpr int PHASES = 1 << PHASE_BITS;  // Sub-sample positions of the kernel
+    static constexpr int WIDTH = 16;        // Kernel taps; also the output delay in samples
+    static constexpr int KERNEL_BITS = 15;  // Kernel taps of a phase sum to 1 << KERNEL_BITS
+    static constexpr int BASS_SHIFT = 9;    // High-pass (DC removal) strength, ~15 Hz at 48 kHz
+
+    static void makeKernel(int16_t (*taps)[WIDTH]);
+
+    const int16_t (*kernel)[WIDTH];  // Impulse per phase, shared by all buffers
+    uint64_t factor;      // Output samples per clock, as a FRAC_BITS fixed-point number
+    uint64_t offset = 0;  // Position of the current frame's start, same format
+    int32_t integrator = 0;
+    std::vector<int32_t> buffer;  // Impulses not read yet, plus WIDTH samples of kernel tail
+};
@@ -5,6 +5,10 @@
 #include <unordered_map>
 #include <memory>
 #include <fstream>
+#include "rom_image.hpp"
+
+class StateWriter;
+class StateReader;
 
 struct CartridgeHeader {
     uint8_t entryPoint[4];          // 0x100-0x103 
@@ -27,7 +31,18 @@ class MBC {
 public:
     virtual ~MBC() = default;
     
-    virtual uint8_t read(uint16_t addr) const = 0;
+    // Reads through the cached bank windows are a single indexed load.
+    // Addresses whose window isn't mapped go to readUnmapped()
+    uint8_t read(uint16_t addr) const {
+        if (addr < 0x4000) {
+            if (rom0_window) return rom0_window[addr];
+        } else if (addr < 0x8000) {
+            if (romN_window) return romN_window[addr - 0x4000];
+        } else if (addr >= 0xA000 && addr < 0xC000) {
+            if (ram_window) return ram_window[addr - 0xA000];
+        }
+        return readUnmapped(addr);
+    }
     virtual void write(uint16_t addr, uint8_t value) = 0;
     
     // Save RAM to file if battery-backed
@@ -38,18 +53,57 @@ public:
     
     // Check if this MBC has battery-backed RAM
     virtual bool hasBattery() const { return false; }
+    
+    // Save state support for the banking registers (RAM contents are saved
+    // by the Cartridge)
+    virtual void saveState(StateWriter& writer) const = 0;
+    virtual void loadState(StateReader& reader) = 0;
+    
+    // Host pointers for the currently mapped banks, used by the MemoryBus page
+    // table. Each is nullptr when the window can't be served by a plain
+    // pointer (bank out of range, RAM disabled, RTC registers, MBC2 nibble RAM),
+    // in which case the bus falls back to read()/write()
+    const uint8_t* getRomBank0() const { return rom0_window; }   // 16KB at 0x0000
+    const uint8_t* getRomBankN() const { return romN_window; }   // 16KB at 0x4000
+    uint8_t* getRamBank() const { return ram_window; }           // 8KB at 0xA000
+    
+protected:
+    // Everything the windows don't cover, worked out from the registers
+    virtual uint8_t readUnmapped(uint16_t addr) const = 0;
+    
+    // Recompute the windows from the banking registers. Each MBC calls it
+    // from its constructor, loadState() and every register write
+    virtual void updateBanks() = 0;
+    
+    // Pointer to a full bank-sized window of a buffer, or nullptr if it doesn't fit
+    static const uint8_t* romWindow(const RomImage& rom, uint32_t start) {
+        return start + 0x4000 <= rom.size() ? rom.data() + start : nullptr;
+    }
+    static uint8_t* ramWindow(std::vector<uint8_t>& ram, uint32_t start) {
+        return start + 0x2000 <= ram.size() ? ram.data() + start : nullptr;
+    }
+    
+    // The cached bank windows (see getRomBank0() and friends)
+    const uint8_t* rom0_window = nullptr;
+    const uint8_t* romN_window = nullptr;
+    uint8_t* ram_window = nullptr;
 };
 
 // No MBC (ROM only) implementation
 class ROMOnly : public MBC {
 public:
-    ROMOnly(const std::vector<uint8_t>& rom_data, std::vector<uint8_t>& ram);
+    ROMOnly(const RomImage& rom_data, std::vector<uint8_t>& ram);
     
-    uint8_t read(uint16_t addr) const override;
     void write(uint16_t addr, uint8_t value) override;
+    void saveState(StateWriter& writer) const override;
+    void loadState(StateReader& reader) override;
+    
+protected:
+    uint8_t readUnmapped(uint16_t addr) const override;
+    void updateBanks() override;
     
 private:
-    const std::vector<uint8_t>& rom;
+    const RomImage& rom;
     std::vector<uint8_t>& ram;
     bool ram_enabled = false;
 };
@@ -57,17 +111,22 @@ private:
 // MBC1 implementation (up to 2MB ROM, 32KB RAM)
 class MBC1 : public MBC {
 public:
-    MBC1(const std::vector<uint8_t>& rom_data, std::vector<uint8_t>& ram, bool has_battery, bool is_multicart = false);
+    MBC1(const RomImage& rom_data, std::vector<uint8_t>& ram, bool has_battery, bool is_multicart = false);
     
-    uint8_t read(uint16_t addr) const override;
     void write(uint16_t addr, uint8_t value) override;
+    void saveState(StateWriter& writer) const override;
+    void loadState(StateReader& reader) override;
     
     bool saveRAM(const std::string& save_path) const override;
     bool loadRAM(const std::string& save_path) override;
     bool hasBattery() const override { return battery; }
     
+protected:
+    uint8_t readUnmapped(uint16_t addr) const override;
+    void updateBanks() override;
+    
 private:
-    const std::vector<uint8_t>& rom;
+    const RomImage& rom;
     std::vector<uint8_t>& ram;
     bool ram_enabled = false;
     uint8_t rom_bank = 1;          // 5-bit register, 0 is treated as 1
@@ -83,17 +142,23 @@ private:
 // MBC2 implementation (up to 256KB ROM, 512x4 bits RAM)
 class MBC2 : public MBC {
 public:
-    MBC2(const std::vector<uint8_t>& rom_data, std::vector<uint8_t>& ram, bool has_battery);
+    MBC2(const RomImage& rom_data, std::vector<uint8_t>& ram, bool has_battery);
     
-    uint8_t read(uint16_t addr) const override;
     void write(uint16_t addr, uint8_t value) override;
+    void saveState(StateWriter& writer) const override;
+    void loadState(StateReader& reader) override;
     
     bool saveRAM(const std::string& save_path) const override;
     bool loadRAM(const std::string& save_path) override;
     bool hasBattery() const override { return battery; }
     
+protected:
+    // The 512x4 bit RAM is never mapped, so it always ends up here
+    uint8_t readUnmapped(uint16_t addr) const override;
+    void updateBanks() override;
+    
 private:
-    const std::vector<uint8_t>& rom;
+    const RomImage& rom;
     std::vector<uint8_t>& ram;     // 512x4 bits RAM
     bool ram_enabled = false;
     uint8_t rom_bank = 1;          // 4-bit register, 0 is treated as 1
@@ -103,17 +168,23 @@ private:
 // MBC3 implementation (up to 2MB ROM, 32KB RAM, RTC)
 class MBC3 : public MBC {
 public:
-    MBC3(const std::vector<uint8_t>& rom_data, std::vector<uint8_t>& ram, bool has_battery, bool has_rtc);
+    MBC3(const RomImage& rom_data, std::vector<uint8_t>& ram, bool has_battery, bool has_rtc);
     
-    uint8_t read(uint16_t addr) const override;
     void write(uint16_t addr, uint8_t value) override;
+    void saveState(StateWriter& writer) const override;
+    void loadState(StateReader& reader) override;
     
     bool saveRAM(const std::string& save_path) const override;
     bool loadRAM(const std::string& save_path) override;
     bool hasBattery() const override { return battery; }
     
+protected:
+    // RTC registers (banks 0x08-0x0C) are never mapped and end up here
+    uint8_t readUnmapped(uint16_t addr) const override;
+    void updateBanks() override;
+    
 private:
-    const std::vector<uint8_t>& rom;
+    const RomImage& rom;
     std::vector<uint8_t>& ram;
     bool ram_enabled = false;
     uint8_t rom_bank = 1;          // 7-bit register, 0 is treated as 1
@@ -146,17 +217,22 @@ private:
 // MBC5 implementation (up to 8MB ROM, 128KB RAM)
 class MBC5 : public MBC {
 public:
-    MBC5(const std::vector<uint8_t>& rom_data, std::vector<uint8_t>& ram, bool has_battery, bool has_rumble);
+    MBC5(const RomImage& rom_data, std::vector<uint8_t>& ram, bool has_battery, bool has_rumble);
     
-    uint8_t read(uint16_t addr) const override;
     void write(uint16_t addr, uint8_t value) override;
+    void saveState(StateWriter& writer) const override;
+    void loadState(StateReader& reader) override;
     
     bool saveRAM(const std::string& save_path) const override;
     bool loadRAM(const std::string& save_path) override;
     bool hasBattery() const override { return battery; }
     
+protected:
+    uint8_t readUnmapped(uint16_t addr) const override;
+    void updateBanks() override;
+    
 private:
-    const std::vector<uint8_t>& rom;
+    const RomImage& rom;
     std::vector<uint8_t>& ram;
     bool ram_enabled = false;
     uint16_t rom_bank = 1;         // 9-bit register (0-511)
@@ -167,13 +243,27 @@ private:
 
 class Cartridge {
     public:
-        explicit Cartridge(const std::string& romPath);
+        // With persist_ram off, battery RAM is neither loaded from nor written
+        // back to the .sav file (batch runs need every run to start the same)
+        explicit Cartridge(const std::string& romPath, bool persist_ram = true);
+        
+        // ROM image already in memory (generated test ROMs). There is no .sav file
+        explicit Cartridge(std::vector<uint8_t> rom_data);
         ~Cartridge();
         
         bool loadFromFile(const std::string& romPath);
+        bool loadFromData(std::vector<uint8_t> data);
+        
+        // False if the ROM couldn't be loaded
+        bool isLoaded() const { return mbc != nullptr; }
 
         uint8_t read(uint16_t addr) const;
         void write(uint16_t addr, uint8_t value);
+        
+        // Currently mapped banks as host pointers (nullptr = use read()/write())
+        const uint8_t* getRomBank0() const { return mbc ? mbc->getRomBank0() : nullptr; }
+        const uint8_t* getRomBankN() const { return mbc ? mbc->getRomBankN() : nullptr; }
+        uint8_t* getRamBank() const { return mbc ? mbc->getRamBank() : nullptr; }
 
         const CartridgeHeader& getHeader() const { return header; }
         std::string getPublisherName() const;
@@ -181,6 +271,9 @@ class Cartridge {
 
         uint32_t getROMSize() const;
         uint32_t getRAMSize() const;
+        
+        // CRC-32 of the whole ROM image, identifies the exact dump a movie was recorded on
+        uint32_t getROMHash() const { return rom ? rom->crc32() : 0; }
 
         // Get the title of the ROM
         std::string getTitle() const {
@@ -196,13 +289,19 @@ class Cartridge {
         // Check if cartridge has battery
         bool hasBattery() const;
         
+        // Save state support (see savestate.hpp): cartridge RAM and MBC registers
+        void saveState(StateWriter& writer) const;
+        void loadState(StateReader& reader);
+        
     private:
         CartridgeHeader header;
-        std::vector<uint8_t> rom;
+        std::shared_ptr<const RomImage> rom;  // Shared with other Cartridges on the same file
         std::vector<uint8_t> ram;
         std::unique_ptr<MBC> mbc;
         std::string rom_path;  // Keep the ROM path for save files
+        bool persist_ram = true;
         
+        bool loadImage(std::shared_ptr<const RomImage> image);
         void initializeRAM();
         void createMBC();
         
@@ -1,20 +1,55 @@
 #pragma once
 #include "memory.hpp"
-#include "instructions.hpp"
+#include <algorithm>
+#include <array>
 #include <cstdint>
 
+class StateWriter;
+class StateReader;
+
 class CPU {
 public:
     explicit CPU(MemoryBus& memory);
     
     void reset();  // Reset CPU to post-boot ROM state
     
-    void tick(); // Execute one CPU cycle
+    // Execute one whole instruction (or interrupt dispatch / halted M-cycle)
+    // and return the number of T-cycles it consumed
+    uint8_t step();
+    
+    // Execute instructions until the cycle counter reaches target_cycles, or
+    // the next scheduled event if an instruction posts one earlier (see
+    // setNextEventSource). Returns the number of cycles actually executed
+    // (may overshoot the target by the length of the last instruction).
+    // Without a next event source, target_cycles must not lie past the next
+    // scheduled event: idle time is fast-forwarded on the basis that nothing
+    // raises an interrupt or changes a polled register before then (see
+    // setIdleSkip)
+    uint64_t runUntil(uint64_t target_cycles);
+    
+    // The scheduler's live next event time (Scheduler::getNextEventSource),
+    // checked after every instruction. Without one only target_cycles counts
+    void setNextEventSource(const uint64_t* source) { next_event = source; }
+    
+    // Idle fast-forward, on by default. A HALT with no interrupt pending, a
+    // polling loop such as LDH A,(LY) / CP n / JR NZ, or a JR to itself jumps
+    // straight to the end of the runUntil() slice instead of being stepped
+    // through. Cycle counts and machine state come out exactly as if it had
+    // been stepped
+    void setIdleSkip(bool enabled) { idle_skip = enabled; }
+    
+    // Cycles fast-forwarded so far. Only kept for statistics
+    uint64_t getSkippedCycles() const { return skipped_cycles; }
     
     uint16_t getPC() const { return registers.pc; } 
     
     // Get the number of cycles that have elapsed
     uint64_t getCycles() const { return cycles; }
+    const uint64_t* getCycleCounter() const { return &cycles; }  // Clock source for the scheduler
+    
+    // Instructions executed so far (halted M-cycles and interrupt dispatches
+    // don't count). Only kept for statistics, not part of save states
+    uint64_t getInstructionCount() const { return instructions; }
     
     // Reset cycle count (useful for timing specific events)
     void resetCycles() { cycles = 0; }
@@ -22,7 +57,13 @@ public:
     // Add a debug flag
     bool debug_output_enabled = false;
     
-    void setRegisterAF(uint16_t value) { registers.af = value; }
+    uint16_t getRegisterAF() const { return static_cast<uint16_t>((registers.a << 8) | getF()); }
+    uint16_t getRegisterBC() const { return registers.bc; }
+    uint16_t getRegisterDE() const { return registers.de; }
+    uint16_t getRegisterHL() const { return registers.hl; }
+    uint16_t getSP() const { return registers.sp; }
+    
+    void setRegisterAF(uint16_t value) { registers.a = value >> 8; setF(value & 0xFF); }
     void setRegisterBC(uint16_t value) { registers.bc = value; }
     void setRegisterDE(uint16_t value) { registers.de = value; }
     void setRegisterHL(uint16_t value) { registers.hl = value; }
@@ -30,17 +71,15 @@ public:
     void setSP(uint16_t value) { registers.sp = value; }
     void setIME(bool value) { ime = value; }
     
+    // Save state support (see savestate.hpp)
+    void saveState(StateWriter& writer) const;
+    void loadState(StateReader& reader);
+    
 private:
     // Register structure
     struct Registers {
-        // Main registers
-        union {
-            struct {
-                uint8_t f; // Flag register
-                uint8_t a; // Accumulator
-            };
-            uint16_t af;
-        };
+        // Main registers. F isn't stored as such, see the lazy flags below
+        uint8_t a; // Accumulator
         
         union {
             struct {
@@ -76,16 +115,49 @@ private:
     static constexpr uint8_t FLAG_H = 0x20; // Half carry flag
     static constexpr uint8_t FLAG_C = 0x10; // Carry flag
     
-    // Flag operations
-    bool getFlag(uint8_t flag) const { return (registers.f & flag) != 0; }
-    void setFlag(uint8_t flag, bool value) {
-        if (value) registers.f |= flag;
-        else registers.f &= ~flag;
+    // Lazy flags. Instead of packing F, each ALU op stores what the flags
+    // follow from: Z is set when the low byte of flag_z is 0, C is bit 8 of
+    // flag_c (an 8-bit add or subtract stores its 9-bit result in both), and
+    // H is the carry out of bit 3 when the half-carry operands' low nibbles
+    // are added, or subtracted when N is set. Conditions and carry-ins read
+    // Z and C straight from these; F is only put together when something
+    // reads it whole (PUSH AF, getRegisterAF, save states)
+    static constexpr uint16_t HALF_CARRY_IN = 0x100;   // flag_h2: carry into the low nibble
+    static constexpr uint16_t HALF_SUBTRACT = 0x200;   // flag_h2: subtract, and N is set
+    uint16_t flag_z = 0;
+    uint16_t flag_c = 0;
+    uint8_t flag_h1 = 0;   // First half-carry operand
+    uint16_t flag_h2 = 0;  // Second half-carry operand, plus the bits above
+    
+    bool flagZ() const { return (flag_z & 0xFF) == 0; }
+    bool flagC() const { return (flag_c & 0x100) != 0; }
+    bool flagN() const { return (flag_h2 & HALF_SUBTRACT) != 0; }
+    bool flagH() const {
+        unsigned low1 = flag_h1 & 0x0F;
+        unsigned low2 = (flag_h2 & 0x0F) + ((flag_h2 & HALF_CARRY_IN) ? 1 : 0);
+        return (((flag_h2 & HALF_SUBTRACT) ? low1 - low2 : low1 + low2) & 0x10) != 0;
+    }
+    
+    // N and H set outright rather than from operands
+    void setNH(bool n, bool h) {
+        flag_h1 = (h && !n) ? 0x0F : 0;
+        flag_h2 = static_cast<uint16_t>((n ? HALF_SUBTRACT : 0) | (h ? 1 : 0));
+    }
+    
+    // F as a whole (the low nibble always reads 0)
+    uint8_t getF() const {
+        return static_cast<uint8_t>((flagZ() ? FLAG_Z : 0) | (flagN() ? FLAG_N : 0) |
+                                    (flagH() ? FLAG_H : 0) | (flagC() ? FLAG_C : 0));
+    }
+    void setF(uint8_t f) {
+        flag_z = (f & FLAG_Z) ? 0 : 1;
+        flag_c = (f & FLAG_C) ? 0x100 : 0;
+        setNH((f & FLAG_N) != 0, (f & FLAG_H) != 0);
     }
     
     // Timing related fields
     uint64_t cycles = 0;         // Total cycles elapsed
-    uint8_t pending_cycles = 0;  // Cycles remaining for current instruction
+    uint64_t instructions = 0;   // Total instructions executed
     
     MemoryBus& memory;
     uint8_t current_opcode = 0;  // Current executing opcode
@@ -94,86 +166,76 @@ private:
     bool halted = false;
     bool stopped = false;
     
-
-    // Instruction handling
-    Instructions instructions;  // Add this to store the instruction set
-    const Instructions::Instruction* current_instruction = nullptr;  // Current instruction being executed
-    
-    // Fetch-decode-execute cycle
-    void fetch_instruction();  // Fetch next instruction
-    void fetch_adress(); // Fetch the adress data
-    void execute(); // Execute the instruction
-
-    struct InstructionData {
-        uint16_t immediate_value = 0;  // For immediate values and addresses
-    } current_instruction_data;
+    // Opcode dispatch. Each opcode has its own handler, generated at compile
+    // time in cpu_instructions.cpp; a handler executes the whole instruction
+    // (operand fetch included) and returns the T-cycles it took
+    struct Ops;
+    using OpHandler = uint8_t (*)(CPU&);
+    static const std::array<OpHandler, 256> op_table;  // Unprefixed opcodes
+    static const std::array<OpHandler, 256> cb_table;  // 0xCB-prefixed opcodes
 
     // Method for handling interrupts
     bool handleInterrupts();
+    
+    // Idle fast-forward (see setIdleSkip). Called after a JR lands a few
+    // bytes back; skips whole iterations of the loop at PC if it's a polling loop
+    void skipIdleLoop(uint64_t target_cycles);
+    
+    // Where the current runUntil() slice ends as of now: target_cycles, or
+    // the next scheduled event if that comes first. The idle skips go no
+    // further than this
+    uint64_t sliceEnd(uint64_t target_cycles) const { return std::min(target_cycles, *next_event); }
+    
+    // Cycles one iteration of the loop starting at pc takes, if it's a
+    // polling loop whose result can only change at a scheduled event; 0 if not
+    uint8_t idleLoopCycles(uint16_t pc) const;
 
-    // Helper methods for register access
-    uint8_t getRegister8Bit(Instructions::RegType reg);
-    void setRegister8Bit(Instructions::RegType reg, uint8_t value);
-    uint16_t getRegister16Bit(Instructions::RegType reg);
-    void setRegister16Bit(Instructions::RegType reg, uint16_t value);
-    bool isRegister16Bit(Instructions::RegType reg);
-
-    // Modified execution methods to return branch taken status
-    bool executeJP();
-    bool executeJR();
-    bool executeCALL();
-    bool executeRET();
-    
-    // Other execute methods (unchanged)
-    void executeLD();
-    void executeINC();
-    void executeDEC();
-    void executeADD();
-    void executeSUB();
-    void executeAND();
-    void executeOR();
-    void executeXOR();
-    void executePUSH();
-    void executePOP();
-    void executeRLCA();
-    void executeRRCA();
-    void executeRLA();
-    void executeRRA();
+    // ALU helpers shared by the opcode handlers. They operate on A (or HL/SP)
+    // and update the flags; the handlers supply the operands
+    void executeADD(uint8_t value);
+    void executeADC(uint8_t value);
+    void executeSUB(uint8_t value);
+    void executeSBC(uint8_t value);
+    void executeAND(uint8_t value);
+    void executeXOR(uint8_t value);
+    void executeOR(uint8_t value);
+    void executeCP(uint8_t value);
+    uint8_t executeINC(uint8_t value);
+    uint8_t executeDEC(uint8_t value);
+    void executeADDHL(uint16_t value);
+    uint16_t executeADDSP(int8_t offset);  // Returns SP+offset, used by ADD SP and LD HL,SP+r8
     void executeDAA();
-    void executeCPL();
-    void executeSCF();
-    void executeCCF();
     void executeHALT();
-    void executeSTOP();
-    void executeADC();
-    void executeSBC();
-    void executeCP();
-    void executeRETI();
-    void executeLDH();
-    void executeDI();
-    void executeEI();
-    void executeRST();
-    void executeRLC();
-    void executeRRC();
-    void executeRL();
-    void executeRR();
-    void executeSLA();
-    void executeSRA();
-    void executeSWAP();
-    void executeSRL();
-    void executeBIT();
-    void executeRES();
-    void executeSET();
+
+    // CB-prefixed rotates/shifts return the new value
+    uint8_t executeRLC(uint8_t value);
+    uint8_t executeRRC(uint8_t value);
+    uint8_t executeRL(uint8_t value);
+    uint8_t executeRR(uint8_t value);
+    uint8_t executeSLA(uint8_t value);
+    uint8_t executeSRA(uint8_t value);
+    uint8_t executeSWAP(uint8_t value);
+    uint8_t executeSRL(uint8_t value);
+    void executeBIT(uint8_t bit, uint8_t value);
 
     bool ime = true; // Interrupt Master Enable flag
+    bool ime_pending = false; // EI was executed; IME turns on after the next instruction
     bool halt_bug_active = false; // Flag to track HALT bug state
-    
-    // Helper for computing instruction timing
-    uint8_t get_instruction_cycles(const Instructions::Instruction* instr, bool branch_taken = false);
-    
-    // Helper to check conditions for conditional instructions
-    bool checkCondition(Instructions::CondType cond);
 
     // Debug counter to track executed instructions
-    uint64_t debug_instruction_count;
+    uint64_t debug_instruction_count = 0;
+    
+    // Idle fast-forward state. A polling loop is only skipped once it has
+    // been seen going round once, within the current runUntil() call, in
+    // exactly its own cycle count - proof that A and the flags come from the
+    // loop itself
+    static constexpr uint16_t NO_IDLE_LOOP = 0xFFFF;  // IE, never code
+    bool idle_skip = true;
+    uint64_t skipped_cycles = 0;
+    uint16_t idle_loop_pc = NO_IDLE_LOOP;  // Where the last backwards JR landed
+    uint64_t idle_loop_cycles = 0;         // Cycle count when it landed there
+    
+    // Where runUntil() reads the next event time from
+    static constexpr uint64_t NO_NEXT_EVENT = UINT64_MAX;
+    const uint64_t* next_event = &NO_NEXT_EVENT;
 };
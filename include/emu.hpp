@@ -1,4 +1,6 @@
 #pragma once
+#include "gpu.hpp"
+#include <cstddef>
 #include <cstdint>
 
 
@@ -6,6 +8,23 @@ struct EmulatorState {
     bool running;
     bool paused;
     uint64_t ticks;
+    bool turbo;  // Fast-forward: no frame pacing
+    bool rewinding;  // Stepping back through the rewind history
     // Add any other emulator state you need
 };
 
+// Settings parsed from the command line
+struct EmulatorOptions {
+    const char* rom_path = nullptr;
+    bool headless = false;     // No window, no SDL calls at all
+    uint64_t max_frames = 0;   // Stop after this many frames (0 = run until quit)
+    bool turbo = false;        // Start in fast-forward
+    double speed = 1.0;        // Emulation speed multiplier when not in turbo
+    size_t rewind_mb = 0;      // Rewind history budget in MB (0 = no rewind)
+    RendererMode renderer = RendererMode::SCANLINE;  // How the PPU draws each line
+    const char* record_path = nullptr;  // Movie file to record input to
+    const char* play_path = nullptr;    // Movie file to replay
+    const char* wav_path = nullptr;     // File to write the sound output to
+    bool mute = false;                  // Don't open an audio device
+    int run_ahead = 0;                  // Frames to run ahead of the shown one (0 = off)
+};
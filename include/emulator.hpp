@@ -0,0 +1,76 @@
+#pragma once
+#include "gpu.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Cartridge;
+class MemoryBus;
+class CPU;
+class Timer;
+class Serial;
+class APU;
+class Scheduler;
+class SaveState;
+
+// One complete Game Boy: cartridge, bus, CPU, PPU, timer, serial port, APU and
+// the event scheduler, wired together and set to the post-boot ROM state. Instances
+// share nothing, so any number of them can run side by side, one per thread.
+class Emulator {
+public:
+    // Throws std::runtime_error if the ROM can't be loaded. With persist_ram
+    // off the cartridge doesn't touch its .sav file
+    explicit Emulator(const std::string& rom_path, bool persist_ram = true);
+    
+    // Run a ROM image held in memory (e.g. one generated by a benchmark)
+    explicit Emulator(std::vector<uint8_t> rom_data);
+    ~Emulator();
+
+    // The components keep references to each other
+    Emulator(const Emulator&) = delete;
+    Emulator& operator=(const Emulator&) = delete;
+
+    // Run the CPU until target_cycle, stopping at every scheduled event so the
+    // GPU, timer and DMA are brought up to date exactly when something changes.
+    // Audio synthesized up to target_cycle is handed to the APU's sample
+    // callback at the end. Returns false if the CPU hit an error
+    bool runUntil(uint64_t target_cycle);
+
+    // Run to the end of the current frame. Frames are CYCLES_PER_FRAME long
+    // and counted from cycle 0, so instruction overshoot never accumulates
+    bool runFrame();
+
+    uint64_t getCycles() const;
+
+    // FNV-1a hash of the screen buffer, for comparing runs
+    uint64_t frameHash() const;
+
+    Cartridge& getCartridge() { return *cart; }
+    MemoryBus& getMemory() { return *memory; }
+    CPU& getCPU() { return *cpu; }
+    GPU& getGPU() { return *gpu; }
+    Timer& getTimer() { return *timer; }
+    Serial& getSerial() { return *serial; }
+    APU& getAPU() { return *apu; }
+    Scheduler& getScheduler() { return *scheduler; }
+    SaveState& getSaveState() { return *savestate; }
+
+private:
+    // Build and connect everything around the loaded cartridge
+    void connectComponents();
+    
+    // Set the hardware registers to what the DMG boot ROM leaves behind
+    void initializePostBoot();
+
+    // Declared in construction order; destroyed in reverse
+    std::unique_ptr<Cartridge> cart;
+    std::unique_ptr<MemoryBus> memory;
+    std::unique_ptr<Timer> timer;
+    std::unique_ptr<Serial> serial;
+    std::unique_ptr<APU> apu;
+    std::unique_ptr<GPU> gpu;
+    std::unique_ptr<CPU> cpu;
+    std::unique_ptr<Scheduler> scheduler;
+    std::unique_ptr<SaveState> savestate;
+};
@@ -6,10 +6,13 @@
 #include <string>
 #include <iostream>
 #include <vector>
-#include <deque>
+#include "pixel_fifo.hpp"
 
 // Forward declaration of MemoryBus to avoid circular dependency
 class MemoryBus;
+class Scheduler;
+class StateWriter;
+class StateReader;
 
 // GameBoy screen dimensions
 constexpr int SCREEN_WIDTH = 160;
@@ -21,6 +24,7 @@ constexpr int CYCLES_TRANSFER = 172;  // Mode 3: Pixel transfer (172 cycles)
 constexpr int CYCLES_HBLANK = 204;    // Mode 0: H-Blank (204 cycles)
 constexpr int CYCLES_SCANLINE = 456;  // Complete scanline (456 cycles)
 constexpr int VBLANK_LINES = 10;      // Number of scanlines in VBlank
+constexpr int CYCLES_PER_FRAME = CYCLES_SCANLINE * (SCREEN_HEIGHT + VBLANK_LINES);  // 70224 cycles per frame
 
 // LCD Controller Modes
 enum class LCDMode : uint8_t {
@@ -30,25 +34,10 @@ enum class LCDMode : uint8_t {
     TRANSFER = 3  // Pixel transfer (CPU cannot access VRAM or OAM)
 };
 
-// Background/Window pixel information
-struct BGPixelInfo {
-    uint8_t colorIndex;  // Color index (0-3)
-    bool bgPriority;     // BG-to-OAM priority (from attribute for CGB, unused for DMG)
-    
-    BGPixelInfo() : colorIndex(0), bgPriority(false) {}
-    BGPixelInfo(uint8_t idx, bool pri) : colorIndex(idx), bgPriority(pri) {}
-};
-
-// Sprite pixel information
-struct SpritePixelInfo {
-    uint8_t colorIndex;   // Color index (0-3, 0 is transparent)
-    uint8_t paletteNum;   // Palette number (0-1 for DMG, 0-7 for CGB)
-    bool priority;        // Sprite priority (true = behind background)
-    uint8_t spriteIdx;    // Original sprite index for prioritization
-    
-    SpritePixelInfo() : colorIndex(0), paletteNum(0), priority(false), spriteIdx(0) {}
-    SpritePixelInfo(uint8_t idx, uint8_t pal, bool pri, uint8_t sprite) 
-        : colorIndex(idx), paletteNum(pal), priority(pri), spriteIdx(sprite) {}
+// How a scanline gets drawn
+enum class RendererMode : uint8_t {
+    SCANLINE = 0,  // Whole line drawn from decoded tile rows at the end of mode 3 (fast)
+    FIFO           // Pixel FIFO and tile fetcher, pixel by pixel (kept for accuracy work)
 };
 
 class GPU {
@@ -68,6 +57,29 @@ public:
     // GPU tick function - updates GPU state based on elapsed CPU cycles
     void tick(uint64_t cycles);
     
+    // Scheduler integration: the GPU is only advanced at its PPU_MODE events,
+    // which are posted at every mode boundary so STAT and LY stay exact
+    void setScheduler(Scheduler* scheduler_ptr);
+    void sync(uint64_t now);
+    
+    // Cycles left until the current mode ends
+    uint32_t cyclesUntilNextEvent();
+    
+    // Select the scanline or pixel FIFO renderer (takes effect from the next line)
+    void setRendererMode(RendererMode mode) { renderer_mode = mode; }
+    RendererMode getRendererMode() const { return renderer_mode; }
+    
+    // Frame skipping for fast-forward and batch runs: with a skip of N only
+    // one frame in every N+1 is drawn. Skipped frames keep the exact mode,
+    // LY, STAT and interrupt timing but fetch no tiles and draw nothing, so
+    // the screen buffer keeps the last drawn frame. Decided at the start of
+    // each frame; lowering the skip makes the next frame a drawn one
+    void setFrameSkip(uint32_t frames);
+    uint32_t getFrameSkip() const { return frame_skip; }
+    
+    // Whether the frame in progress is being drawn
+    bool isDrawingFrame() const { return draw_frame; }
+    
     // Allow MemoryBus to query current LCD mode for VRAM access control
     LCDMode getCurrentMode() const { return current_mode; }
     
@@ -82,6 +94,11 @@ public:
     // Get screen buffer for rendering
     const std::vector<uint32_t>& getScreenBuffer() const { return screen_buffer; }
     
+    // Save state support (see savestate.hpp). The pixel FIFO is not saved:
+    // it only runs inside a single mode 3 update
+    void saveState(StateWriter& writer) const;
+    void loadState(StateReader& reader);
+    
     // Debug function to dump VRAM contents to a file
     void dumpVRAM(const std::string& filename);
     
@@ -110,6 +127,21 @@ private:
     // Cycle counter for current mode
     uint16_t mode_cycles;
     
+    // Length of mode 3 on the current line, computed once when it starts
+    uint16_t mode3_duration = CYCLES_TRANSFER;
+    
+    // Active renderer
+    RendererMode renderer_mode = RendererMode::SCANLINE;
+    
+    // Frame skipping (not machine state, so not saved)
+    uint32_t frame_skip = 0;      // Frames skipped after each drawn one
+    uint32_t frames_to_skip = 0;  // Left to skip before the next drawn frame
+    bool draw_frame = true;       // Whether the current frame is being drawn
+    
+    // Raw background/window color index (0-3) of every pixel on the line being
+    // drawn by the scanline renderer; sprites need it for BG priority
+    std::array<uint8_t, SCREEN_WIDTH> line_bg_index;
+    
     // Current scanline being processed
     int line;
     
@@ -122,6 +154,10 @@ private:
     // Cycles since last debug output
     uint64_t cycles_since_last_debug;
     
+    // Event scheduler and the time the GPU was last brought up to
+    Scheduler* scheduler;
+    uint64_t last_sync_cycle;
+    
     // Interrupt callbacks
     std::function<void()> vblank_callback;
     std::function<void()> lcd_stat_callback;
@@ -139,9 +175,13 @@ private:
     static constexpr uint16_t WY_REG = 0xFF4A;    // Window Y Position Register
     static constexpr uint16_t WX_REG = 0xFF4B;    // Window X Position Register
     
-    // Pixel FIFO structures
-    std::deque<BGPixelInfo> bg_fifo;
-    std::deque<SpritePixelInfo> sprite_fifo;
+    // Pixel FIFOs. The fetcher only pushes a tile when at most 8 pixels are
+    // queued, and sprite pixels are only placed under queued BG pixels, so
+    // neither ever holds more than 16
+    static constexpr size_t FIFO_CAPACITY = 16;
+    using Fifo = PixelFifo<FIFO_CAPACITY>;
+    Fifo bg_fifo;
+    Fifo sprite_fifo;
     
     // Pixel FIFO state
     int fifo_x = 0;        // X position being processed by the FIFO
@@ -151,16 +191,18 @@ private:
     
     // Sprite data for the current scanline
     struct OAMEntry {
-        uint8_t y;
-        uint8_t x;
+        int16_t y;        // Screen position; sprites can hang off the top/left edge
+        int16_t x;
         uint8_t tile_idx;
         uint8_t attrs;
         uint8_t oam_idx;  // Original index in OAM for priority
         
         bool operator<(const OAMEntry& other) const {
-            return x < other.x; // Sort by X position
+            // Sort by X position, lower OAM index first on a tie (DMG drawing priority)
+            return x != other.x ? x < other.x : oam_idx < other.oam_idx;
         }
     };
+    static constexpr size_t MAX_SPRITES_PER_LINE = 10;  // Hardware limit per scanline
     std::vector<OAMEntry> visible_sprites;  // Sprites visible on current scanline
     
     // Tile fetcher state
@@ -168,8 +210,7 @@ private:
     FetcherState fetcher_state = FetcherState::TILE;
     int fetcher_x = 0;     // X position being fetched
     uint8_t tile_idx = 0;  // Index of the tile being fetched
-    uint8_t tile_data_low = 0; // Low byte of tile data
-    uint8_t tile_data_high = 0; // High byte of tile data
+    const uint8_t* tile_row = nullptr; // Decoded row of the tile being fetched (from the tile cache)
     int fetcher_cycles = 0; // Cycle counter for the fetcher
     
     // Pixel FIFO methods
@@ -179,12 +220,16 @@ private:
     void mixPixels();
     void drawPixel();
     
-    // Old render functions - deprecated but kept for reference
+    // Scanline renderer: draws the whole of LY at once. Background and window
+    // fill line_bg_index, sprites are then composited over the line
     void renderScanline();
     void renderBackground(int scanline);
     void renderWindow(int scanline);
     void renderSprites(int scanline);
     
+    // Tile cache number (0-383) of a BG/window tile, honouring the LCDC.4 addressing mode
+    uint16_t getTileNumber(uint8_t tile_index) const;
+    
     // New pixel FIFO render methods
     void processScanline();
     void scanOAM();
@@ -194,6 +239,12 @@ private:
     void startPixelTransfer();
     void finalizeCurrentLine();
     
+    // Decide whether the frame starting at line 0 gets drawn
+    void startFrame();
+    
+    // Run one step of the mode state machine, returns true if the mode or line changed
+    bool advanceMode();
+    
     // Check LY=LYC interrupt
     void checkLYC();
     
@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+// Diagnostic logging with compile-time levels.
+//
+// GB_LOG_LEVEL selects which macros generate any code at all:
+//   0 (OFF)   - every GB_LOG_* macro compiles to nothing
+//   1 (INFO)  - one-off messages (cartridge header, save files, ...)
+//   2 (DEBUG) - per-event messages (register writes, DMA, mode changes)
+//   3 (TRACE) - per-instruction / per-pixel messages
+// A disabled macro doesn't evaluate its arguments, so counters and string
+// formatting on hot paths disappear with it. Errors are not logged through
+// here; they keep going to std::cerr unconditionally.
+//
+// When a level is compiled in, a runtime category mask (setLogMask) decides
+// which subsystems actually print.
+
+#define GB_LOG_LEVEL_OFF   0
+#define GB_LOG_LEVEL_INFO  1
+#define GB_LOG_LEVEL_DEBUG 2
+#define GB_LOG_LEVEL_TRACE 3
+
+#ifndef GB_LOG_LEVEL
+#define GB_LOG_LEVEL GB_LOG_LEVEL_INFO
+#endif
+
+// Subsystems that can be enabled individually at runtime
+enum LogCategory : uint32_t {
+    LOG_CPU    = 1u << 0,
+    LOG_MEMORY = 1u << 1,
+    LOG_GPU    = 1u << 2,
+    LOG_TIMER  = 1u << 3,
+    LOG_CART   = 1u << 4,
+    LOG_SYSTEM = 1u << 5,
+    LOG_ALL    = 0xFFFFFFFFu
+};
+
+// Currently enabled categories (all by default)
+extern uint32_t gb_log_mask;
+
+inline void setLogMask(uint32_t mask) { gb_log_mask = mask; }
+inline bool logEnabled(uint32_t category) { return (gb_log_mask & category) != 0; }
+
+// Parse a comma separated list such as "cpu,gpu" (or "all" / "none") into a
+// category mask. Returns false if a name isn't recognised
+bool parseLogCategories(const std::string& list, uint32_t& mask);
+
+// Write one line for the given category. `expr` is a stream expression:
+//   GB_LOG_DEBUG(LOG_GPU, "LY=" << ly << " mode=" << mode);
+#define GB_LOG_WRITE(category, expr) \
+    do { \
+        if (logEnabled(category)) { \
+            std::cout << expr << std::endl; \
+        } \
+    } while (0)
+
+#define GB_LOG_NOTHING() do { } while (0)
+
+#if GB_LOG_LEVEL >= GB_LOG_LEVEL_INFO
+#define GB_LOG_INFO(category, expr) GB_LOG_WRITE(category, expr)
+#else
+#define GB_LOG_INFO(category, expr) GB_LOG_NOTHING()
+#endif
+
+#if GB_LOG_LEVEL >= GB_LOG_LEVEL_DEBUG
+#define GB_LOG_DEBUG(category, expr) GB_LOG_WRITE(category, expr)
+#else
+#define GB_LOG_DEBUG(category, expr) GB_LOG_NOTHING()
+#endif
+
+#if GB_LOG_LEVEL >= GB_LOG_LEVEL_TRACE
+#define GB_LOG_TRACE(category, expr) GB_LOG_WRITE(category, expr)
+
+// Log only every n-th time this line is reached. The counter only exists in
+// trace builds
+#define GB_LOG_TRACE_EVERY(category, n, expr) \
+    do { \
+        static uint64_t gb_log_every_counter = 0; \
+        if (gb_log_every_counter++ % (n) == 0) { \
+            GB_LOG_WRITE(category, expr); \
+        } \
+    } while (0)
+
+// Log only the first n times this line is reached
+#define GB_LOG_TRACE_FIRST(category, n, expr) \
+    do { \
+        static uint64_t gb_log_first_counter = 0; \
+        if (gb_log_first_counter < (n)) { \
+            gb_log_first_counter++; \
+            GB_LOG_WRITE(category, expr); \
+        } \
+    } while (0)
+#else
+#define GB_LOG_TRACE(category, expr) GB_LOG_NOTHING()
+#define GB_LOG_TRACE_EVERY(category, n, expr) GB_LOG_NOTHING()
+#define GB_LOG_TRACE_FIRST(category, n, expr) GB_LOG_NOTHING()
+#endif
@@ -1,22 +1,79 @@
 #pragma once
 #include "cartridge.hpp"
+#include "tile_cache.hpp"
 #include <array>
 #include <cstdint>
 
 class Timer; // Forward declaration
+class Serial;
+class APU;
 class GPU;   // Forward declaration for GPU class
+class Scheduler;
+class StateWriter;
+class StateReader;
 
 class MemoryBus {
     public:
-        explicit MemoryBus(Cartridge& cart, Timer& timer);
+        explicit MemoryBus(Cartridge& cart);
+        
+        // The page table points into this object, so it must not be copied
+        MemoryBus(const MemoryBus&) = delete;
+        MemoryBus& operator=(const MemoryBus&) = delete;
 
-        uint8_t read(uint16_t addr) const;
-        void write(uint16_t addr, uint8_t value);
+        // Plain memory (ROM banks, VRAM reads, WRAM, cartridge RAM) is reached
+        // through the 4KB page table with a shift and a load. Pages without a
+        // host pointer (I/O, OAM, HRAM, MBC registers) go through the handlers
+        uint8_t read(uint16_t addr) const {
+            const uint8_t* page = read_pages[addr >> PAGE_SHIFT];
+            if (page != nullptr) {
+                return page[addr & PAGE_MASK];
+            }
+            return readSlow(addr);
+        }
+        void write(uint16_t addr, uint8_t value) {
+            uint8_t* page = write_pages[addr >> PAGE_SHIFT];
+            if (page != nullptr) {
+                page[addr & PAGE_MASK] = value;
+                return;
+            }
+            writeSlow(addr, value);
+        }
         void write16(uint16_t address, uint16_t value);
         uint16_t read16(uint16_t address);
         
+        // Rebuild the cartridge entries of the page table (after a bank switch,
+        // RAM enable or anything else that changes what the MBC has mapped)
+        void remapCartridge();
+        
         // Add GPU setter method
         void setGPU(GPU* gpu_ptr);
+        
+        // Timer is created after the bus (it needs the bus for IF), so it is attached here
+        void setTimer(Timer* timer_ptr) { timer = timer_ptr; }
+        
+        // Serial port, attached the same way (SB/SC go to it once it's set)
+        void setSerial(Serial* serial_ptr) { serial = serial_ptr; }
+        
+        // Sound, attached the same way (0xFF10-0xFF3F go to it once it's set)
+        void setAPU(APU* apu_ptr) { apu = apu_ptr; }
+        
+        // Scheduler used to time DMA transfers
+        void setScheduler(Scheduler* scheduler_ptr) { scheduler = scheduler_ptr; }
+        
+        // OAM DMA state - the copy itself is instant, but OAM stays busy for
+        // 160 M-cycles until the DMA_COMPLETE event clears it
+        bool isDMAActive() const { return dma_active; }
+        void completeDMA() { dma_active = false; }
+
+        // Direct read-only views of VRAM and OAM for the PPU's line renderer
+        const uint8_t* getVRAM() const { return vram.data(); }
+        const uint8_t* getOAM() const { return oam.data(); }
+        
+        // Decoded tiles, kept in sync with VRAM writes
+        TileCache& getTileCache() { return tile_cache; }
+        
+        // PPU-side update of LY (CPU writes to 0xFF44 reset it to 0 instead)
+        void setLY(uint8_t value);
 
         // Add accessor methods for joypad state
         uint8_t getJoypadState() const { return joypad_state; }
@@ -24,8 +81,29 @@ class MemoryBus {
         
         // Method to update joypad button state and trigger interrupt if needed
         void updateJoypadButton(uint8_t button_mask, bool pressed);
+        
+        // Set every button at once (bit set = held, same masks as above). Only
+        // buttons that changed are passed on to updateJoypadButton
+        void setJoypadButtons(uint8_t held);
+        
+        // Save state support (see savestate.hpp). Call remapCartridge() once
+        // the cartridge has been restored too
+        void saveState(StateWriter& writer) const;
+        void loadState(StateReader& reader);
 
     private:
+        // Page table geometry: 16 pages of 4KB
+        static constexpr int PAGE_SHIFT = 12;
+        static constexpr uint16_t PAGE_MASK = 0x0FFF;
+        static constexpr int PAGE_COUNT = 0x10000 >> PAGE_SHIFT;
+        
+        // Handler path for everything the page table doesn't map directly
+        uint8_t readSlow(uint16_t addr) const;
+        void writeSlow(uint16_t addr, uint8_t value);
+        
+        // Fill in the fixed (non-cartridge) page table entries
+        void mapInternalMemory();
+        
         // Helper functions to check memory ranges
         bool isInRange(uint16_t addr, uint16_t start, uint16_t end) const {
             return addr >= start && addr <= end;
@@ -47,14 +125,22 @@ class MemoryBus {
         std::array<uint8_t, 0x80> io_regs;    // 128B I/O Registers (0xFF00-0xFF7F)
         std::array<uint8_t, 0x7F> hram;       // 127B High RAM (0xFF80-0xFFFE)
         uint8_t ie_register;                   // Interrupt Enable Register (0xFFFF)
+        TileCache tile_cache;                  // Decoded copy of the VRAM tile data
+        
+        // Page table: host pointer per 4KB page, nullptr = use the handlers
+        std::array<const uint8_t*, PAGE_COUNT> read_pages;
+        std::array<uint8_t*, PAGE_COUNT> write_pages;
         
         Cartridge& cartridge;
-        Timer& timer;                          // Reference to timer component
+        Timer* timer;                          // Pointer to timer component
+        Serial* serial = nullptr;              // Pointer to serial port
+        APU* apu = nullptr;                    // Pointer to sound unit
         GPU* gpu;                              // Pointer to GPU component
+        Scheduler* scheduler;                  // Pointer to event scheduler
+        bool dma_active = false;               // OAM DMA transfer in progress
         
         // Debugging counters
-        mutable uint32_t vram_write_counter = 0;
-        mutable uint32_t write_counter = 0;
+        mutable uint32_t vram_write_counter = 0;  // Only counted in trace builds
 
         // Joypad state (0xFF00)
         uint8_t joypad_state = 0xFF;  // All buttons released
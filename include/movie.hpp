@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class SaveState;
+class Cartridge;
+
+// Movie (input recording) format
+//
+//   "GBMV"  u32 version  u32 ROM hash (CRC-32 of the whole ROM image)
+//   "INIT"  save state the movie starts from (see savestate.hpp), empty = power-on
+//   "INPT"  one joypad byte per frame
+//   "END "
+//
+// This is the save state chunk container with a different magic. A joypad
+// byte has one bit per button, set while it's held, using the masks of
+// MemoryBus::updateJoypadButton (Right, Left, Up, Down, Start, Select, B, A
+// from bit 0). The frontend only changes the joypad at frame boundaries, so
+// replaying the bytes from the initial state reproduces the recorded run.
+constexpr uint32_t MOVIE_VERSION = 1;
+
+class Movie {
+public:
+    Movie(SaveState& state, const Cartridge& cart);
+
+    // Start a recording from the machine's current state
+    void startRecording();
+
+    // Load a movie and put the machine in its initial state. Returns false,
+    // with the machine left untouched, if the file isn't a movie of this ROM
+    bool startPlayback(const std::string& path);
+
+    // Write the recording so far
+    bool saveToFile(const std::string& path) const;
+
+    // Buttons for the frame about to run. When recording, the live buttons are
+    // recorded and returned; when playing, the movie's are returned instead.
+    // Playback ends on the call after the last frame and live input takes over
+    uint8_t nextFrame(uint8_t live_buttons);
+
+    bool isRecording() const { return mode == Mode::RECORDING; }
+    bool isPlaying() const { return mode == Mode::PLAYING; }
+    size_t frameCount() const { return inputs.size(); }
+    size_t currentFrame() const { return position; }
+
+private:
+    enum class Mode { IDLE, RECORDING, PLAYING };
+
+    SaveState& state;
+    const Cartridge& cart;
+    Mode mode = Mode::IDLE;
+
+    std::vector<uint8_t> initial_state;
+    std::vector<uint8_t> inputs;  // One byte per frame
+    size_t position = 0;          // Next frame to play
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Fixed-capacity pixel FIFO for the PPU's pixel pipeline.
+//
+// Storage is inline (no heap) and laid out as one byte array per field, so
+// the background and sprite streams share the same type. Capacity must be a
+// power of two; positions wrap with a mask instead of a modulo. Pushing into
+// a full FIFO or popping an empty one is the caller's bug - the PPU checks
+// size() before doing either.
+template <size_t Capacity>
+class PixelFifo {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "PixelFifo capacity must be a power of two");
+
+public:
+    // One pixel as handed out by front()/pop()
+    struct Pixel {
+        uint8_t color = 0;     // Color index (0-3, 0 is transparent for sprites)
+        uint8_t palette = 0;   // Palette number (OBP0/OBP1 for sprites)
+        uint8_t priority = 0;  // Sprite: behind BG colors 1-3. BG: unused on DMG
+    };
+
+    static constexpr size_t capacity() { return Capacity; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == Capacity; }
+
+    void clear() {
+        head = 0;
+        count = 0;
+    }
+
+    void push(uint8_t color, uint8_t palette = 0, uint8_t priority = 0) {
+        set(count++, color, palette, priority);
+    }
+
+    Pixel pop() {
+        Pixel pixel = at(0);
+        head = (head + 1) & MASK;
+        count--;
+        return pixel;
+    }
+
+    // Access relative to the front of the FIFO (0 = next pixel out)
+    Pixel at(size_t index) const {
+        size_t slot = (head + index) & MASK;
+        return Pixel{colors[slot], palettes[slot], priorities[slot]};
+    }
+
+    void set(size_t index, uint8_t color, uint8_t palette = 0, uint8_t priority = 0) {
+        size_t slot = (head + index) & MASK;
+        colors[slot] = color;
+        palettes[slot] = palette;
+        priorities[slot] = priority;
+    }
+
+    // Grow to `new_size` pixels, filling new positions with transparent pixels
+    void resize(size_t new_size) {
+        while (count < new_size) {
+            push(0);
+        }
+        count = new_size;
+    }
+
+private:
+    static constexpr size_t MASK = Capacity - 1;
+
+    std::array<uint8_t, Capacity> colors{};
+    std::array<uint8_t, Capacity> palettes{};
+    std::array<uint8_t, Capacity> priorities{};
+    size_t head = 0;
+    size_t count = 0;
+};
+
+// The FIFO never owns heap memory, so copying it (e.g. with the PPU state) is a plain copy
+static_assert(std::is_trivially_copyable<PixelFifo<16>>::value, "PixelFifo must stay heap-free");
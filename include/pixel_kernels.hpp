@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+
+// Bulk pixel conversion used by the PPU.
+//
+// Each kernel has a portable scalar version and, depending on the target,
+// SSE2 and AVX2 versions. The unsuffixed functions call the widest one that
+// was compiled in: AVX2 when the build enables it (GB_ENABLE_AVX2), SSE2 on
+// any x86-64 target, scalar everywhere else (ARM included). The suffixed
+// versions are exported so the kernel benchmark can compare them.
+
+// Decode `rows` 2bpp tile rows (two bytes each: low plane, high plane) into
+// 8 color indices (0-3) per row, leftmost pixel first
+void decodeTileRows(const uint8_t* data, int rows, uint8_t* out);
+void decodeTileRowsScalar(const uint8_t* data, int rows, uint8_t* out);
+
+// Map `count` color indices (0-3) through a 4 entry ARGB table, e.g. a
+// palette register already resolved with getRGBColor
+void applyPalette(const uint8_t* indices, const uint32_t* colors, uint32_t* out, int count);
+void applyPaletteScalar(const uint8_t* indices, const uint32_t* colors, uint32_t* out, int count);
+
+#if defined(__SSE2__)
+void decodeTileRowsSSE2(const uint8_t* data, int rows, uint8_t* out);
+void applyPaletteSSE2(const uint8_t* indices, const uint32_t* colors, uint32_t* out, int count);
+#endif
+
+#if defined(__AVX2__)
+void decodeTileRowsAVX2(const uint8_t* data, int rows, uint8_t* out);
+void applyPaletteAVX2(const uint8_t* indices, const uint32_t* colors, uint32_t* out, int count);
+#endif
+
+// Name of the kernel set the unsuffixed functions use ("avx2", "sse2" or "scalar")
+const char* pixelKernelName();
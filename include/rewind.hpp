@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+class SaveState;
+
+// Rewind history built from per-frame save states.
+//
+// Every keyframe_interval frames a keyframe is stored; the frames in between
+// store the XOR of their state against the previous frame's. Both are kept
+// run-length encoded (a keyframe is just a delta against an all-zero state),
+// so the memory, WRAM and cartridge RAM that barely change from frame to
+// frame cost a few bytes each. Entries live in a ring arena of a fixed byte
+// budget that is allocated up front; when it fills up, the oldest keyframe
+// and its deltas are dropped together.
+class RewindBuffer {
+public:
+    RewindBuffer(SaveState& state, size_t byte_budget, int keyframe_interval = 60);
+
+    // Record the machine's current state (call once per emulated frame). A
+    // frame that can't be recorded is reported once and counted
+    void push();
+
+    // Restore the state from one frame before the newest recorded one and
+    // drop the newest. Returns false when there's nothing left to go back to
+    bool stepBack();
+
+    // Forget all history (e.g. after loading a save state)
+    void clear();
+
+    size_t frameCount() const { return entries.size(); }
+    size_t bytesUsed() const;
+    size_t capacity() const { return arena.size(); }
+    uint64_t droppedFrames() const { return dropped_frames; }
+
+private:
+    struct Entry {
+        size_t offset;   // Start of the encoded data in the arena
+        size_t length;
+        bool keyframe;
+    };
+
+    // Encode a XOR b into out, returns the encoded length. Format: a run of
+    // (zero count, literal count, literal bytes) triples, counts as varints
+    static size_t encodeXor(const uint8_t* a, const uint8_t* b, size_t size, uint8_t* out);
+
+    // XOR an encoded delta back into target
+    static void applyXor(const uint8_t* encoded, size_t length, uint8_t* target, size_t size);
+
+    // Arena space for an entry of this length, evicting old history as needed.
+    // Returns false if the entry can't fit even in an empty arena
+    bool allocate(size_t length, size_t& offset);
+    void evictOldestGroup();
+
+    // Rebuild `current` from the last keyframe and the deltas after it
+    void rebuildCurrent();
+
+    // Grow the state buffers if a snapshot no longer fits
+    void resize();
+    void dropFrame();
+
+    SaveState& state;
+    int keyframe_interval;
+    size_t state_size;  // Largest snapshot seen, all states are padded to it
+    int frames_since_keyframe = 0;
+    uint64_t dropped_frames = 0;
+
+    std::vector<uint8_t> arena;
+    size_t write_pos = 0;
+    std::deque<Entry> entries;   // Oldest first
+
+    std::vector<uint8_t> current;  // Decoded newest state
+    std::vector<uint8_t> scratch;  // Snapshot being recorded
+    std::vector<uint8_t> encoded;  // Encoder output before it goes in the arena
+};
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Read-only cartridge ROM contents.
+//
+// Images opened from a file are shared: every Cartridge in the process that
+// opens the same file gets the same image, so a batch of instances running
+// one 8MB ROM holds it once. Where the platform has mmap the file is mapped
+// read-only (MAP_PRIVATE) rather than read, so opening is near-instant and
+// only the banks a game actually uses are ever paged in. Without mmap, or if
+// mapping fails, the file is read into memory instead.
+class RomImage {
+public:
+    // Shared image of a file; nullptr if it can't be opened or read
+    static std::shared_ptr<const RomImage> open(const std::string& path);
+
+    // Image of ROM data already in memory (generated test ROMs). Not shared
+    static std::shared_ptr<const RomImage> fromData(std::vector<uint8_t> data);
+
+    ~RomImage();
+
+    RomImage(const RomImage&) = delete;
+    RomImage& operator=(const RomImage&) = delete;
+
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+    uint8_t operator[](size_t index) const { return bytes[index]; }
+
+    // True if the image is a file mapping rather than a copy in memory
+    bool isMapped() const { return mapped; }
+
+    // CRC-32 of the whole image. Worked out on first use and kept, as it
+    // reads every byte - something a mapped image otherwise never has to do
+    uint32_t crc32() const;
+
+private:
+    RomImage() = default;
+
+    // Read the whole file into owned memory
+    static std::shared_ptr<const RomImage> readFile(const std::string& path);
+
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    std::vector<uint8_t> owned;  // Backing store when not mapped
+
+    mutable std::once_flag crc_once;
+    mutable uint32_t crc = 0;
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Emulator;
+
+// Run-ahead input latency reduction.
+//
+// Games typically act on a button press a frame or two after reading it, and
+// the LCD shows the result a frame later still. After each real frame,
+// run() snapshots the machine, emulates `frames` more frames with the input
+// unchanged, keeps the screen they end on and restores the snapshot. Showing
+// that screen instead of the real one hides `frames` frames of the game's own
+// lag; the real machine, audio, rewind and movies never see the extra frames.
+//
+// Snapshot and restore go through SaveState on a buffer allocated up front
+// (and grown if the state ever outgrows it), so the cost per host frame is
+// one snapshot, one restore and `frames` frames of emulation. Both are timed
+// so the overhead can be reported.
+class RunAhead {
+public:
+    RunAhead(Emulator& emulator, int frames);
+
+    RunAhead(const RunAhead&) = delete;
+    RunAhead& operator=(const RunAhead&) = delete;
+
+    // Call after each real frame. Returns false, with the error reported, if
+    // the CPU hit an error while running ahead (the machine is still
+    // restored), if the machine couldn't be snapshot (nothing is run and
+    // getScreen() is the real screen), or if restoring failed, which leaves
+    // the machine `frames` frames ahead
+    bool run();
+
+    // The screen `frames` frames ahead of the real machine, as of the last run()
+    const std::vector<uint32_t>& getScreen() const { return screen; }
+
+    int getFrames() const { return frames; }
+
+    // Timings accumulated over all run() calls
+    uint64_t getRuns() const { return runs; }
+    double averageSnapshotMicros() const { return runs ? snapshot_ns / runs * 1e-3 : 0.0; }
+    double averageRestoreMicros() const { return runs ? restore_ns / runs * 1e-3 : 0.0; }
+    double averageAheadMicros() const { return runs ? ahead_ns / runs * 1e-3 : 0.0; }
+    size_t stateSize() const { return state.size(); }
+
+private:
+    Emulator& emulator;
+    int frames;
+
+    std::vector<uint8_t> state;    // Snapshot of the real machine
+    std::vector<uint32_t> screen;  // Screen at the end of the run-ahead
+
+    uint64_t runs = 0;
+    double snapshot_ns = 0.0;
+    double restore_ns = 0.0;
+    double ahead_ns = 0.0;
+};
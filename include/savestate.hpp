@@ -0,0 +1,143 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class CPU;
+class MemoryBus;
+class GPU;
+class Timer;
+class Cartridge;
+class Scheduler;
+class Serial;
+class APU;
+
+// Save state format
+//
+//   "GBSS"  u32 version  u32 rom checksum
+//   chunk*  where each chunk is: 4-byte tag, u32 payload size, payload
+//   "END "  with an empty payload
+//
+// All integers are little-endian. There is one chunk per component ("CPU ",
+// "MEM ", "PPU ", "TIMR", "CART", "SCHD", "SRL ", "APU "). Readers look chunks
+// up by tag and ignore trailing payload bytes they don't know about, so a
+// later version can append fields to a chunk or add chunks without breaking
+// old states.
+// Bump SAVESTATE_VERSION when an existing field changes meaning.
+//
+// Version history:
+//   1  first version
+//   2  the PPU chunk always holds all 10 sprite slots, so a snapshot's size
+//      no longer depends on the line the PPU is on
+constexpr uint32_t SAVESTATE_VERSION = 2;
+
+// Sequential writer into a caller-provided buffer. Never allocates. Writing
+// past the end of the buffer sets the overflow flag and drops the data; with
+// a null buffer the writer only measures the size
+class StateWriter {
+public:
+    StateWriter(uint8_t* buffer, size_t capacity) : buffer(buffer), capacity(capacity) {}
+
+    // Chunk tags are exactly 4 characters
+    void beginChunk(const char* tag);
+    void endChunk();
+
+    void write8(uint8_t value) { writeBytes(&value, 1); }
+    void writeBool(bool value) { write8(value ? 1 : 0); }
+    void write16(uint16_t value);
+    void write32(uint32_t value);
+    void write64(uint64_t value);
+    void writeBytes(const void* data, size_t length);
+    void write32Array(const uint32_t* values, size_t count);
+
+    // Bytes written (or needed, when measuring or after an overflow)
+    size_t size() const { return position; }
+    bool overflowed() const { return overflow; }
+
+private:
+    uint8_t* buffer;
+    size_t capacity;
+    size_t position = 0;
+    size_t chunk_start = 0;  // Offset of the open chunk's size field
+    bool overflow = false;
+};
+
+// Reader over a save state in memory. Reads are bounds checked against the
+// open chunk; reading past its end sets the error flag and returns zeros
+class StateReader {
+public:
+    StateReader(const uint8_t* data, size_t size) : data(data), data_size(size) {}
+
+    // Position the reader at the start of the chunk with this tag
+    bool openChunk(const char* tag);
+    
+    // Whether the chunk exists, without touching the position or error flag
+    // (for chunks added in later versions)
+    bool hasChunk(const char* tag) const;
+
+    // Format version from the header, for fields whose layout changed
+    uint32_t version() const;
+
+    uint8_t read8();
+    bool readBool() { return read8() != 0; }
+    uint16_t read16();
+    uint32_t read32();
+    uint64_t read64();
+    void readBytes(void* out, size_t length);
+    void read32Array(uint32_t* out, size_t count);
+
+    // Size of the open chunk's payload not read yet
+    size_t remaining() const { return chunk_end - position; }
+    bool failed() const { return error; }
+    void fail() { error = true; }
+
+private:
+    const uint8_t* data;
+    size_t data_size;
+    size_t position = 0;
+    size_t chunk_end = 0;
+    bool error = false;
+    
+    // Payload bounds of the chunk with this tag
+    bool findChunk(const char* tag, size_t& start, size_t& end) const;
+};
+
+// Snapshot/restore of a whole machine. Holds references to the components;
+// snapshot() and restore() work on caller-provided memory and don't allocate,
+// so they can be called every frame (rewind, run-ahead)
+class SaveState {
+public:
+    SaveState(CPU& cpu, MemoryBus& memory, GPU& gpu, Timer& timer, Serial& serial, APU& apu, Cartridge& cart, Scheduler& scheduler);
+
+    // Size of a snapshot of this machine. Fixed for a given cartridge: every
+    // chunk has the same layout whatever state the components are in
+    size_t size() const;
+
+    // Write a snapshot into buffer. Returns the number of bytes written, or 0
+    // if the buffer is too small
+    size_t snapshot(uint8_t* buffer, size_t capacity) const;
+
+    // Load a snapshot. Returns false, with the machine left untouched, if the
+    // data isn't a valid state for this cartridge; an error while loading a
+    // chunk can leave the machine partly restored
+    bool restore(const uint8_t* data, size_t size);
+
+    // Convenience wrappers for save state files
+    bool saveToFile(const std::string& path) const;
+    bool loadFromFile(const std::string& path);
+
+private:
+    CPU& cpu;
+    MemoryBus& memory;
+    GPU& gpu;
+    Timer& timer;
+    Serial& serial;
+    APU& apu;
+    Cartridge& cart;
+    Scheduler& scheduler;
+
+    // Identifies the cartridge a state belongs to
+    uint32_t romChecksum() const;
+
+    void write(StateWriter& writer) const;
+};
@@ -0,0 +1,96 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <functional>
+
+class StateWriter;
+class StateReader;
+
+// Events the scheduler can hold. Each type has at most one pending event at a
+// time; scheduling it again moves the existing event instead of adding another
+enum class EventType : uint8_t {
+    PPU_MODE = 0,      // Next PPU mode transition (OAM/TRANSFER/HBLANK/VBLANK boundary)
+    TIMER_OVERFLOW,    // TIMA overflow reload and timer interrupt
+    DMA_COMPLETE,      // End of an OAM DMA transfer
+    SERIAL_TRANSFER,   // Last bit of a serial transfer shifted out
+    COUNT
+};
+
+// Central event scheduler keyed on absolute CPU cycle timestamps.
+// The CPU runs uninterrupted until nextEventTime(), then dispatchDue() runs the
+// handlers of every event that has become due. Handlers are expected to bring
+// their component up to date and schedule their next event themselves.
+//
+// An instruction can move an event earlier (a TIMA or TAC write moves the
+// timer overflow), so the CPU doesn't take the next event time once per
+// slice: it reads it live through getNextEventSource() after every
+// instruction
+class Scheduler {
+public:
+    using Handler = std::function<void(uint64_t now)>;
+
+    // Returned by nextEventTime() when nothing is scheduled
+    static constexpr uint64_t NO_EVENT = UINT64_MAX;
+
+    Scheduler();
+
+    // The cycle counter all timestamps are relative to (the CPU's cycle count)
+    void setClock(const uint64_t* clock_ptr) { clock = clock_ptr; }
+    uint64_t now() const { return clock ? *clock : 0; }
+
+    // Set the function called when an event of the given type is due
+    void setHandler(EventType type, Handler handler);
+
+    // Schedule (or reschedule) an event at an absolute cycle timestamp
+    void schedule(EventType type, uint64_t when);
+
+    // Schedule (or reschedule) an event relative to the current time
+    void scheduleIn(EventType type, uint64_t delay) { schedule(type, now() + delay); }
+
+    // Remove a pending event, if any
+    void cancel(EventType type);
+
+    bool isScheduled(EventType type) const { return positions[index(type)] != NOT_QUEUED; }
+    uint64_t getEventTime(EventType type) const;
+
+    // Timestamp of the earliest pending event, or NO_EVENT
+    uint64_t nextEventTime() const { return next_event_time; }
+    
+    // The same, kept up to date as events are scheduled; the CPU's slice limit
+    const uint64_t* getNextEventSource() const { return &next_event_time; }
+
+    // Run the handlers of all events due at or before now().
+    // Returns the number of events dispatched
+    int dispatchDue();
+
+    // Save state support (see savestate.hpp): the pending event times.
+    // Handlers and the clock are wiring and are left alone
+    void saveState(StateWriter& writer) const;
+    void loadState(StateReader& reader);
+
+private:
+    static constexpr size_t EVENT_COUNT = static_cast<size_t>(EventType::COUNT);
+    static constexpr uint8_t NOT_QUEUED = 0xFF;
+
+    struct Event {
+        uint64_t when;
+        EventType type;
+    };
+
+    static size_t index(EventType type) { return static_cast<size_t>(type); }
+
+    // Binary min-heap helpers; positions[] tracks where each type lives in the heap
+    void siftUp(size_t pos);
+    void siftDown(size_t pos);
+    void swapEntries(size_t a, size_t b);
+    void removeAt(size_t pos);
+    void updateNextEvent() { next_event_time = size > 0 ? heap[0].when : NO_EVENT; }
+
+    std::array<Event, EVENT_COUNT> heap;
+    std::array<uint8_t, EVENT_COUNT> positions;
+    size_t size;
+    uint64_t next_event_time = NO_EVENT;  // heap[0].when, or NO_EVENT when empty
+
+    std::array<Handler, EVENT_COUNT> handlers;
+    const uint64_t* clock;
+};
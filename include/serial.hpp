@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+
+class MemoryBus;
+class Scheduler;
+class StateWriter;
+class StateReader;
+
+// Serial port (SB 0xFF01, SC 0xFF02) with nothing plugged in.
+//
+// A transfer on the internal clock shifts SB out at 8192 Hz; after 8 bits
+// (4096 T-cycles) SB holds what came in - 0xFF, as no other Game Boy is
+// driving the line - SC bit 7 clears and the serial interrupt is requested.
+// Transfers on the external clock never finish, like on hardware without a
+// link partner. Every byte sent is captured, which is how test ROMs report
+// their results.
+class Serial {
+public:
+    explicit Serial(MemoryBus& memory);
+
+    // Without a scheduler, transfers complete as soon as they start
+    void setScheduler(Scheduler* scheduler_ptr) { scheduler = scheduler_ptr; }
+
+    uint8_t readRegister(uint16_t address) const;
+    void writeRegister(uint16_t address, uint8_t value);
+
+    // SERIAL_TRANSFER event: the byte in SB has been shifted out
+    void completeTransfer();
+
+    // Called with every byte sent, as it finishes sending
+    void setOutputCallback(std::function<void(uint8_t)> callback) { output_callback = callback; }
+
+    // Everything sent since the last clearOutput()
+    const std::string& getOutput() const { return output; }
+    void clearOutput() { output.clear(); }
+
+    // Save state support (see savestate.hpp). The captured output isn't
+    // machine state and is left alone
+    void saveState(StateWriter& writer) const;
+    void loadState(StateReader& reader);
+
+private:
+    MemoryBus& memory;
+    Scheduler* scheduler = nullptr;
+
+    uint8_t sb = 0x00;  // Serial transfer data
+    uint8_t sc = 0x00;  // Serial control: bit 7 = transfer in progress, bit 0 = internal clock
+
+    std::string output;
+    std::function<void(uint8_t)> output_callback;
+};
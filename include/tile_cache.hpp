@@ -0,0 +1,42 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+// Decoded copy of the 384 tiles in VRAM tile data (0x8000-0x97FF).
+// Each tile is kept as 8x8 color indices (0-3), one byte per pixel, so the
+// renderers can copy a row instead of recombining the two bit planes for
+// every pixel. MemoryBus marks a tile dirty whenever one of its 16 bytes is
+// written, and the tile is decoded again the next time it's used
+class TileCache {
+public:
+    static constexpr int TILE_COUNT = 384;
+    static constexpr uint16_t TILE_DATA_SIZE = TILE_COUNT * 16;
+
+    // `vram` is the 8KB VRAM array the tiles are decoded from
+    explicit TileCache(const uint8_t* vram);
+
+    // Called for every VRAM write; offsets past the tile data are ignored
+    void markDirty(uint16_t vram_offset) {
+        if (vram_offset < TILE_DATA_SIZE) {
+            dirty[vram_offset >> 4] = true;
+        }
+    }
+
+    // Mark every tile dirty (after VRAM was replaced wholesale)
+    void invalidateAll() { dirty.fill(true); }
+
+    // The 8 color indices of one row of a tile (0-383), left to right
+    const uint8_t* getRow(uint16_t tile, uint8_t row) {
+        if (dirty[tile]) {
+            decodeTile(tile);
+        }
+        return &pixels[tile][row * 8];
+    }
+
+private:
+    void decodeTile(uint16_t tile);
+
+    const uint8_t* vram;
+    std::array<std::array<uint8_t, 64>, TILE_COUNT> pixels;
+    std::array<bool, TILE_COUNT> dirty;
+};
@@ -2,23 +2,44 @@
 #include <cstdint>
 
 class MemoryBus;
+class Scheduler;
+class StateWriter;
+class StateReader;
 
 class Timer {
 public:
     explicit Timer(MemoryBus& memory);
     
-    void tick(uint8_t cycles);
+    // Advance the timer by a number of T-cycles, jumping from one TIMA
+    // increment to the next rather than stepping every cycle
+    void tick(uint32_t cycles);
+    
+    // Scheduler integration: once a scheduler is set the timer is advanced
+    // lazily. Register accesses and the TIMER_OVERFLOW event bring it up to
+    // the scheduler's current time, after which the next overflow is scheduled
+    void setScheduler(Scheduler* scheduler_ptr);
+    void sync(uint64_t now);
+    
+    // Cycles from the last sync until the timer raises its next interrupt
+    // (UINT64_MAX when the timer is stopped)
+    uint64_t cyclesUntilInterrupt() const;
     
     // Timer registers
-    uint8_t readRegister(uint16_t address) const;
+    uint8_t readRegister(uint16_t address);
     void writeRegister(uint16_t address, uint8_t value);
     
     // Timer interrupt checking
     bool isInterruptRequested() const { return interrupt_requested; }
     void clearInterruptRequest() { interrupt_requested = false; }
     
+    // Save state support (see savestate.hpp)
+    void saveState(StateWriter& writer) const;
+    void loadState(StateReader& reader);
+    
 private:
     MemoryBus& memory;
+    Scheduler* scheduler;
+    uint64_t last_sync_cycle;    // Scheduler time the timer was last brought up to
     
     // Timer registers
     uint16_t div_counter;    // Internal counter for DIV register
@@ -33,5 +54,7 @@ private:
     
     // Helper methods
     uint32_t getTimerFrequency() const;
+    uint32_t getTimerPeriod() const;   // T-cycles between TIMA increments
     bool isTimerEnabled() const;
+    void scheduleOverflow();
 }; 
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Three frame buffers shared between the emulation loop (producer) and the
+// presenter thread (consumer). Lock-free: the producer always has a back
+// buffer of its own to fill, the consumer always has a front buffer of its
+// own to draw from, and the third sits between them. Publishing and taking
+// a frame are a single atomic exchange of that middle buffer, so neither
+// side ever waits for the other.
+//
+// The consumer always gets the most recent complete frame. Frames published
+// faster than they're taken are overwritten, never queued.
+class TripleBuffer {
+public:
+    explicit TripleBuffer(size_t frame_pixels);
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Producer side: fill back(), then publish() it. The producer gets a
+    // different buffer back, with stale contents
+    uint32_t* back() { return frames[back_index].data(); }
+    void publish();
+
+    // Producer side: copy a whole frame in and publish it
+    void publish(const uint32_t* pixels);
+
+    // Consumer side. Returns false if nothing was published since the last
+    // call; front() is then still the frame taken before
+    bool acquire();
+    const uint32_t* front() const { return frames[front_index].data(); }
+
+    size_t framePixels() const { return frames[0].size(); }
+
+private:
+    static constexpr uint8_t INDEX_MASK = 0x03;
+    static constexpr uint8_t FRESH = 0x04;  // Set in middle when it holds an untaken frame
+
+    std::vector<uint32_t> frames[3];
+
+    // Buffer index owned by each side, and the one between them
+    uint8_t back_index = 0;
+    uint8_t front_index = 1;
+    alignas(64) std::atomic<uint8_t> middle{2};
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// Streams 16-bit stereo PCM to a .wav file. The header's sizes are filled in
+// by close(), so a file cut short by a crash still plays up to that point in
+// most players.
+class WavWriter {
+public:
+    WavWriter() = default;
+    ~WavWriter() { close(); }
+
+    WavWriter(const WavWriter&) = delete;
+    WavWriter& operator=(const WavWriter&) = delete;
+
+    // Create (or truncate) the file and write a header. False if it can't be created
+    bool open(const std::string& path, uint32_t sample_rate);
+    bool isOpen() const { return file.is_open(); }
+
+    // Append interleaved stereo frames
+    void write(const int16_t* samples, size_t frames);
+
+    // Patch the header sizes and close the file
+    void close();
+
+    uint64_t getFramesWritten() const { return frames_written; }
+
+private:
+    std::ofstream file;
+    uint64_t frames_written = 0;
+
+    void writeHeader(uint32_t sample_rate, uint32_t data_bytes);
+};
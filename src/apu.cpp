@@ -0,0 +1,515 @@
+#include "apu.hpp"
+#include "scheduler.hpp"
+#include "savestate.hpp"
+#include "log.hpp"
+#include <algorithm>
+
+// Register offsets from 0xFF10. Channel n's NRn0-NRn4 are at 5n..5n+4
+// (NR20 and NR40 don't exist)
+constexpr uint16_t APU_REGISTERS_START = 0xFF10;
+constexpr int NR10 = 0x00;
+constexpr int NR30 = 0x0A;
+constexpr int NR43 = 0x12;
+constexpr int NR50 = 0x14;
+constexpr int NR51 = 0x15;
+constexpr int NR52 = 0x16;
+constexpr int WAVE_RAM = 0x20;
+
+// Bits that read back as 1 whatever was written (write-only and unused bits)
+static const uint8_t READ_MASKS[0x20] = {
+    0x80, 0x3F, 0x00, 0xFF, 0xBF,  // NR10-NR14
+    0xFF, 0x3F, 0x00, 0xFF, 0xBF,  // NR20-NR24
+    0x7F, 0xFF, 0x9F, 0xFF, 0xBF,  // NR30-NR34
+    0xFF, 0xFF, 0x00, 0x00, 0xBF,  // NR40-NR44
+    0x00, 0x00, 0x70,              // NR50-NR52
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+// Square wave duty cycles, one bit per step (step 0 = bit 0)
+static const uint8_t DUTY_PATTERNS[4] = {0x80, 0x81, 0xE1, 0x7E};
+
+static const uint16_t NOISE_DIVISORS[8] = {8, 16, 32, 48, 64, 80, 96, 112};
+
+// Mixer output for a full-scale channel is 15 * 8 (NR50 volume); the gain
+// leaves room for all four channels at once after DC removal
+constexpr int32_t OUTPUT_GAIN = 64;
+
+static int registerBase(int channel) { return channel * 5; }
+static uint16_t lengthMax(int channel) { return channel == 2 ? 256 : 64; }
+
+APU::APU()
+    : blip_left(CLOCK_RATE, SAMPLE_RATE, FLUSH_CYCLES + FRAME_SEQUENCER_PERIOD),
+      blip_right(CLOCK_RATE, SAMPLE_RATE, FLUSH_CYCLES + FRAME_SEQUENCER_PERIOD) {
+    // Powered on, as the boot ROM leaves it; the post-boot register values
+    // are written by the emulator
+    regs[NR52] = 0x80;
+    samples.resize(static_cast<size_t>(static_cast<uint64_t>(FLUSH_CYCLES + FRAME_SEQUENCER_PERIOD) * SAMPLE_RATE / CLOCK_RATE + 1) * 4);
+}
+
+uint64_t APU::now() const {
+    return scheduler ? scheduler->now() : last_sync;
+}
+
+bool APU::isDACEnabled(int channel) const {
+    if (channel == 2) {
+        return (regs[NR30] & 0x80) != 0;
+    }
+    return (regs[registerBase(channel) + 2] & 0xF8) != 0;
+}
+
+uint16_t APU::getFrequency(int channel) const {
+    int base = registerBase(channel);
+    return static_cast<uint16_t>(((regs[base + 4] & 0x07) << 8) | regs[base + 3]);
+}
+
+uint32_t APU::getPeriod(int channel) const {
+    switch (channel) {
+        case 0:
+        case 1:
+            return (2048 - getFrequency(channel)) * 4;
+        case 2:
+            return (2048 - getFrequency(channel)) * 2;
+        default: {
+            // Clock shifts 14 and 15 stop the LFSR
+            uint8_t shift = regs[NR43] >> 4;
+            return shift >= 14 ? 0 : static_cast<uint32_t>(NOISE_DIVISORS[regs[NR43] & 0x07]) << shift;
+        }
+    }
+}
+
+uint8_t APU::digitalOutput(int channel) const {
+    const Channel& ch = channels[channel];
+    if (!ch.enabled) {
+        return 0;
+    }
+
+    switch (channel) {
+        case 0:
+        case 1: {
+            uint8_t duty = regs[registerBase(channel) + 1] >> 6;
+            return ((DUTY_PATTERNS[duty] >> ch.position) & 1) ? ch.volume : 0;
+        }
+        case 2: {
+            // 32 4-bit samples, high nibble first; NR32 selects 0/100/50/25%
+            static const uint8_t SHIFTS[4] = {4, 0, 1, 2};
+            uint8_t byte = regs[WAVE_RAM + ch.position / 2];
+            uint8_t sample = (ch.position & 1) ? (byte & 0x0F) : (byte >> 4);
+            return sample >> SHIFTS[(regs[NR30 + 2] >> 5) & 0x03];
+        }
+        default:
+            return (lfsr & 1) ? 0 : ch.volume;
+    }
+}
+
+uint8_t APU::readRegister(uint16_t address) {
+    int offset = address - APU_REGISTERS_START;
+    if (offset >= WAVE_RAM) {
+        return regs[offset];
+    }
+
+    if (offset == NR52) {
+        // Channel status changes as length counters run out
+        sync(now());
+        uint8_t status = regs[NR52] | READ_MASKS[NR52];
+        for (int i = 0; i < 4; i++) {
+            if (channels[i].enabled) {
+                status |= 1 << i;
+            }
+        }
+        return status;
+    }
+    return regs[offset] | READ_MASKS[offset];
+}
+
+void APU::writeRegister(uint16_t address, uint8_t value) {
+    uint64_t time = std::max(now(), last_sync);
+    sync(time);
+
+    int offset = address - APU_REGISTERS_START;
+    if (offset >= WAVE_RAM) {
+        regs[offset] = value;
+        updateOutput(2, time);
+        return;
+    }
+
+    if (offset == NR52) {
+        bool power = (value & 0x80) != 0;
+        if (power && !isPowered()) {
+            GB_LOG_DEBUG(LOG_MEMORY, "Sound powered on");
+            regs[NR52] = 0x80;
+            frame_sequencer_step = 0;
+            for (Channel& ch : channels) {
+                ch.position = 0;
+            }
+        } else if (!power && isPowered()) {
+            GB_LOG_DEBUG(LOG_MEMORY, "Sound powered off");
+            powerOff(time);
+        }
+        return;
+    }
+
+    // Everything but NR52 and wave RAM is read-only while powered off
+    if (!isPowered() || offset > NR52) {
+        return;
+    }
+    regs[offset] = value;
+
+    if (offset == NR50 || offset == NR51) {
+        for (int i = 0; i < 4; i++) {
+            mix(i, time);
+        }
+        return;
+    }
+
+    int channel = offset / 5;
+    Channel& ch = channels[channel];
+    switch (offset % 5) {
+        case 1:  // Length
+            ch.length = lengthMax(channel) - (channel == 2 ? value : (value & 0x3F));
+            break;
+        case 0:  // NR30: wave DAC switch
+        case 2:  // Envelope; its upper 5 bits double as the DAC switch
+            if (!isDACEnabled(channel)) {
+                ch.enabled = false;
+            }
+            break;
+        case 4:  // Trigger
+            if (value & 0x80) {
+                trigger(channel, time);
+            }
+            break;
+        default:
+            break;
+    }
+    updateOutput(channel, time);
+}
+
+void APU::trigger(int channel, uint64_t time) {
+    Channel& ch = channels[channel];
+    ch.enabled = isDACEnabled(channel);
+    if (ch.length == 0) {
+        ch.length = lengthMax(channel);
+    }
+
+    // The first step comes one whole period after the trigger
+    uint32_t period = getPeriod(channel);
+    ch.next_step = time + (period ? period : 1);
+
+    int base = registerBase(channel);
+    ch.volume = regs[base + 2] >> 4;
+    ch.envelope_timer = regs[base + 2] & 0x07;
+
+    if (channel == 2) {
+        ch.position = 0;
+    } else if (channel == 3) {
+        lfsr = 0x7FFF;
+    } else if (channel == 0) {
+        uint8_t pace = (regs[NR10] >> 4) & 0x07;
+        uint8_t shift = regs[NR10] & 0x07;
+        shadow_frequency = getFrequency(0);
+        sweep_timer = pace ? pace : 8;
+        sweep_enabled = pace != 0 || shift != 0;
+        if (shift != 0 && calculateSweep() > 2047) {
+            ch.enabled = false;
+        }
+    }
+}
+
+void APU::sync(uint64_t now) {
+    while (last_sync < now) {
+        uint64_t next_sequencer = (last_sync / FRAME_SEQUENCER_PERIOD + 1) * FRAME_SEQUENCER_PERIOD;
+        uint64_t until = std::min(now, next_sequencer);
+
+        // Each channel runs on its own; the blip buffers don't mind deltas
+        // arriving out of order
+        for (int i = 0; i < 4; i++) {
+            runChannel(i, until);
+        }
+        last_sync = until;
+
+        if (until == next_sequencer && isPowered()) {
+            clockFrameSequencer(until);
+        }
+        if (isSynthesizing() && last_sync - frame_start >= FLUSH_CYCLES) {
+            flushSamples();
+        }
+    }
+}
+
+void APU::runChannel(int channel, uint64_t to) {
+    Channel& ch = channels[channel];
+    if (!ch.enabled) {
+        return;
+    }
+
+    uint32_t period = getPeriod(channel);
+    if (period == 0) {
+        // Frozen noise: look again once the clock shift changes
+        ch.next_step = to + 1;
+        return;
+    }
+
+    while (ch.next_step <= to) {
+        uint64_t time = ch.next_step;
+        ch.next_step += period;
+
+        if (channel < 2) {
+            ch.position = (ch.position + 1) & 0x07;
+        } else if (channel == 2) {
+            ch.position = (ch.position + 1) & 0x1F;
+        } else {
+            uint16_t bit = (lfsr ^ (lfsr >> 1)) & 1;
+            lfsr = static_cast<uint16_t>((lfsr >> 1) | (bit << 14));
+            if (regs[NR43] & 0x08) {
+                // 7-bit mode: the feedback also goes into bit 6
+                lfsr = static_cast<uint16_t>((lfsr & ~0x40) | (bit << 6));
+            }
+        }
+        updateOutput(channel, time);
+    }
+}
+
+void APU::clockFrameSequencer(uint64_t time) {
+    // Length on even steps, sweep on 2 and 6, envelope on 7
+    if ((frame_sequencer_step & 1) == 0) {
+        clockLength();
+    }
+    if (frame_sequencer_step == 2 || frame_sequencer_step == 6) {
+        clockSweep();
+    }
+    if (frame_sequencer_step == 7) {
+        clockEnvelope();
+    }
+    frame_sequencer_step = (frame_sequencer_step + 1) & 0x07;
+
+    for (int i = 0; i < 4; i++) {
+        updateOutput(i, time);
+    }
+}
+
+void APU::clockLength() {
+    for (int i = 0; i < 4; i++) {
+        Channel& ch = channels[i];
+        bool length_enabled = (regs[registerBase(i) + 4] & 0x40) != 0;
+        if (length_enabled && ch.length > 0 && --ch.length == 0) {
+            ch.enabled = false;
+        }
+    }
+}
+
+uint16_t APU::calculateSweep() const {
+    uint16_t delta = shadow_frequency >> (regs[NR10] & 0x07);
+    return (regs[NR10] & 0x08) ? shadow_frequency - delta : shadow_frequency + delta;
+}
+
+void APU::clockSweep() {
+    if (sweep_timer > 0) {
+        sweep_timer--;
+    }
+    if (sweep_timer != 0) {
+        return;
+    }
+
+    uint8_t pace = (regs[NR10] >> 4) & 0x07;
+    sweep_timer = pace ? pace : 8;
+    if (!sweep_enabled || pace == 0) {
+        return;
+    }
+
+    uint16_t frequency = calculateSweep();
+    if (frequency > 2047) {
+        channels[0].enabled = false;
+        return;
+    }
+    if ((regs[NR10] & 0x07) != 0) {
+        shadow_frequency = frequency;
+        regs[NR10 + 3] = frequency & 0xFF;
+        regs[NR10 + 4] = static_cast<uint8_t>((regs[NR10 + 4] & ~0x07) | (frequency >> 8));
+
+        // Overflow is checked again with the new frequency
+        if (calculateSweep() > 2047) {
+            channels[0].enabled = false;
+        }
+    }
+}
+
+void APU::clockEnvelope() {
+    for (int i : {0, 1, 3}) {
+        Channel& ch = channels[i];
+        uint8_t envelope = regs[registerBase(i) + 2];
+        uint8_t pace = envelope & 0x07;
+        if (pace == 0) {
+            continue;
+        }
+        if (ch.envelope_timer > 0) {
+            ch.envelope_timer--;
+        }
+        if (ch.envelope_timer == 0) {
+            ch.envelope_timer = pace;
+            if ((envelope & 0x08) && ch.volume < 15) {
+                ch.volume++;
+            } else if (!(envelope & 0x08) && ch.volume > 0) {
+                ch.volume--;
+            }
+        }
+    }
+}
+
+void APU::powerOff(uint64_t time) {
+    // Every register up to NR51 is cleared; wave RAM is kept
+    std::fill(regs.begin(), regs.begin() + NR52 + 1, 0);
+    for (int i = 0; i < 4; i++) {
+        channels[i].enabled = false;
+        updateOutput(i, time);
+    }
+}
+
+void APU::updateOutput(int channel, uint64_t time) {
+    uint8_t output = digitalOutput(channel);
+    if (output != channels[channel].output) {
+        channels[channel].output = output;
+        mix(channel, time);
+    }
+}
+
+void APU::mix(int channel, uint64_t time) {
+    if (!isSynthesizing()) {
+        return;
+    }
+
+    // NR51 routes each channel to either side, NR50 sets each side's volume (1-8)
+    Channel& ch = channels[channel];
+    int32_t left = (regs[NR51] & (0x10 << channel)) ? ch.output * (((regs[NR50] >> 4) & 0x07) + 1) : 0;
+    int32_t right = (regs[NR51] & (0x01 << channel)) ? ch.output * ((regs[NR50] & 0x07) + 1) : 0;
+
+    uint32_t offset = static_cast<uint32_t>(time - frame_start);
+    if (left != ch.left) {
+        blip_left.addDelta(offset, left - ch.left);
+        ch.left = left;
+    }
+    if (right != ch.right) {
+        blip_right.addDelta(offset, right - ch.right);
+        ch.right = right;
+    }
+}
+
+void APU::setSampleCallback(SampleCallback callback) {
+    sync(now());
+    sample_callback = callback;
+    restartOutput();
+}
+
+void APU::suspendOutput() {
+    // Hand over everything up to now, so nothing is pending in the buffers
+    endFrame(now());
+    output_suspended = true;
+}
+
+void APU::resumeOutput() {
+    output_suspended = false;
+    
+    // Back where output stopped (the run-ahead case), the blip buffers carry
+    // on as if nothing happened; anywhere else they start afresh
+    if (last_sync != frame_start) {
+        restartOutput();
+        return;
+    }
+    for (int i = 0; i < 4; i++) {
+        mix(i, last_sync);
+    }
+}
+
+void APU::restartOutput() {
+    if (output_suspended) {
+        return;
+    }
+    blip_left.clear();
+    blip_right.clear();
+    frame_start = last_sync;
+    for (int i = 0; i < 4; i++) {
+        channels[i].left = 0;
+        channels[i].right = 0;
+        mix(i, last_sync);
+    }
+}
+
+void APU::endFrame(uint64_t now) {
+    if (!isSynthesizing()) {
+        return;
+    }
+    sync(now);
+    flushSamples();
+}
+
+void APU::flushSamples() {
+    uint32_t length = static_cast<uint32_t>(last_sync - frame_start);
+    blip_left.endFrame(length);
+    blip_right.endFrame(length);
+    frame_start = last_sync;
+
+    size_t count = std::min(blip_left.samplesAvailable(), samples.size() / 2);
+    blip_left.readSamples(samples.data(), count, 2, OUTPUT_GAIN);
+    blip_right.readSamples(samples.data() + 1, count, 2, OUTPUT_GAIN);
+    if (count > 0) {
+        sample_callback(samples.data(), count);
+    }
+}
+
+void APU::reset() {
+    last_sync = now();
+    regs.fill(0);
+    regs[NR52] = 0x80;
+    channels = {};
+    frame_sequencer_step = 0;
+    shadow_frequency = 0;
+    sweep_timer = 0;
+    sweep_enabled = false;
+    lfsr = 0x7FFF;
+    restartOutput();
+}
+
+void APU::saveState(StateWriter& writer) const {
+    writer.beginChunk("APU ");
+    writer.write64(last_sync);
+    writer.writeBytes(regs.data(), regs.size());
+    writer.write8(frame_sequencer_step);
+    for (const Channel& ch : channels) {
+        writer.writeBool(ch.enabled);
+        writer.write16(ch.length);
+        writer.write64(ch.next_step);
+        writer.write8(ch.position);
+        writer.write8(ch.volume);
+        writer.write8(ch.envelope_timer);
+    }
+    writer.write16(shadow_frequency);
+    writer.write8(sweep_timer);
+    writer.writeBool(sweep_enabled);
+    writer.write16(lfsr);
+    writer.endChunk();
+}
+
+void APU::loadState(StateReader& reader) {
+    if (!reader.openChunk("APU ")) {
+        return;
+    }
+    last_sync = reader.read64();
+    reader.readBytes(regs.data(), regs.size());
+    frame_sequencer_step = reader.read8() & 0x07;
+    for (Channel& ch : channels) {
+        ch.enabled = reader.readBool();
+        ch.length = reader.read16();
+        ch.next_step = reader.read64();
+        ch.position = reader.read8();
+        ch.volume = reader.read8();
+        ch.envelope_timer = reader.read8();
+    }
+    shadow_frequency = reader.read16();
+    sweep_timer = reader.read8();
+    sweep_enabled = reader.readBool();
+    lfsr = reader.read16();
+
+    for (int i = 0; i < 4; i++) {
+        channels[i].output = digitalOutput(i);
+    }
+    restartOutput();
+}
@@ -0,0 +1,41 @@
+#include "audio_ring.hpp"
+#include <algorithm>
+#include <cstring>
+
+AudioRing::AudioRing(size_t capacity_frames) {
+    size_t capacity = 1;
+    while (capacity < capacity_frames) {
+        capacity <<= 1;
+    }
+    mask = capacity - 1;
+    buffer.assign(capacity * 2, 0);
+}
+
+size_t AudioRing::push(const int16_t* samples, size_t frames) {
+    size_t write = write_pos.load(std::memory_order_relaxed);
+    size_t read = read_pos.load(std::memory_order_acquire);
+    frames = std::min(frames, capacity() - (write - read));
+
+    // In up to two pieces, around the end of the buffer
+    size_t start = write & mask;
+    size_t first = std::min(frames, capacity() - start);
+    std::memcpy(&buffer[start * 2], samples, first * 2 * sizeof(int16_t));
+    std::memcpy(&buffer[0], samples + first * 2, (frames - first) * 2 * sizeof(int16_t));
+
+    write_pos.store(write + frames, std::memory_order_release);
+    return frames;
+}
+
+size_t AudioRing::pop(int16_t* out, size_t frames) {
+    size_t read = read_pos.load(std::memory_order_relaxed);
+    size_t write = write_pos.load(std::memory_order_acquire);
+    frames = std::min(frames, write - read);
+
+    size_t start = read & mask;
+    size_t first = std::min(frames, capacity() - start);
+    std::memcpy(out, &buffer[start * 2], first * 2 * sizeof(int16_t));
+    std::memcpy(out + first * 2, &buffer[0], (frames - first) * 2 * sizeof(int16_t));
+
+    read_pos.store(read + frames, std::memory_order_release);
+    return frames;
+}
@@ -0,0 +1,95 @@
+#include "blip_buffer.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+// Pass band as a fraction of the output Nyquist frequency. A little under 1
+// so the transition band of the short kernel stays mostly below Nyquist
+constexpr double KERNEL_CUTOFF = 0.9;
+
+// Blackman-windowed sinc impulse for each sub-sample phase. Tap i of phase p
+// is the impulse sampled at i - WIDTH/2 - p/PHASES samples from the step, so
+// the output runs WIDTH/2 samples behind the deltas. Each phase is rounded
+// to sum to exactly 1 << KERNEL_BITS, or a sustained level would drift
+void BlipBuffer::makeKernel(int16_t (*taps)[WIDTH]) {
+    const double pi = std::acos(-1.0);
+    for (int phase = 0; phase < PHASES; phase++) {
+        double impulse[WIDTH];
+        double sum = 0.0;
+        for (int i = 0; i < WIDTH; i++) {
+            double t = i - WIDTH / 2 - static_cast<double>(phase) / PHASES;
+            double x = pi * KERNEL_CUTOFF * t;
+            double sinc = x == 0.0 ? 1.0 : std::sin(x) / x;
+            double w = 2.0 * pi * (t + WIDTH / 2) / WIDTH;
+            impulse[i] = sinc * (0.42 - 0.5 * std::cos(w) + 0.08 * std::cos(2.0 * w));
+            sum += impulse[i];
+        }
+
+        int total = 0;
+        for (int i = 0; i < WIDTH; i++) {
+            taps[phase][i] = static_cast<int16_t>(std::lround(impulse[i] / sum * (1 << KERNEL_BITS)));
+            total += taps[phase][i];
+        }
+        taps[phase][WIDTH / 2] += static_cast<int16_t>((1 << KERNEL_BITS) - total);
+    }
+}
+
+BlipBuffer::BlipBuffer(uint32_t clock_rate, uint32_t sample_rate, uint32_t max_frame_clocks) {
+    static const auto shared_kernel = [] {
+        std::array<int16_t[WIDTH], PHASES> taps;
+        makeKernel(taps.data());
+        return taps;
+    }();
+    kernel = shared_kernel.data();
+
+    factor = static_cast<uint64_t>(std::llround(static_cast<double>(sample_rate) / clock_rate * 4294967296.0));
+
+    // A whole frame's samples, whatever is left over from the previous one,
+    // and room for the kernel tail
+    size_t max_samples = static_cast<size_t>((static_cast<uint64_t>(max_frame_clocks) * factor) >> FRAC_BITS);
+    buffer.assign(max_samples * 2 + WIDTH + 1, 0);
+}
+
+void BlipBuffer::clear() {
+    offset &= (1ull << FRAC_BITS) - 1;  // Keep the sub-sample phase
+    integrator = 0;
+    std::fill(buffer.begin(), buffer.end(), 0);
+}
+
+void BlipBuffer::endFrame(uint32_t time) {
+    offset += static_cast<uint64_t>(time) * factor;
+
+    // A reader that has fallen behind loses the oldest samples rather than
+    // overrunning the buffer
+    size_t limit = buffer.size() - WIDTH - 1;
+    if (samplesAvailable() > limit) {
+        size_t excess = samplesAvailable() - limit;
+        std::memmove(buffer.data(), buffer.data() + excess, (buffer.size() - excess) * sizeof(int32_t));
+        std::fill(buffer.end() - excess, buffer.end(), 0);
+        offset -= static_cast<uint64_t>(excess) << FRAC_BITS;
+    }
+}
+
+size_t BlipBuffer::readSamples(int16_t* out, size_t count, size_t stride, int32_t gain) {
+    count = std::min(count, samplesAvailable());
+
+    int32_t sum = integrator;
+    for (size_t i = 0; i < count; i++) {
+        sum += buffer[i];
+        int64_t sample = (static_cast<int64_t>(sum) * gain) >> KERNEL_BITS;
+        out[i * stride] = static_cast<int16_t>(std::clamp<int64_t>(sample, INT16_MIN, INT16_MAX));
+
+        // Leak the integrator towards zero: removes DC, as the capacitor on
+        // the real output does
+        sum -= sum >> BASS_SHIFT;
+    }
+    integrator = sum;
+
+    // Move what's left (the rest of the frame and the kernel tail) down
+    size_t remaining = buffer.size() - count;
+    std::memmove(buffer.data(), buffer.data() + count, remaining * sizeof(int32_t));
+    std::fill(buffer.begin() + remaining, buffer.end(), 0);
+    offset -= static_cast<uint64_t>(count) << FRAC_BITS;
+    return count;
+}
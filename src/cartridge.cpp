@@ -1,4 +1,6 @@
 #include "cartridge.hpp"
+#include "log.hpp"
+#include "savestate.hpp"
 #include <fstream>
 #include <stdexcept>
 #include <iostream>
@@ -138,11 +140,12 @@ static const std::unordered_map<uint8_t, uint32_t> ROM_SIZES = {
 // ROMOnly Implementation
 // ==============================================
 
-ROMOnly::ROMOnly(const std::vector<uint8_t>& rom_data, std::vector<uint8_t>& ram) 
+ROMOnly::ROMOnly(const RomImage& rom_data, std::vector<uint8_t>& ram) 
     : rom(rom_data), ram(ram), ram_enabled(false) {
+    updateBanks();
 }
 
-uint8_t ROMOnly::read(uint16_t addr) const {
+uint8_t ROMOnly::readUnmapped(uint16_t addr) const {
     // ROM area (0x0000 - 0x7FFF)
     if (addr <= 0x7FFF) {
         if (addr < rom.size()) {
@@ -169,6 +172,7 @@ void ROMOnly::write(uint16_t addr, uint8_t value) {
         // Enable/disable RAM if address is in the right range (common for all MBCs)
         if (addr <= 0x1FFF) {
             ram_enabled = ((value & 0x0F) == 0x0A);
+            updateBanks();
         }
         // Otherwise writes to ROM are ignored
     }
@@ -184,16 +188,32 @@ void ROMOnly::write(uint16_t addr, uint8_t value) {
     // Unmapped memory - Ignored
 }
 
+void ROMOnly::updateBanks() {
+    rom0_window = romWindow(rom, 0);
+    romN_window = romWindow(rom, 0x4000);
+    ram_window = ram_enabled ? ramWindow(ram, 0) : nullptr;
+}
+
+void ROMOnly::saveState(StateWriter& writer) const {
+    writer.writeBool(ram_enabled);
+}
+
+void ROMOnly::loadState(StateReader& reader) {
+    ram_enabled = reader.readBool();
+    updateBanks();
+}
+
 // ==============================================
 // MBC1 Implementation
 // ==============================================
 
-MBC1::MBC1(const std::vector<uint8_t>& rom_data, std::vector<uint8_t>& ram, bool has_battery, bool is_multicart)
+MBC1::MBC1(const RomImage& rom_data, std::vector<uint8_t>& ram, bool has_battery, bool is_multicart)
     : rom(rom_data), ram(ram), ram_enabled(false), rom_bank(1), ram_bank(0), 
       mode_select(false), battery(has_battery), multicart(is_multicart) {
+    updateBanks();
 }
 
-uint8_t MBC1::read(uint16_t addr) const {
+uint8_t MBC1::readUnmapped(uint16_t addr) const {
     // ROM Bank 0 (0x0000 - 0x3FFF)
     if (addr <= 0x3FFF) {
         uint32_t rom_addr;
@@ -300,6 +320,11 @@ void MBC1::write(uint16_t addr, uint8_t value) {
             }
         }
     }
+    
+    // Every register lives below 0x8000
+    if (addr <= 0x7FFF) {
+        updateBanks();
+    }
 }
 
 uint32_t MBC1::getRomBankStart() const {
@@ -342,6 +367,33 @@ uint32_t MBC1::getRamBankStart() const {
     return 0;
 }
 
+void MBC1::updateBanks() {
+    // Same bank selection as readUnmapped(): mode 1 applies the RAM bank
+    // register to the upper bits of bank 0 too
+    if (mode_select) {
+        rom0_window = romWindow(rom, multicart ? (ram_bank << 18) : (ram_bank << 19));
+    } else {
+        rom0_window = romWindow(rom, 0);
+    }
+    romN_window = romWindow(rom, getRomBankStart());
+    ram_window = ram_enabled ? ramWindow(ram, mode_select ? getRamBankStart() : 0) : nullptr;
+}
+
+void MBC1::saveState(StateWriter& writer) const {
+    writer.writeBool(ram_enabled);
+    writer.write8(rom_bank);
+    writer.write8(ram_bank);
+    writer.writeBool(mode_select);
+}
+
+void MBC1::loadState(StateReader& reader) {
+    ram_enabled = reader.readBool();
+    rom_bank = reader.read8();
+    ram_bank = reader.read8();
+    mode_select = reader.readBool();
+    updateBanks();
+}
+
 bool MBC1::saveRAM(const std::string& save_path) const {
     if (!battery || ram.empty()) {
         return false;
@@ -355,7 +407,7 @@ bool MBC1::saveRAM(const std::string& save_path) const {
     
     file.write(reinterpret_cast<const char*>(ram.data()), ram.size());
     
-    std::cout << "Saved RAM to: " << save_path << " (" << ram.size() << " bytes)" << std::endl;
+    GB_LOG_INFO(LOG_CART, "Saved RAM to: " << save_path << " (" << ram.size() << " bytes)");
     return true;
 }
 
@@ -372,8 +424,8 @@ bool MBC1::loadRAM(const std::string& save_path) {
     
     file.read(reinterpret_cast<char*>(ram.data()), ram.size());
     
-    std::cout << "Loaded RAM from: " << save_path << " (" 
-              << file.gcount() << " of " << ram.size() << " bytes)" << std::endl;
+    GB_LOG_INFO(LOG_CART, "Loaded RAM from: " << save_path << " (" 
+                << file.gcount() << " of " << ram.size() << " bytes)");
     return true;
 }
 
@@ -381,11 +433,12 @@ bool MBC1::loadRAM(const std::string& save_path) {
 // MBC2 Implementation
 // ==============================================
 
-MBC2::MBC2(const std::vector<uint8_t>& rom_data, std::vector<uint8_t>& ram, bool has_battery)
+MBC2::MBC2(const RomImage& rom_data, std::vector<uint8_t>& ram, bool has_battery)
     : rom(rom_data), ram(ram), ram_enabled(false), rom_bank(1), battery(has_battery) {
+    updateBanks();
 }
 
-uint8_t MBC2::read(uint16_t addr) const {
+uint8_t MBC2::readUnmapped(uint16_t addr) const {
     // ROM Bank 0 (0x0000 - 0x3FFF)
     if (addr <= 0x3FFF) {
         if (addr < rom.size()) {
@@ -432,6 +485,7 @@ void MBC2::write(uint16_t addr, uint8_t value) {
             if (rom_bank == 0) {
                 rom_bank = 1;  // Bank 0 is treated as 1
             }
+            updateBanks();
         } else {
             // RAM Enable (bit 8 of address is clear)
             ram_enabled = ((value & 0x0F) == 0x0A);
@@ -449,6 +503,22 @@ void MBC2::write(uint16_t addr, uint8_t value) {
     // Unmapped areas - writes ignored
 }
 
+void MBC2::updateBanks() {
+    rom0_window = romWindow(rom, 0);
+    romN_window = romWindow(rom, rom_bank * 0x4000);
+}
+
+void MBC2::saveState(StateWriter& writer) const {
+    writer.writeBool(ram_enabled);
+    writer.write8(rom_bank);
+}
+
+void MBC2::loadState(StateReader& reader) {
+    ram_enabled = reader.readBool();
+    rom_bank = reader.read8();
+    updateBanks();
+}
+
 bool MBC2::saveRAM(const std::string& save_path) const {
     if (!battery || ram.empty()) {
         return false;
@@ -462,7 +532,7 @@ bool MBC2::saveRAM(const std::string& save_path) const {
     
     file.write(reinterpret_cast<const char*>(ram.data()), ram.size());
     
-    std::cout << "Saved MBC2 RAM to: " << save_path << " (" << ram.size() << " bytes)" << std::endl;
+    GB_LOG_INFO(LOG_CART, "Saved MBC2 RAM to: " << save_path << " (" << ram.size() << " bytes)");
     return true;
 }
 
@@ -479,8 +549,8 @@ bool MBC2::loadRAM(const std::string& save_path) {
     
     file.read(reinterpret_cast<char*>(ram.data()), ram.size());
     
-    std::cout << "Loaded MBC2 RAM from: " << save_path << " (" 
-              << file.gcount() << " of " << ram.size() << " bytes)" << std::endl;
+    GB_LOG_INFO(LOG_CART, "Loaded MBC2 RAM from: " << save_path << " (" 
+                << file.gcount() << " of " << ram.size() << " bytes)");
     return true;
 }
 
@@ -488,7 +558,7 @@ bool MBC2::loadRAM(const std::string& save_path) {
 // MBC3 Implementation
 // ==============================================
 
-MBC3::MBC3(const std::vector<uint8_t>& rom_data, std::vector<uint8_t>& ram, bool has_battery, bool has_rtc)
+MBC3::MBC3(const RomImage& rom_data, std::vector<uint8_t>& ram, bool has_battery, bool has_rtc)
     : rom(rom_data), ram(ram), ram_enabled(false), rom_bank(1), ram_bank(0), 
       battery(has_battery), rtc(has_rtc), rtc_latch(false) {
     
@@ -510,9 +580,11 @@ MBC3::MBC3(const std::vector<uint8_t>& rom_data, std::vector<uint8_t>& ram, bool
     if (rtc) {
         updateRTC();
     }
+    
+    updateBanks();
 }
 
-uint8_t MBC3::read(uint16_t addr) const {
+uint8_t MBC3::readUnmapped(uint16_t addr) const {
     // ROM Bank 0 (0x0000 - 0x3FFF)
     if (addr <= 0x3FFF) {
         if (addr < rom.size()) {
@@ -634,6 +706,11 @@ void MBC3::write(uint16_t addr, uint8_t value) {
             }
         }
     }
+    
+    // Enable, ROM bank and RAM bank/RTC select
+    if (addr <= 0x5FFF) {
+        updateBanks();
+    }
 }
 
 void MBC3::latchRTC() {
@@ -685,6 +762,45 @@ void MBC3::updateRTC() {
     }
 }
 
+void MBC3::updateBanks() {
+    rom0_window = romWindow(rom, 0);
+    romN_window = romWindow(rom, rom_bank * 0x4000);
+    ram_window = (ram_enabled && ram_bank <= 0x07) ? ramWindow(ram, ram_bank * 0x2000) : nullptr;
+}
+
+void MBC3::saveState(StateWriter& writer) const {
+    writer.writeBool(ram_enabled);
+    writer.write8(rom_bank);
+    writer.write8(ram_bank);
+    
+    // Live and latched clock registers
+    const uint8_t rtc_regs[] = {rtc_s, rtc_m, rtc_h, rtc_dl, rtc_dh,
+                                latch_rtc_s, latch_rtc_m, latch_rtc_h, latch_rtc_dl, latch_rtc_dh};
+    writer.writeBytes(rtc_regs, sizeof(rtc_regs));
+    writer.writeBool(rtc_latch);
+}
+
+void MBC3::loadState(StateReader& reader) {
+    ram_enabled = reader.readBool();
+    rom_bank = reader.read8();
+    ram_bank = reader.read8();
+    
+    uint8_t rtc_regs[10];
+    reader.readBytes(rtc_regs, sizeof(rtc_regs));
+    rtc_s = rtc_regs[0];
+    rtc_m = rtc_regs[1];
+    rtc_h = rtc_regs[2];
+    rtc_dl = rtc_regs[3];
+    rtc_dh = rtc_regs[4];
+    latch_rtc_s = rtc_regs[5];
+    latch_rtc_m = rtc_regs[6];
+    latch_rtc_h = rtc_regs[7];
+    latch_rtc_dl = rtc_regs[8];
+    latch_rtc_dh = rtc_regs[9];
+    rtc_latch = reader.readBool();
+    updateBanks();
+}
+
 bool MBC3::saveRAM(const std::string& save_path) const {
     if (!battery || (ram.empty() && !rtc)) {
         return false;
@@ -701,11 +817,8 @@ bool MBC3::saveRAM(const std::string& save_path) const {
         file.write(reinterpret_cast<const char*>(ram.data()), ram.size());
     }
     
-    std::cout << "Saved MBC3 RAM to: " << save_path;
-    if (!ram.empty()) {
-        std::cout << " (" << ram.size() << " bytes)";
-    }
-    std::cout << std::endl;
+    GB_LOG_INFO(LOG_CART, "Saved MBC3 RAM to: " << save_path
+                << (ram.empty() ? "" : " (" + std::to_string(ram.size()) + " bytes)"));
     
     // Save RTC registers if RTC is enabled
     if (rtc) {
@@ -730,8 +843,8 @@ bool MBC3::loadRAM(const std::string& save_path) {
             success = false;
         } else {
             file.read(reinterpret_cast<char*>(ram.data()), ram.size());
-            std::cout << "Loaded MBC3 RAM from: " << save_path 
-                      << " (" << file.gcount() << " of " << ram.size() << " bytes)" << std::endl;
+            GB_LOG_INFO(LOG_CART, "Loaded MBC3 RAM from: " << save_path 
+                        << " (" << file.gcount() << " of " << ram.size() << " bytes)");
         }
     }
     
@@ -811,7 +924,7 @@ bool MBC3::loadRTC(const std::string& save_path) {
     // Latch the updated values
     latchRTC();
     
-    std::cout << "Loaded MBC3 RTC state from: " << save_path << std::endl;
+    GB_LOG_INFO(LOG_CART, "Loaded MBC3 RTC state from: " << save_path);
     return true;
 }
 
@@ -834,19 +947,20 @@ void MBC3::saveRTC(const std::string& save_path) const {
     std::time_t now_time = std::chrono::system_clock::to_time_t(now);
     file.write(reinterpret_cast<const char*>(&now_time), sizeof(now_time));
     
-    std::cout << "Saved MBC3 RTC state to: " << save_path << std::endl;
+    GB_LOG_INFO(LOG_CART, "Saved MBC3 RTC state to: " << save_path);
 }
 
 // ==============================================
 // MBC5 Implementation
 // ==============================================
 
-MBC5::MBC5(const std::vector<uint8_t>& rom_data, std::vector<uint8_t>& ram, bool has_battery, bool has_rumble)
+MBC5::MBC5(const RomImage& rom_data, std::vector<uint8_t>& ram, bool has_battery, bool has_rumble)
     : rom(rom_data), ram(ram), ram_enabled(false), rom_bank(1), ram_bank(0), 
       battery(has_battery), rumble(has_rumble) {
+    updateBanks();
 }
 
-uint8_t MBC5::read(uint16_t addr) const {
+uint8_t MBC5::readUnmapped(uint16_t addr) const {
     // ROM Bank 0 (0x0000 - 0x3FFF)
     if (addr <= 0x3FFF) {
         if (addr < rom.size()) {
@@ -925,6 +1039,30 @@ void MBC5::write(uint16_t addr, uint8_t value) {
             }
         }
     }
+    
+    // Enable, ROM bank and RAM bank
+    if (addr <= 0x5FFF) {
+        updateBanks();
+    }
+}
+
+void MBC5::updateBanks() {
+    rom0_window = romWindow(rom, 0);
+    romN_window = romWindow(rom, rom_bank * 0x4000);
+    ram_window = ram_enabled ? ramWindow(ram, ram_bank * 0x2000) : nullptr;
+}
+
+void MBC5::saveState(StateWriter& writer) const {
+    writer.writeBool(ram_enabled);
+    writer.write16(rom_bank);
+    writer.write8(ram_bank);
+}
+
+void MBC5::loadState(StateReader& reader) {
+    ram_enabled = reader.readBool();
+    rom_bank = reader.read16();
+    ram_bank = reader.read8();
+    updateBanks();
 }
 
 bool MBC5::saveRAM(const std::string& save_path) const {
@@ -940,7 +1078,7 @@ bool MBC5::saveRAM(const std::string& save_path) const {
     
     file.write(reinterpret_cast<const char*>(ram.data()), ram.size());
     
-    std::cout << "Saved MBC5 RAM to: " << save_path << " (" << ram.size() << " bytes)" << std::endl;
+    GB_LOG_INFO(LOG_CART, "Saved MBC5 RAM to: " << save_path << " (" << ram.size() << " bytes)");
     return true;
 }
 
@@ -957,8 +1095,8 @@ bool MBC5::loadRAM(const std::string& save_path) {
     
     file.read(reinterpret_cast<char*>(ram.data()), ram.size());
     
-    std::cout << "Loaded MBC5 RAM from: " << save_path << " (" 
-              << file.gcount() << " of " << ram.size() << " bytes)" << std::endl;
+    GB_LOG_INFO(LOG_CART, "Loaded MBC5 RAM from: " << save_path << " (" 
+                << file.gcount() << " of " << ram.size() << " bytes)");
     return true;
 }
 
@@ -987,7 +1125,7 @@ uint32_t Cartridge::getROMSize() const {
     if (it != ROM_SIZES.end()) {
         return it->second;
     } else {
-        return rom.size(); // Fallback to actual ROM size
+        return rom ? rom->size() : 0; // Fallback to actual ROM size
     }
 }
 
@@ -999,13 +1137,17 @@ uint32_t Cartridge::getRAMSize() const {
     return 0; // No RAM
 }
 
-Cartridge::Cartridge(const std::string& romPath) {
+Cartridge::Cartridge(const std::string& romPath, bool persist_ram) : persist_ram(persist_ram) {
     loadFromFile(romPath);
 }
 
+Cartridge::Cartridge(std::vector<uint8_t> rom_data) : persist_ram(false) {
+    loadFromData(std::move(rom_data));
+}
+
 Cartridge::~Cartridge() {
     // Save battery-backed RAM on destruction if needed
-    if (hasBattery()) {
+    if (persist_ram && hasBattery()) {
         saveRAM();
     }
 }
@@ -1014,30 +1156,32 @@ bool Cartridge::loadFromFile(const std::string& romPath) {
     // Store ROM path for save files
     rom_path = romPath;
     
-    // Open file
-    std::ifstream file(romPath, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) {
-        std::cerr << "Failed to open: " << romPath << std::endl;
+    // Mapped rather than read where possible, and shared with any other
+    // Cartridge that already has this file open
+    std::shared_ptr<const RomImage> image = RomImage::open(romPath);
+    if (!image) {
         return false;
     }
 
-    std::cout << "Opened: " << romPath << std::endl;
+    GB_LOG_INFO(LOG_CART, "Opened: " << romPath << (image->isMapped() ? " (mapped)" : ""));
 
-    // Get file size
-    auto fileSize = file.tellg();
-    file.seekg(0, std::ios::beg);
+    return loadImage(std::move(image));
+}
 
-    // Read the entire ROM file into the rom vector
-    rom.resize(fileSize);
-    file.read(reinterpret_cast<char*>(rom.data()), fileSize);
-    file.close();
+bool Cartridge::loadFromData(std::vector<uint8_t> data) {
+    return loadImage(RomImage::fromData(std::move(data)));
+}
 
-    // Copy header data from ROM
-    if (rom.size() < 0x150) {  // Check if ROM is big enough to contain header
+bool Cartridge::loadImage(std::shared_ptr<const RomImage> image) {
+    rom = std::move(image);
+
+    // Copy header data from ROM. It's only 80 bytes, and a copy can have its
+    // title terminated without touching the (read-only) image
+    if (rom->size() < 0x150) {  // Check if ROM is big enough to contain header
         std::cerr << "ROM file too small to contain header" << std::endl;
         return false;
     }
-    std::memcpy(&header, &rom[0x100], sizeof(CartridgeHeader));
+    std::memcpy(&header, rom->data() + 0x100, sizeof(CartridgeHeader));
 
     // Ensure title is null-terminated
     header.title[15] = 0;
@@ -1049,25 +1193,24 @@ bool Cartridge::loadFromFile(const std::string& romPath) {
     createMBC();
     
     // Load RAM from save file if battery-backed
-    if (hasBattery()) {
+    if (persist_ram && hasBattery()) {
         loadRAM();
     }
 
     // Print cartridge information
-    std::cout << "Cartridge Loaded:\n";
-    std::cout << "\tTitle    : " << header.title << "\n";
-    std::cout << "\tType     : " << std::hex << std::uppercase << std::setw(2) 
-              << std::setfill('0') << static_cast<int>(header.cartridgeType) 
-              << " (" << getCartridgeTypeName() << ")\n";
-    std::cout << "\tROM Size : " << std::dec << (getROMSize() / 1024) << " KB\n";
-    
-    std::cout << "\tRAM Size : " << std::dec << (getRAMSize() / 1024) << " KB\n";
-    
-    std::cout << "\tLIC Code : " << std::hex << std::uppercase << std::setw(2) 
-              << std::setfill('0') << static_cast<int>(header.oldLicenseCode) 
-              << " (" << getPublisherName() << ")\n";
-    std::cout << "\tROM Vers : " << std::hex << std::uppercase << std::setw(2) 
-              << std::setfill('0') << static_cast<int>(header.versionNumber) << "\n";
+    GB_LOG_INFO(LOG_CART, "Cartridge Loaded:\n"
+                << "\tTitle    : " << header.title << "\n"
+                << "\tType     : " << std::hex << std::uppercase << std::setw(2) 
+                << std::setfill('0') << static_cast<int>(header.cartridgeType) 
+                << " (" << getCartridgeTypeName() << ")\n"
+                << "\tROM Size : " << std::dec << (getROMSize() / 1024) << " KB\n"
+                << "\tRAM Size : " << std::dec << (getRAMSize() / 1024) << " KB\n"
+                << "\tLIC Code : " << std::hex << std::uppercase << std::setw(2) 
+                << std::setfill('0') << static_cast<int>(header.oldLicenseCode) 
+                << " (" << getPublisherName() << ")\n"
+                << "\tROM Vers : " << std::hex << std::uppercase << std::setw(2) 
+                << std::setfill('0') << static_cast<int>(header.versionNumber)
+                << std::dec << std::nouppercase << std::setfill(' '));
 
     // Validate checksum
     validateCheckSum();
@@ -1115,47 +1258,47 @@ void Cartridge::createMBC() {
     // Create appropriate MBC based on cartridge type
     switch (header.cartridgeType) {
         case 0x00: // ROM ONLY
-            mbc = std::make_unique<ROMOnly>(rom, ram);
+            mbc = std::make_unique<ROMOnly>(*rom, ram);
             break;
             
         case 0x01: // MBC1
         case 0x02: // MBC1+RAM
         case 0x03: // MBC1+RAM+BATTERY
-            mbc = std::make_unique<MBC1>(rom, ram, has_battery, false);
+            mbc = std::make_unique<MBC1>(*rom, ram, has_battery, false);
             break;
             
         case 0x05: // MBC2
         case 0x06: // MBC2+BATTERY
-            mbc = std::make_unique<MBC2>(rom, ram, has_battery);
+            mbc = std::make_unique<MBC2>(*rom, ram, has_battery);
             break;
             
         case 0x0F: // MBC3+TIMER+BATTERY
         case 0x10: // MBC3+TIMER+RAM+BATTERY
-            mbc = std::make_unique<MBC3>(rom, ram, has_battery, true);
+            mbc = std::make_unique<MBC3>(*rom, ram, has_battery, true);
             break;
             
         case 0x11: // MBC3
         case 0x12: // MBC3+RAM
         case 0x13: // MBC3+RAM+BATTERY
-            mbc = std::make_unique<MBC3>(rom, ram, has_battery, false);
+            mbc = std::make_unique<MBC3>(*rom, ram, has_battery, false);
             break;
             
         case 0x19: // MBC5
         case 0x1A: // MBC5+RAM
         case 0x1B: // MBC5+RAM+BATTERY
-            mbc = std::make_unique<MBC5>(rom, ram, has_battery, false);
+            mbc = std::make_unique<MBC5>(*rom, ram, has_battery, false);
             break;
             
         case 0x1C: // MBC5+RUMBLE
         case 0x1D: // MBC5+RUMBLE+RAM
         case 0x1E: // MBC5+RUMBLE+RAM+BATTERY
-            mbc = std::make_unique<MBC5>(rom, ram, has_battery, true);
+            mbc = std::make_unique<MBC5>(*rom, ram, has_battery, true);
             break;
             
         default:
             // For unsupported MBC types, fallback to ROM only
             std::cerr << "Unsupported MBC type: " << std::hex << (int)header.cartridgeType << std::endl;
-            mbc = std::make_unique<ROMOnly>(rom, ram);
+            mbc = std::make_unique<ROMOnly>(*rom, ram);
             break;
     }
 }
@@ -1201,35 +1344,65 @@ bool Cartridge::loadRAM() {
 }
 
 bool Cartridge::hasBattery() const {
-    return mbc->hasBattery();
+    return mbc && mbc->hasBattery();
+}
+
+void Cartridge::saveState(StateWriter& writer) const {
+    writer.beginChunk("CART");
+    writer.write32(static_cast<uint32_t>(ram.size()));
+    writer.writeBytes(ram.data(), ram.size());
+    mbc->saveState(writer);
+    writer.endChunk();
+}
+
+void Cartridge::loadState(StateReader& reader) {
+    if (!reader.openChunk("CART")) {
+        return;
+    }
+    
+    // RAM size comes from the header, so it can only differ for a corrupt state
+    if (reader.read32() != ram.size()) {
+        reader.fail();
+        return;
+    }
+    reader.readBytes(ram.data(), ram.size());
+    mbc->loadState(reader);
 }
 
 void Cartridge::validateCheckSum() const {
+    // Both checksums are only logged, and the global one reads every byte of
+    // the ROM - which for a mapped image would page in all of it
+    if (GB_LOG_LEVEL < GB_LOG_LEVEL_INFO || !logEnabled(LOG_CART)) {
+        return;
+    }
+    
     // Calculate header checksum
     uint8_t checksum = 0;
     for (uint16_t i = 0x134; i <= 0x14C; i++) {
-        checksum = checksum - rom[i] - 1;
+        checksum = checksum - (*rom)[i] - 1;
     }
     
     // Compare with the value in the header
-    bool header_checksum_valid = (checksum == header.headerChecksum);
+    [[maybe_unused]] bool header_checksum_valid = (checksum == header.headerChecksum);
     
-    std::cout << "\tHeader Checksum : " << std::hex << std::uppercase << std::setw(2) 
-              << std::setfill('0') << static_cast<int>(header.headerChecksum) 
-              << " (" << (header_checksum_valid ? "VALID" : "INVALID") << ")\n";
+    GB_LOG_INFO(LOG_CART, "\tHeader Checksum : " << std::hex << std::uppercase << std::setw(2) 
+                << std::setfill('0') << static_cast<int>(header.headerChecksum) 
+                << " (" << (header_checksum_valid ? "VALID" : "INVALID") << ")"
+                << std::dec << std::nouppercase << std::setfill(' '));
     
     // Calculate global checksum (just for information, not validated by the Game Boy)
     uint16_t global_sum = 0;
-    for (size_t i = 0; i < rom.size(); i++) {
+    for (size_t i = 0; i < rom->size(); i++) {
         // Skip the global checksum bytes themselves
         if (i != 0x14E && i != 0x14F) {
-            global_sum += rom[i];
+            global_sum += (*rom)[i];
         }
     }
     
-    std::cout << "\tGlobal Checksum : " << std::hex << std::uppercase << std::setw(4) 
-              << std::setfill('0') << global_sum
-              << " (Expected: " << std::setw(4) << std::setfill('0') << header.globalChecksum << ")\n";
+    GB_LOG_INFO(LOG_CART, "\tGlobal Checksum : " << std::hex << std::uppercase << std::setw(4) 
+                << std::setfill('0') << global_sum
+                << " (Expected: " << std::setw(4) << std::setfill('0') << header.globalChecksum << ")"
+                << std::dec << std::nouppercase << std::setfill(' '));
 }
 
 
@@ -1,14 +1,14 @@
 #include "cpu.hpp"
-#include "instructions.hpp"
 #include "memory.hpp"
+#include "log.hpp"
+#include "savestate.hpp"
 #include <stdio.h>
-#include <SDL2/SDL.h>
 #include <iostream>
 
 CPU::CPU(MemoryBus& mem) : memory(mem) {
     // Initialize registers to their power-up values
     registers = {};
-    registers.af = 0x01B0;
+    setRegisterAF(0x01B0);
     registers.bc = 0x0013;
     registers.de = 0x00D8;
     registers.hl = 0x014D;
@@ -16,30 +16,36 @@ CPU::CPU(MemoryBus& mem) : memory(mem) {
     registers.pc = 0x0100; // Start execution at 0x0100
 }
 
-void CPU::tick() {
-    // If CPU is stopped, do nothing
+uint8_t CPU::step() {
+    // If CPU is stopped, idle for one M-cycle
     if (stopped) {
-        cycles++;
-        return;
+        cycles += 4;
+        return 4;
     }
     
     // Process interrupts
+    uint64_t cycles_before = cycles;
     bool interrupt_handled = handleInterrupts();
     
-    // If an interrupt was handled, we've already processed cycles
+    // If an interrupt was handled, the dispatch itself is this step
     if (interrupt_handled) {
-        return;
+        return static_cast<uint8_t>(cycles - cycles_before);
     }
     
-    // If halted, just increase cycles and return
+    // If halted, idle for one M-cycle. A pending interrupt ends HALT even
+    // with IME off; execution then continues after the HALT instruction
     if (halted) {
-        cycles++;
-        return;
+        if ((memory.read(0xFF0F) & memory.read(0xFFFF) & 0x1F) == 0) {
+            cycles += 4;
+            return 4;
+        }
+        halted = false;
     }
     
-    // If no pending instruction, fetch a new one
-    if (pending_cycles == 0) {
-        // Debug: Print info at specific addresses that are important for VRAM activity
+#if GB_LOG_LEVEL >= GB_LOG_LEVEL_TRACE
+    // Debug: Print info at specific addresses that are important for VRAM activity.
+    // Only compiled into trace builds - this runs for every instruction
+    if (logEnabled(LOG_CPU)) {
         if (registers.pc == 0x0100) {
             std::cout << "CPU TRACE: Starting execution at entry point 0x0100" << std::endl;
         }
@@ -50,7 +56,7 @@ void CPU::tick() {
         else if (registers.pc == 0x028D || registers.pc == 0x0290) {
             // Common entry points for Tetris VRAM initialization
             std::cout << "CPU TRACE: At VRAM init location: 0x" << std::hex << registers.pc 
-                      << " AF=" << registers.af << " BC=" << registers.bc 
+                      << " AF=" << getRegisterAF() << " BC=" << registers.bc 
                       << " DE=" << registers.de << " HL=" << registers.hl << std::dec << std::endl;
         }
         // Add general instruction trace every 100,000 instructions
@@ -59,350 +65,172 @@ void CPU::tick() {
                       << " Executed " << std::dec << debug_instruction_count << " instructions" 
                       << " Cycles=" << cycles << std::endl;
         }
+    }
+    debug_instruction_count++;
+#endif
 
-        if (halt_bug_active) {
-            // HALT bug: PC is not incremented for the first fetch after HALT
-            halt_bug_active = false;
-            current_opcode = memory.read(registers.pc);
-            
-            // But the next opcode will be fetched from PC+1
-            // This is what makes it a "bug"
-        } else {
-            // Normal instruction fetch
-            current_opcode = memory.read(registers.pc++);
-        }
+    current_opcode = memory.read(registers.pc);
+    if (halt_bug_active) {
+        // HALT bug: PC is not incremented after this fetch, so the byte
+        // following HALT is read twice
+        halt_bug_active = false;
+    } else {
+        registers.pc++;
+    }
+    
+    // EI only takes effect once the instruction after it has run
+    bool enable_ime = ime_pending;
+    
+    // Dispatch straight to the opcode's handler, which executes the whole
+    // instruction and reports its cycles
+    uint8_t instruction_cycles = op_table[current_opcode](*this);
+    cycles += instruction_cycles;
+    instructions++;
+    
+    if (enable_ime && ime_pending) {
+        ime = true;
+        ime_pending = false;
+    }
+    
+    return instruction_cycles;
+}
 
-        debug_instruction_count++;
-        
-        // Get the instruction details from the opcode
-        current_instruction = &instructions.get(current_opcode);
+// Longest polling loop recognised, from its first byte to its JR:
+// LD A,(a16) (3 bytes) then BIT b,A (2 bytes)
+constexpr uint16_t MAX_IDLE_LOOP_BYTES = 5;
+
+uint64_t CPU::runUntil(uint64_t target_cycles) {
+    uint64_t start = cycles;
+    
+    // Events run between calls and may have changed what a loop polls, so
+    // only an iteration made entirely within this call proves anything
+    idle_loop_pc = NO_IDLE_LOOP;
+    
+    // An instruction that moves an event earlier (a timer register write)
+    // ends the slice at that event rather than at target_cycles
+    while (cycles < target_cycles && cycles < *next_event) {
+        // Halted with nothing pending: only a scheduled event can raise an
+        // interrupt, and none is due before the slice ends. Jump there in
+        // whole M-cycles, as stepping would
+        if (idle_skip && (stopped || (halted && (memory.read(0xFF0F) & memory.read(0xFFFF) & 0x1F) == 0))) {
+            uint64_t idle = (sliceEnd(target_cycles) - cycles + 3) & ~uint64_t(3);
+            cycles += idle;
+            skipped_cycles += idle;
+            break;
+        }
         
-        // Fetch any instruction data needed based on addressing mode
-        fetch_adress();
+        uint16_t pc = registers.pc;
+        step();
         
-        // Execute the instruction
-        execute();
-    } else {
-        // Consume a pending cycle
-        pending_cycles--;
+        // A jump a few bytes backwards (or onto itself) may have closed a
+        // polling loop
+        if (idle_skip && registers.pc <= pc && pc - registers.pc <= MAX_IDLE_LOOP_BYTES) {
+            skipIdleLoop(sliceEnd(target_cycles));
+        }
     }
     
-    // Increment total cycle count
-    cycles++;
+    return cycles - start;
 }
 
-void CPU::fetch_instruction(){
-    current_opcode = memory.read(registers.pc);
-    current_instruction = &instructions.get(current_opcode);
+// Whether a polling loop reading addr can be fast-forwarded: the value there
+// must only change at a scheduled event (PPU registers, IF, serial), in an
+// interrupt handler (RAM flags set by an ISR) or not at all
+static bool isIdlePollAddress(uint16_t addr) {
+    // Cartridge RAM may be a real-time clock
+    if (addr >= 0xA000 && addr <= 0xBFFF) {
+        return false;
+    }
+    // DIV and TIMA count between events; neither is the audio unit event-driven
+    if ((addr >= 0xFF04 && addr <= 0xFF07) || (addr >= 0xFF10 && addr <= 0xFF3F)) {
+        return false;
+    }
+    return true;
 }
 
-void CPU::fetch_adress(){
-    // First, increment PC to point to the next byte after opcode
-    registers.pc++;
+uint8_t CPU::idleLoopCycles(uint16_t pc) const {
+    uint16_t addr = pc;
+    uint16_t poll;
+    uint8_t cost;
     
-    // Fetch additional bytes based on addressing mode
-    switch (current_instruction->addr_mode) {
-        case Instructions::AddrMode::IMP:
-            // Implied addressing - no additional bytes needed
-            break;
-            
-        case Instructions::AddrMode::R_D8:
-        case Instructions::AddrMode::MR_D8:
-        case Instructions::AddrMode::D8:
-            // 8-bit immediate data
-            current_instruction_data.immediate_value = memory.read(registers.pc);
-            registers.pc++;
-            break;
-            
-        case Instructions::AddrMode::R_D16:
-        case Instructions::AddrMode::D16:
-        case Instructions::AddrMode::D16_R:
-        case Instructions::AddrMode::A16_R:
-        case Instructions::AddrMode::R_A16:
-            // 16-bit immediate data (little endian)
-            current_instruction_data.immediate_value = memory.read(registers.pc);
-            registers.pc++;
-            current_instruction_data.immediate_value |= (memory.read(registers.pc) << 8);
-            registers.pc++;
+    // Load the polled value into A
+    switch (memory.read(addr)) {
+        case 0x18:  // JR $ - waits for an interrupt, polling nothing
+            return memory.read(addr + 1) == 0xFE ? 12 : 0;
+        case 0xF0:  // LDH A,(a8)
+            poll = 0xFF00 | memory.read(addr + 1);
+            addr += 2;
+            cost = 12;
+            break;
+        case 0xFA:  // LD A,(a16)
+            poll = memory.read(addr + 1) | (memory.read(addr + 2) << 8);
+            addr += 3;
+            cost = 16;
+            break;
+        case 0x7E:  // LD A,(HL)
+            poll = registers.hl;
+            addr += 1;
+            cost = 8;
             break;
-            
-        case Instructions::AddrMode::R_A8:
-        case Instructions::AddrMode::A8_R:
-            // High RAM address ($FF00 + 8-bit immediate)
-            current_instruction_data.immediate_value = memory.read(registers.pc);
-            registers.pc++;
-            break;
-            
         default:
-            // Other addressing modes don't need additional bytes
-            break;
+            return 0;
     }
-}
-
-void CPU::execute() {
-    // Debug section start
-    // printf("Executing: 0x%02X (%s) at PC: 0x%04X | ", 
-    //        current_opcode, 
-    //        Instructions::get_type_name(current_instruction->type).c_str(),
-    //        registers.pc);
-    
-    // Print addressing mode and registers involved
-    // printf("Mode: %d | ", static_cast<int>(current_instruction->addr_mode));
-    
-    if (current_instruction->reg1 != Instructions::RegType::NONE) {
-        // printf("Reg1: %s ", Instructions::get_reg_name(current_instruction->reg1).c_str());
+    if (!isIdlePollAddress(poll)) {
+        return 0;
     }
     
-    if (current_instruction->reg2 != Instructions::RegType::NONE) {
-        // printf("Reg2: %s ", Instructions::get_reg_name(current_instruction->reg2).c_str());
+    // Optionally test it, touching only A and the flags
+    uint8_t op = memory.read(addr);
+    if (op == 0xFE || op == 0xE6) {
+        // CP d8 / AND d8
+        addr += 2;
+        cost += 8;
+    } else if (op == 0xA7 || op == 0xB7) {
+        // AND A / OR A
+        addr += 1;
+        cost += 4;
+    } else if (op == 0xCB && (memory.read(addr + 1) & 0xC7) == 0x47) {
+        // BIT b,A
+        addr += 2;
+        cost += 8;
     }
     
-    // Print immediate value if applicable
-    if (current_instruction->addr_mode == Instructions::AddrMode::R_D8 || 
-        current_instruction->addr_mode == Instructions::AddrMode::D8 ||
-        current_instruction->addr_mode == Instructions::AddrMode::MR_D8) {
-        // printf("| Imm: 0x%02X ", current_instruction_data.immediate_value & 0xFF);
-    } else if (current_instruction->addr_mode == Instructions::AddrMode::R_D16 || 
-               current_instruction->addr_mode == Instructions::AddrMode::D16 ||
-               current_instruction->addr_mode == Instructions::AddrMode::D16_R) {
-        // printf("| Imm: 0x%04X ", current_instruction_data.immediate_value);
+    // And branch back to the load on the result
+    op = memory.read(addr);
+    if (op != 0x20 && op != 0x28 && op != 0x30 && op != 0x38) {
+        return 0;
     }
-    
-    // Print register values
-    // printf("\n  Registers: A:0x%02X F:0x%02X B:0x%02X C:0x%02X D:0x%02X E:0x%02X H:0x%02X L:0x%02X SP:0x%04X",
-    //        registers.a, registers.f, registers.b, registers.c, 
-    //        registers.d, registers.e, registers.h, registers.l, registers.sp);
-    
-    // Print flags
-    // printf("\n  Flags: Z:%d N:%d H:%d C:%d", 
-    //        getFlag(FLAG_Z) ? 1 : 0, 
-    //        getFlag(FLAG_N) ? 1 : 0, 
-    //        getFlag(FLAG_H) ? 1 : 0, 
-    //        getFlag(FLAG_C) ? 1 : 0);
-    
-    // Print 16-bit register pairs
-    // printf("\n  Pairs: AF:0x%04X BC:0x%04X DE:0x%04X HL:0x%04X\n", 
-    //        registers.af, registers.bc, registers.de, registers.hl);
-    
-    //Debug section end
-    bool branch_taken = false; // Track if branch instructions actually branch
-    
-    // Execute the instruction based on type
-    switch (current_instruction->type) {
-        case Instructions::Type::NOP:
-            // No Operation - does nothing
-            break;
-            
-        case Instructions::Type::LD:
-            // Load instruction - handle different addressing modes
-            executeLD();
-            break;
-            
-        case Instructions::Type::INC:
-            // Increment register or memory
-            executeINC();
-            break;
-            
-        case Instructions::Type::DEC:
-            // Decrement register or memory
-            executeDEC();
-            break;
-            
-        case Instructions::Type::ADD:
-            // Addition
-            executeADD();
-            break;
-            
-        case Instructions::Type::SUB:
-            // Subtraction
-            executeSUB();
-            break;
-            
-        case Instructions::Type::AND:
-            // Logical AND
-            executeAND();
-            break;
-            
-        case Instructions::Type::OR:
-            // Logical OR
-            executeOR();
-            break;
-            
-        case Instructions::Type::XOR:
-            // Logical XOR
-            executeXOR();
-            break;
-            
-        case Instructions::Type::JP:
-            // Jump
-            branch_taken = executeJP();
-            break;
-            
-        case Instructions::Type::JR:
-            // Jump relative
-            branch_taken = executeJR();
-            break;
-            
-        case Instructions::Type::CALL:
-            // Call subroutine
-            branch_taken = executeCALL();
-            break;
-            
-        case Instructions::Type::RET:
-            // Return from subroutine
-            branch_taken = executeRET();
-            break;
-            
-        case Instructions::Type::PUSH:
-            // Push register pair to stack
-            executePUSH();
-            break;
-            
-        case Instructions::Type::POP:
-            // Pop register pair from stack
-            executePOP();
-            break;
-            
-        case Instructions::Type::RLCA:
-            // Rotate Left Circular Accumulator
-            executeRLCA();
-            break;
-        case Instructions::Type::RRCA:
-            // Rotate Right Circular Accumulator
-            executeRRCA();
-            break;
-        case Instructions::Type::STOP:
-            // Stop
-            // Technically this isn't correct but it works.
-            break;
-        case Instructions::Type::RLA:
-            // Rotate Left Accumulator
-            executeRLA();
-            break;
-        case Instructions::Type::RRA:
-            // Rotate Right Accumulator
-            executeRRA();
-            break;
-        case Instructions::Type::DAA:
-            // Decimal Adjust Acccumulator
-            executeDAA();
-            break;
-        case Instructions::Type::CPL:
-            // Complement
-            executeCPL();
-            break;
-        case Instructions::Type::SCF:
-            // Set Carry Flag
-            executeSCF();
-            break;
-        case Instructions::Type::CCF:
-            // Complement Carry Flag
-            executeCCF();
-            break;
-        case Instructions::Type::HALT:
-            // Halt
-            executeHALT();
-            break;
-        case Instructions::Type::ADC:
-            // Add with Carry
-            executeADC();
-            break;
-        case Instructions::Type::SBC:
-            // Subtract with Carry
-            executeSBC();
-            break;
-        case Instructions::Type::CP:
-            // Compare
-            executeCP();
-            break;
-        case Instructions::Type::RETI:
-            // Return from Interrupt
-            executeRETI();
-            break;
-        case Instructions::Type::LDH:
-            // Load High
-            executeLDH();
-            break;
-        case Instructions::Type::DI:
-            // Disable Interrupts
-            executeDI();
-            break;
-        case Instructions::Type::EI:
-            // Enable Interrupts
-            executeEI();
-            break;
-        case Instructions::Type::RST:
-            // Reset
-            executeRST();
-            break;
-        case Instructions::Type::ERR:
-            // Error 
-            break;
-
-        // CB Instructions
-        case Instructions::Type::RLC:
-            // Rotate Left Circular
-            executeRLC();
-            break;
-        case Instructions::Type::RRC:
-            // Rotate Right Circular
-            executeRRC();
-            break;
-        case Instructions::Type::RL:
-            // Rotate Left through carry
-            executeRL();
-            break;
-        case Instructions::Type::RR:
-            // Rotate Right through carry
-            executeRR();
-            break;
-        case Instructions::Type::SLA:
-            // Shift Left Arithmetic
-            executeSLA();
-            break;
-        case Instructions::Type::SRA:
-            // Shift Right Arithmetic
-            executeSRA();
-            break;
-        case Instructions::Type::SWAP:
-            // Swap nibbles
-            executeSWAP();
-            break;
-        case Instructions::Type::SRL:
-            // Shift Right Logical
-            executeSRL();
-            break;
-        case Instructions::Type::BIT:
-            // Test bit
-            executeBIT();
-            break;
-        case Instructions::Type::RES:
-            // Reset bit
-            executeRES();
-            break;
-        case Instructions::Type::SET:
-            // Set bit
-            executeSET();
-            break;
-
-        default:
-            // printf("Unimplemented instruction: %s\n", 
-            //        Instructions::get_type_name(current_instruction->type).c_str());
-            break;
+    int8_t offset = static_cast<int8_t>(memory.read(addr + 1));
+    if (static_cast<uint16_t>(addr + 2 + offset) != pc) {
+        return 0;
     }
-    
-    // Update the cycle count based on the result of the instruction
-    // For conditional instructions, this ensures we use the right cycle count
-    pending_cycles = get_instruction_cycles(current_instruction, branch_taken) - 1;
+    return cost + 12;  // JR cc taken
 }
 
-// Helper to compute cycles for a given instruction
-uint8_t CPU::get_instruction_cycles(const Instructions::Instruction* instr, bool branch_taken) {
-    // For conditional instructions, use alt_cycles when branch is not taken
-    if (instr->cond != Instructions::CondType::NONE) {
-        return branch_taken ? instr->cycles : instr->alt_cycles;
+void CPU::skipIdleLoop(uint64_t target_cycles) {
+    uint16_t pc = registers.pc;
+    uint64_t elapsed = cycles - idle_loop_cycles;
+    bool repeated = pc == idle_loop_pc;
+    idle_loop_pc = pc;
+    idle_loop_cycles = cycles;
+    
+    // Going round once in exactly one iteration's cycles, within this
+    // runUntil() call, means nothing else ran in between (an interrupt would
+    // have added its dispatch), so A and the flags came from the loop reading
+    // the polled value. Until the next event changes it, every further
+    // iteration will be the same. A pending EI would change IME partway, so
+    // leave that to step()
+    if (!repeated || ime_pending || cycles >= target_cycles) {
+        return;
     }
-    return instr->cycles;
+    uint8_t iteration = idleLoopCycles(pc);
+    if (iteration == 0 || elapsed != iteration) {
+        return;
+    }
+    
+    uint64_t skip = (target_cycles - cycles) / iteration * iteration;
+    cycles += skip;
+    skipped_cycles += skip;
+    idle_loop_cycles = cycles;
 }
 
 bool CPU::handleInterrupts() {
@@ -530,7 +358,7 @@ bool CPU::handleInterrupts() {
 // Update the reset method to initialize registers correctly
 void CPU::reset() {
     // Initialize registers to post-boot values for DMG
-    registers.af = 0x01B0;  // A=0x01, F=0xB0 (Z flag set)
+    setRegisterAF(0x01B0);  // A=0x01, F=0xB0 (Z flag set)
     registers.bc = 0x0013;  // B=0x00, C=0x13
     registers.de = 0x00D8;  // D=0x00, E=0xD8
     registers.hl = 0x014D;  // H=0x01, L=0x4D
@@ -539,9 +367,48 @@ void CPU::reset() {
     
     // Enable interrupts by default
     ime = true;
+    ime_pending = false;
     halted = false;
+    halt_bug_active = false;
     stopped = false;
     
     // Reset debug counter
     debug_instruction_count = 0;
 }
+
+void CPU::saveState(StateWriter& writer) const {
+    writer.beginChunk("CPU ");
+    writer.write16(getRegisterAF());
+    writer.write16(registers.bc);
+    writer.write16(registers.de);
+    writer.write16(registers.hl);
+    writer.write16(registers.sp);
+    writer.write16(registers.pc);
+    writer.write64(cycles);
+    writer.write8(current_opcode);
+    writer.writeBool(halted);
+    writer.writeBool(stopped);
+    writer.writeBool(ime);
+    writer.writeBool(ime_pending);
+    writer.writeBool(halt_bug_active);
+    writer.endChunk();
+}
+
+void CPU::loadState(StateReader& reader) {
+    if (!reader.openChunk("CPU ")) {
+        return;
+    }
+    setRegisterAF(reader.read16());
+    registers.bc = reader.read16();
+    registers.de = reader.read16();
+    registers.hl = reader.read16();
+    registers.sp = reader.read16();
+    registers.pc = reader.read16();
+    cycles = reader.read64();
+    current_opcode = reader.read8();
+    halted = reader.readBool();
+    stopped = reader.readBool();
+    ime = reader.readBool();
+    ime_pending = reader.readBool();
+    halt_bug_active = reader.readBool();
+}
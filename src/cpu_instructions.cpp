@@ -1,1083 +1,643 @@
 #include "cpu.hpp"
-#include "instructions.hpp"
 #include "memory.hpp"
-#include <stdio.h>
+#include <array>
+#include <utility>
 
-// Helper methods for instruction execution
-void CPU::executeLD() {
-    // Load instruction - handles different addressing modes
-    switch (current_instruction->addr_mode) {
-        case Instructions::AddrMode::R_R: {
-            // Register to register
-            uint8_t value = getRegister8Bit(current_instruction->reg2);
-            setRegister8Bit(current_instruction->reg1, value);
-            break;
-        }
-        
-        case Instructions::AddrMode::R_D8: {
-            // Load immediate 8-bit value into register
-            setRegister8Bit(current_instruction->reg1, current_instruction_data.immediate_value & 0xFF);
-            break;
-        }
-        
-        case Instructions::AddrMode::R_D16: {
-            // Load immediate 16-bit value into register pair
-            setRegister16Bit(current_instruction->reg1, current_instruction_data.immediate_value);
-            break;
-        }
-        
-        case Instructions::AddrMode::R_MR: {
-            // Load from memory address in register to register
-            uint16_t addr = getRegister16Bit(current_instruction->reg2);
-            uint8_t value = memory.read(addr);
-            setRegister8Bit(current_instruction->reg1, value);
-            break;
-        }
-        
-        case Instructions::AddrMode::MR_R: {
-            // Load from register to memory address in register
-            uint16_t addr = getRegister16Bit(current_instruction->reg1);
-            uint8_t value = getRegister8Bit(current_instruction->reg2);
-            memory.write(addr, value);
-            break;
-        }
-        
-        case Instructions::AddrMode::R_HLI: {
-            // Load from memory at HL to register, then increment HL
-            uint16_t addr = registers.hl;
-            uint8_t value = memory.read(addr);
-            setRegister8Bit(current_instruction->reg1, value);
-            registers.hl++;
-            break;
-        }
-        
-        case Instructions::AddrMode::R_HLD: {
-            // Load from memory at HL to register, then decrement HL
-            uint16_t addr = registers.hl;
-            uint8_t value = memory.read(addr);
-            setRegister8Bit(current_instruction->reg1, value);
-            registers.hl--;
-            break;
-        }
-        
-        case Instructions::AddrMode::HLI_R: {
-            // Load from register to memory at HL, then increment HL
-            uint16_t addr = registers.hl;
-            uint8_t value = getRegister8Bit(current_instruction->reg2);
-            memory.write(addr, value);
-            registers.hl++;
-            break;
-        }
-        
-        case Instructions::AddrMode::HLD_R: {
-            // Load from register to memory at HL, then decrement HL
-            uint16_t addr = registers.hl;
-            uint8_t value = getRegister8Bit(current_instruction->reg2);
-            memory.write(addr, value);
-            registers.hl--;
-            break;
-        }
-        
-        case Instructions::AddrMode::R_A8: {
-            // Load from high RAM (0xFF00 + immediate 8-bit) to register
-            uint16_t addr = 0xFF00 + (current_instruction_data.immediate_value & 0xFF);
-            uint8_t value = memory.read(addr);
-            setRegister8Bit(current_instruction->reg1, value);
-            break;
-        }
-        
-        case Instructions::AddrMode::A8_R: {
-            // Load from register to high RAM (0xFF00 + immediate 8-bit)
-            uint16_t addr = 0xFF00 + (current_instruction_data.immediate_value & 0xFF);
-            uint8_t value = getRegister8Bit(current_instruction->reg2);
-            memory.write(addr, value);
-            break;
-        }
-        
-        case Instructions::AddrMode::R_A16: {
-            // Load from absolute 16-bit address to register
-            uint16_t addr = current_instruction_data.immediate_value;
-            uint8_t value = memory.read(addr);
-            setRegister8Bit(current_instruction->reg1, value);
-            break;
-        }
-        
-        case Instructions::AddrMode::A16_R: {
-            // Load from register to absolute 16-bit address
-            uint16_t addr = current_instruction_data.immediate_value;
-            uint8_t value = getRegister8Bit(current_instruction->reg2);
-            memory.write(addr, value);
-            break;
-        }
-        
-        case Instructions::AddrMode::HL_SPR: {
-            // LD HL,SP+r8 (add signed immediate to SP and store in HL)
-            int8_t offset = static_cast<int8_t>(current_instruction_data.immediate_value & 0xFF);
-            uint16_t sp = registers.sp;
-            
-            // Calculate flags before the addition
-            // Half-carry occurs if bit 3 carries into bit 4
-            setFlag(FLAG_H, ((sp & 0xF) + (offset & 0xF)) > 0xF);
-            // Carry occurs if bit 7 carries into bit 8
-            setFlag(FLAG_C, ((sp & 0xFF) + (offset & 0xFF)) > 0xFF);
-            
-            // Clear N and Z flags
-            setFlag(FLAG_N, false);
-            setFlag(FLAG_Z, false);
-            
-            // Perform the addition and store in HL
-            registers.hl = sp + offset;
-            break;
-        }
-        
-        case Instructions::AddrMode::D16_R: {
-            // Store SP at immediate 16-bit address
-            if (current_instruction->reg2 == Instructions::RegType::SP) {
-                uint16_t addr = current_instruction_data.immediate_value;
-                memory.write16(addr, registers.sp);
-            }
-            break;
-        }
-        
-        default:
-            printf("Unimplemented LD addressing mode: %d\n", 
-                   static_cast<int>(current_instruction->addr_mode));
-            break;
-    }
-}
+// ==============================================
+// ALU helpers
+// ==============================================
+// These take their operands directly; the opcode handlers below decide where
+// the operands come from and where results go
 
-void CPU::executeINC() {
-    // Increment register or memory
-    if (isRegister16Bit(current_instruction->reg1)) {
-        // 16-bit register increment
-        uint16_t value = getRegister16Bit(current_instruction->reg1);
-        value++;
-        setRegister16Bit(current_instruction->reg1, value);
-    } else if (current_instruction->addr_mode == Instructions::AddrMode::MR) {
-        // Memory increment
-        uint16_t addr = getRegister16Bit(current_instruction->reg1);
-        uint8_t value = memory.read(addr);
-        
-        // Set flags (Z, N, H) - 8-bit INC affects flags
-        setFlag(FLAG_N, false);
-        setFlag(FLAG_H, (value & 0x0F) == 0x0F); // Half carry if lower nibble is 0xF
-        
-        value++;
-        memory.write(addr, value);
-        
-        setFlag(FLAG_Z, value == 0);
-    } else {
-        // 8-bit register increment
-        uint8_t value = getRegister8Bit(current_instruction->reg1);
-        
-        // Set flags (Z, N, H) - 8-bit INC affects flags
-        setFlag(FLAG_N, false);
-        setFlag(FLAG_H, (value & 0x0F) == 0x0F); // Half carry if lower nibble is 0xF
-        
-        value++;
-        setRegister8Bit(current_instruction->reg1, value);
-        
-        setFlag(FLAG_Z, value == 0);
-    }
-}
+// 8-bit adds and subtracts store their 9-bit result for Z and C, and their
+// operands for H (see the lazy flags in cpu.hpp)
+void CPU::executeADD(uint8_t value) {
+    uint16_t result = registers.a + value;
 
-void CPU::executeDEC() {
-    // Decrement register or memory
-    if (isRegister16Bit(current_instruction->reg1)) {
-        // 16-bit register decrement
-        uint16_t value = getRegister16Bit(current_instruction->reg1);
-        value--;
-        setRegister16Bit(current_instruction->reg1, value);
-    } else if (current_instruction->addr_mode == Instructions::AddrMode::MR) {
-        // Memory decrement
-        uint16_t addr = getRegister16Bit(current_instruction->reg1);
-        uint8_t value = memory.read(addr);
-        
-        // Set flags (Z, N, H) - 8-bit DEC affects flags
-        setFlag(FLAG_N, true);
-        setFlag(FLAG_H, (value & 0x0F) == 0x00); // Half carry if lower nibble is 0
-        
-        value--;
-        memory.write(addr, value);
-        
-        setFlag(FLAG_Z, value == 0);
-    } else {
-        // 8-bit register decrement
-        uint8_t value = getRegister8Bit(current_instruction->reg1);
-        
-        // Set flags (Z, N, H) - 8-bit DEC affects flags
-        setFlag(FLAG_N, true);
-        setFlag(FLAG_H, (value & 0x0F) == 0x00); // Half carry if lower nibble is 0
-        
-        value--;
-        setRegister8Bit(current_instruction->reg1, value);
-        
-        setFlag(FLAG_Z, value == 0);
-    }
+    flag_z = flag_c = result;
+    flag_h1 = registers.a;
+    flag_h2 = value;
+    registers.a = static_cast<uint8_t>(result);
 }
 
-void CPU::executeADD() {
-    // Addition
-    if (current_instruction->reg1 == Instructions::RegType::HL && 
-        isRegister16Bit(current_instruction->reg2)) {
-        // 16-bit addition (HL += reg16)
-        uint16_t hl = registers.hl;
-        uint16_t value = getRegister16Bit(current_instruction->reg2);
-        
-        // Set flags
-        setFlag(FLAG_N, false);
-        setFlag(FLAG_H, ((hl & 0x0FFF) + (value & 0x0FFF)) > 0x0FFF); // Half carry
-        setFlag(FLAG_C, (uint32_t)hl + (uint32_t)value > 0xFFFF); // Carry
-        
-        registers.hl = hl + value;
-    } else if (current_instruction->reg1 == Instructions::RegType::A) {
-        // 8-bit addition (A += reg8 or memory)
-        uint8_t a = registers.a;
-        uint8_t value;
-        
-        if (current_instruction->addr_mode == Instructions::AddrMode::R_MR) {
-            // Add from memory
-            uint16_t addr = getRegister16Bit(current_instruction->reg2);
-            value = memory.read(addr);
-        } else if (current_instruction->addr_mode == Instructions::AddrMode::R_D8) {
-            // Add immediate value
-            value = current_instruction_data.immediate_value & 0xFF;
-        } else {
-            // Add from register
-            value = getRegister8Bit(current_instruction->reg2);
-        }
-        
-        // Set flags
-        setFlag(FLAG_N, false);
-        setFlag(FLAG_H, ((a & 0x0F) + (value & 0x0F)) > 0x0F); // Half carry
-        setFlag(FLAG_C, (uint16_t)a + (uint16_t)value > 0xFF); // Carry
-        
-        registers.a = a + value;
-        setFlag(FLAG_Z, registers.a == 0);
-    }
+void CPU::executeADC(uint8_t value) {
+    uint16_t carry = flag_c & 0x100;
+    uint16_t result = registers.a + value + (carry >> 8);
+
+    flag_z = flag_c = result;
+    flag_h1 = registers.a;
+    flag_h2 = value | carry;
+    registers.a = static_cast<uint8_t>(result);
 }
 
-void CPU::executeSUB() {
-    // Subtraction
-    uint8_t a = registers.a;
-    uint8_t value;
-    
-    if (current_instruction->addr_mode == Instructions::AddrMode::R_MR) {
-        // Subtract from memory
-        uint16_t addr = getRegister16Bit(current_instruction->reg2);
-        value = memory.read(addr);
-    } else if (current_instruction->addr_mode == Instructions::AddrMode::R_D8) {
-        // Subtract immediate value
-        value = current_instruction_data.immediate_value & 0xFF;
-    } else {
-        // Subtract from register
-        value = getRegister8Bit(current_instruction->reg2);
-    }
-    
-    // Set flags
-    setFlag(FLAG_N, true);  // Subtraction operation
-    setFlag(FLAG_H, (a & 0x0F) < (value & 0x0F));  // Half carry
-    setFlag(FLAG_C, a < value);  // Carry
-    
-    registers.a = a - value;
-    setFlag(FLAG_Z, registers.a == 0);  // Zero flag
+void CPU::executeSUB(uint8_t value) {
+    // A borrow wraps the result round, which sets bit 8
+    uint16_t result = static_cast<uint16_t>(registers.a - value);
+
+    flag_z = flag_c = result;
+    flag_h1 = registers.a;
+    flag_h2 = value | HALF_SUBTRACT;
+    registers.a = static_cast<uint8_t>(result);
 }
 
-void CPU::executeAND() {
-    // Logical AND with accumulator
-    uint8_t value;
-    
-    if (current_instruction->addr_mode == Instructions::AddrMode::R_MR) {
-        // AND with memory value
-        uint16_t addr = getRegister16Bit(current_instruction->reg2);
-        value = memory.read(addr);
-    } else if (current_instruction->addr_mode == Instructions::AddrMode::R_D8) {
-        // AND with immediate value
-        value = current_instruction_data.immediate_value & 0xFF;
-    } else {
-        // AND with register
-        value = getRegister8Bit(current_instruction->reg2);
-    }
-    
-    // Perform AND operation
-    registers.a &= value;
-    
-    // Set flags
-    setFlag(FLAG_Z, registers.a == 0);  // Zero flag
-    setFlag(FLAG_N, false);  // Not subtraction
-    setFlag(FLAG_H, true);   // Half carry is always set
-    setFlag(FLAG_C, false);  // Carry is always reset
+void CPU::executeSBC(uint8_t value) {
+    uint16_t carry = flag_c & 0x100;
+    uint16_t result = static_cast<uint16_t>(registers.a - value - (carry >> 8));
+
+    flag_z = flag_c = result;
+    flag_h1 = registers.a;
+    flag_h2 = value | carry | HALF_SUBTRACT;
+    registers.a = static_cast<uint8_t>(result);
 }
 
-void CPU::executeOR() {
-    // Logical OR with accumulator
-    uint8_t value;
-    
-    if (current_instruction->addr_mode == Instructions::AddrMode::R_MR) {
-        // OR with memory value
-        uint16_t addr = getRegister16Bit(current_instruction->reg2);
-        value = memory.read(addr);
-    } else if (current_instruction->addr_mode == Instructions::AddrMode::R_D8) {
-        // OR with immediate value
-        value = current_instruction_data.immediate_value & 0xFF;
-    } else {
-        // OR with register
-        value = getRegister8Bit(current_instruction->reg2);
-    }
-    
-    // Perform OR operation
-    registers.a |= value;
-    
-    // Set flags
-    setFlag(FLAG_Z, registers.a == 0);  // Zero flag
-    setFlag(FLAG_N, false);  // Not subtraction
-    setFlag(FLAG_H, false);  // Half carry is always reset
-    setFlag(FLAG_C, false);  // Carry is always reset
+void CPU::executeAND(uint8_t value) {
+    registers.a &= value;
+    flag_z = registers.a;
+    flag_c = 0;
+    setNH(false, true);
 }
 
-void CPU::executeXOR() {
-    // Logical XOR with accumulator
-    uint8_t value;
-    
-    if (current_instruction->addr_mode == Instructions::AddrMode::R_MR) {
-        // XOR with memory value
-        uint16_t addr = getRegister16Bit(current_instruction->reg2);
-        value = memory.read(addr);
-    } else if (current_instruction->addr_mode == Instructions::AddrMode::R_D8) {
-        // XOR with immediate value
-        value = current_instruction_data.immediate_value & 0xFF;
-    } else {
-        // XOR with register
-        value = getRegister8Bit(current_instruction->reg2);
-    }
-    
-    // Perform XOR operation
+void CPU::executeXOR(uint8_t value) {
     registers.a ^= value;
-    
-    // Set flags
-    setFlag(FLAG_Z, registers.a == 0);  // Zero flag
-    setFlag(FLAG_N, false);  // Not subtraction
-    setFlag(FLAG_H, false);  // Half carry is always reset
-    setFlag(FLAG_C, false);  // Carry is always reset
+    flag_z = registers.a;
+    flag_c = 0;
+    setNH(false, false);
 }
 
-bool CPU::executeJP() {
-    // Jump to address
-    bool shouldJump = true;
-    
-    // Check condition if it's a conditional jump
-    if (current_instruction->addr_mode == Instructions::AddrMode::R_D16) {
-        // For conditional jumps, we'll use reg1 to determine the condition
-        switch (current_instruction->reg1) {
-            case Instructions::RegType::CC_NZ:
-                shouldJump = !getFlag(FLAG_Z);
-                break;
-            case Instructions::RegType::CC_Z:
-                shouldJump = getFlag(FLAG_Z);
-                break;
-            case Instructions::RegType::CC_NC:
-                shouldJump = !getFlag(FLAG_C);
-                break;
-            case Instructions::RegType::CC_C:
-                shouldJump = getFlag(FLAG_C);
-                break;
-            default:
-                // Unconditional jump
-                break;
-        }
-    }
-    
-    if (shouldJump) {
-        if (current_instruction->addr_mode == Instructions::AddrMode::R) {
-            // Jump to address in register (HL)
-            registers.pc = registers.hl;
-        } else {
-            // Jump to immediate address
-            registers.pc = current_instruction_data.immediate_value;
-        }
-    }
-    
-    return shouldJump;
+void CPU::executeOR(uint8_t value) {
+    registers.a |= value;
+    flag_z = registers.a;
+    flag_c = 0;
+    setNH(false, false);
 }
 
-bool CPU::executeJR() {
-    // Jump relative (PC += signed immediate)
-    bool shouldJump = true;
-    
-    // Check condition if it's a conditional jump
-    if (current_instruction->addr_mode == Instructions::AddrMode::R_D8) {
-        // For conditional jumps, we'll use reg1 to determine the condition
-        switch (current_instruction->reg1) {
-            case Instructions::RegType::CC_NZ:
-                shouldJump = !getFlag(FLAG_Z);
-                break;
-            case Instructions::RegType::CC_Z:
-                shouldJump = getFlag(FLAG_Z);
-                break;
-            case Instructions::RegType::CC_NC:
-                shouldJump = !getFlag(FLAG_C);
-                break;
-            case Instructions::RegType::CC_C:
-                shouldJump = getFlag(FLAG_C);
-                break;
-            default:
-                // Unconditional jump
-                break;
-        }
-    }
-    
-    if (shouldJump) {
-        // Convert to signed 8-bit offset
-        int8_t offset = static_cast<int8_t>(current_instruction_data.immediate_value & 0xFF);
-        registers.pc += offset;
-    }
-    
-    return shouldJump;
+void CPU::executeCP(uint8_t value) {
+    // Compare is a subtraction that throws the result away
+    flag_z = flag_c = static_cast<uint16_t>(registers.a - value);
+    flag_h1 = registers.a;
+    flag_h2 = value | HALF_SUBTRACT;
 }
 
-bool CPU::executeCALL() {
-    // Call subroutine
-    bool shouldCall = true;
-    
-    // Check condition if it's a conditional call
-    if (current_instruction->addr_mode == Instructions::AddrMode::R_D16) {
-        // For conditional calls, we'll use reg1 to determine the condition
-        switch (current_instruction->reg1) {
-            case Instructions::RegType::CC_NZ:
-                shouldCall = !getFlag(FLAG_Z);
-                break;
-            case Instructions::RegType::CC_Z:
-                shouldCall = getFlag(FLAG_Z);
-                break;
-            case Instructions::RegType::CC_NC:
-                shouldCall = !getFlag(FLAG_C);
-                break;
-            case Instructions::RegType::CC_C:
-                shouldCall = getFlag(FLAG_C);
-                break;
-            default:
-                // Unconditional call
-                break;
-        }
-    }
-    
-    if (shouldCall) {
-        // Push current PC to stack
-        registers.sp -= 2;
-        // Use the write method twice instead of write16
-        memory.write(registers.sp, registers.pc & 0xFF);
-        memory.write(registers.sp + 1, registers.pc >> 8);
-        
-        // Jump to call address
-        registers.pc = current_instruction_data.immediate_value;
-    }
-    
-    return shouldCall;
-}
+uint8_t CPU::executeINC(uint8_t value) {
+    uint8_t result = value + 1;
 
-bool CPU::executeRET() {
-    // Return from subroutine
-    bool shouldReturn = true;
-    
-    // Check condition if it's a conditional return
-    if (current_instruction->addr_mode == Instructions::AddrMode::IMP) {
-        // For conditional returns, we'll use reg1 to determine the condition
-        switch (current_instruction->reg1) {
-            case Instructions::RegType::CC_NZ:
-                shouldReturn = !getFlag(FLAG_Z);
-                break;
-            case Instructions::RegType::CC_Z:
-                shouldReturn = getFlag(FLAG_Z);
-                break;
-            case Instructions::RegType::CC_NC:
-                shouldReturn = !getFlag(FLAG_C);
-                break;
-            case Instructions::RegType::CC_C:
-                shouldReturn = getFlag(FLAG_C);
-                break;
-            default:
-                // Unconditional return
-                break;
-        }
-    }
-    
-    if (shouldReturn) {
-        // Pop return address from stack
-        // Use read method twice instead of read16
-        uint16_t low_byte = memory.read(registers.sp);
-        uint16_t high_byte = memory.read(registers.sp + 1);
-        registers.pc = (high_byte << 8) | low_byte;
-        registers.sp += 2;
-    }
-    
-    return shouldReturn;
+    // Carry is not affected by 8-bit INC
+    flag_z = result;
+    flag_h1 = value;
+    flag_h2 = 1;
+    return result;
 }
 
-void CPU::executePUSH() {
-    // Push register pair to stack
-    uint16_t value = getRegister16Bit(current_instruction->reg1);
-    
-    // Decrement stack pointer and push value
-    registers.sp -= 2;
-    // Use write method twice instead of write16
-    memory.write(registers.sp, value & 0xFF);
-    memory.write(registers.sp + 1, value >> 8);
-}
+uint8_t CPU::executeDEC(uint8_t value) {
+    uint8_t result = value - 1;
 
-void CPU::executePOP() {
-    // Pop value from stack to register pair
-    // Use read method twice instead of read16
-    uint16_t low_byte = memory.read(registers.sp);
-    uint16_t high_byte = memory.read(registers.sp + 1);
-    uint16_t value = (high_byte << 8) | low_byte;
-    registers.sp += 2;
-    
-    // Special case for AF: lower 4 bits of F are always 0
-    if (current_instruction->reg1 == Instructions::RegType::AF) {
-        value &= 0xFFF0;
-    }
-    
-    setRegister16Bit(current_instruction->reg1, value);
+    // Carry is not affected by 8-bit DEC
+    flag_z = result;
+    flag_h1 = value;
+    flag_h2 = 1 | HALF_SUBTRACT;
+    return result;
 }
 
-void CPU::executeRLCA() {
-    // Rotate Left Circular Accumulator
-    uint8_t a = registers.a;
-    uint8_t bit7 = (a & 0x80) >> 7;  // Get the highest bit
-    
-    // Rotate left
-    registers.a = (a << 1) | bit7;
-    
-    // Set flags
-    setFlag(FLAG_Z, false);  // Z is always reset
-    setFlag(FLAG_N, false);  // N is always reset
-    setFlag(FLAG_H, false);  // H is always reset
-    setFlag(FLAG_C, bit7);   // C gets the old bit 7
-}
+void CPU::executeADDHL(uint16_t value) {
+    uint32_t result = registers.hl + value;
 
-void CPU::executeRRCA() {
-    // Rotate Right Circular Accumulator
-    uint8_t a = registers.a;
-    uint8_t bit0 = a & 0x01;  // Get the lowest bit
-    
-    // Rotate right
-    registers.a = (a >> 1) | (bit0 << 7);
-    
-    // Set flags
-    setFlag(FLAG_Z, false);  // Z is always reset
-    setFlag(FLAG_N, false);  // N is always reset
-    setFlag(FLAG_H, false);  // H is always reset
-    setFlag(FLAG_C, bit0);   // C gets the old bit 0
+    // Zero flag is not affected by 16-bit ADD. H is the carry out of bit 11:
+    // the high bytes' low nibbles plus the carry out of the low bytes
+    flag_c = static_cast<uint16_t>(result >> 8);
+    flag_h1 = registers.hl >> 8;
+    flag_h2 = static_cast<uint16_t>((value >> 8) & 0x0F) |
+              ((((registers.hl & 0xFF) + (value & 0xFF)) > 0xFF) ? HALF_CARRY_IN : 0);
+    registers.hl = static_cast<uint16_t>(result);
 }
 
-void CPU::executeRLA() {
-    // Rotate Left Accumulator (through carry)
-    uint8_t a = registers.a;
-    uint8_t bit7 = (a & 0x80) >> 7;  // Get the highest bit
-    uint8_t oldCarry = getFlag(FLAG_C) ? 1 : 0;
-    
-    // Rotate left through carry
-    registers.a = (a << 1) | oldCarry;
-    
-    // Set flags
-    setFlag(FLAG_Z, false);  // Z is always reset
-    setFlag(FLAG_N, false);  // N is always reset
-    setFlag(FLAG_H, false);  // H is always reset
-    setFlag(FLAG_C, bit7);   // C gets the old bit 7
-}
+uint16_t CPU::executeADDSP(int8_t offset) {
+    // Shared by ADD SP,r8 and LD HL,SP+r8: flags come from the low byte addition
+    uint16_t sp = registers.sp;
+    uint8_t unsigned_offset = static_cast<uint8_t>(offset);
 
-void CPU::executeRRA() {
-    // Rotate Right Accumulator (through carry)
-    uint8_t a = registers.a;
-    uint8_t bit0 = a & 0x01;  // Get the lowest bit
-    uint8_t oldCarry = getFlag(FLAG_C) ? 1 : 0;
-    
-    // Rotate right through carry
-    registers.a = (a >> 1) | (oldCarry << 7);
-    
-    // Set flags
-    setFlag(FLAG_Z, false);  // Z is always reset
-    setFlag(FLAG_N, false);  // N is always reset
-    setFlag(FLAG_H, false);  // H is always reset
-    setFlag(FLAG_C, bit0);   // C gets the old bit 0
+    flag_z = 1;
+    flag_c = (sp & 0xFF) + unsigned_offset;
+    flag_h1 = static_cast<uint8_t>(sp);
+    flag_h2 = unsigned_offset & 0x0F;
+    return static_cast<uint16_t>(sp + offset);
 }
 
 void CPU::executeDAA() {
     // Decimal Adjust Accumulator
     // Adjusts A to a BCD number after BCD operations
     uint8_t a = registers.a;
-    uint8_t correction = 0;
-    
-    if (getFlag(FLAG_H) || (!getFlag(FLAG_N) && (a & 0x0F) > 9)) {
-        correction |= 0x06;
-    }
-    
-    if (getFlag(FLAG_C) || (!getFlag(FLAG_N) && a > 0x99)) {
-        correction |= 0x60;
-        setFlag(FLAG_C, true);
-    }
-    
-    // Add or subtract the correction value
-    if (getFlag(FLAG_N)) {
-        a -= correction;
-    } else {
-        a += correction;
-    }
-    
-    registers.a = a;
-    
-    // Update flags
-    setFlag(FLAG_Z, a == 0);
-    setFlag(FLAG_H, false);
-}
-
-void CPU::executeCPL() {
-    // Complement (NOT) on register A
-    registers.a = ~registers.a;
-    
-    // Set flags
-    setFlag(FLAG_N, true);
-    setFlag(FLAG_H, true);
-    // Z and C flags are unaffected
-}
-
-void CPU::executeSCF() {
-    // Set Carry Flag
-    setFlag(FLAG_N, false);
-    setFlag(FLAG_H, false);
-    setFlag(FLAG_C, true);
-    // Z flag is unaffected
-}
-
-void CPU::executeCCF() {
-    // Complement Carry Flag
-    setFlag(FLAG_N, false);
-    setFlag(FLAG_H, false);
-    setFlag(FLAG_C, !getFlag(FLAG_C));
-    // Z flag is unaffected
-}
-
-void CPU::executeHALT() {
-    // Halt the CPU until an interrupt occurs
-    halted = true;
-}
-
-void CPU::executeADC() {
-    // Add with Carry
-    uint8_t a = registers.a;
-    uint8_t value;
-    uint8_t carry = getFlag(FLAG_C) ? 1 : 0;
-    
-    if (current_instruction->addr_mode == Instructions::AddrMode::R_MR) {
-        // Add from memory
-        uint16_t addr = getRegister16Bit(current_instruction->reg2);
-        value = memory.read(addr);
-    } else if (current_instruction->addr_mode == Instructions::AddrMode::R_D8) {
-        // Add immediate value
-        value = current_instruction_data.immediate_value & 0xFF;
-    } else {
-        // Add from register
-        value = getRegister8Bit(current_instruction->reg2);
-    }
-    
-    // Calculate result with carry
-    uint16_t result = a + value + carry;
-    
-    // Set flags
-    setFlag(FLAG_Z, (result & 0xFF) == 0);
-    setFlag(FLAG_N, false);
-    setFlag(FLAG_H, ((a & 0x0F) + (value & 0x0F) + carry) > 0x0F); // Half carry
-    setFlag(FLAG_C, result > 0xFF); // Carry
-    
-    registers.a = result & 0xFF;
-}
-
-void CPU::executeSBC() {
-    // Subtract with Carry
-    uint8_t a = registers.a;
-    uint8_t value;
-    uint8_t carry = getFlag(FLAG_C) ? 1 : 0;
-    
-    if (current_instruction->addr_mode == Instructions::AddrMode::R_MR) {
-        // Subtract from memory
-        uint16_t addr = getRegister16Bit(current_instruction->reg2);
-        value = memory.read(addr);
-    } else if (current_instruction->addr_mode == Instructions::AddrMode::R_D8) {
-        // Subtract immediate value
-        value = current_instruction_data.immediate_value & 0xFF;
-    } else {
-        // Subtract from register
-        value = getRegister8Bit(current_instruction->reg2);
-    }
-    
-    // Calculate result with carry
-    int result = a - value - carry;
-    
-    // Set flags
-    setFlag(FLAG_Z, (result & 0xFF) == 0);
-    setFlag(FLAG_N, true);
-    setFlag(FLAG_H, ((int)(a & 0x0F) - (int)(value & 0x0F) - (int)carry) < 0); // Half borrow
-    setFlag(FLAG_C, result < 0); // Borrow
-    
-    registers.a = result & 0xFF;
-}
-
-void CPU::executeCP() {
-    // Compare (subtract without storing result)
-    uint8_t a = registers.a;
-    uint8_t value;
-    
-    if (current_instruction->addr_mode == Instructions::AddrMode::R_MR) {
-        // Compare with memory
-        uint16_t addr = getRegister16Bit(current_instruction->reg2);
-        value = memory.read(addr);
-    } else if (current_instruction->addr_mode == Instructions::AddrMode::R_D8) {
-        // Compare with immediate value
-        value = current_instruction_data.immediate_value & 0xFF;
+    bool carry = flagC();
+    bool subtract = flagN();
+
+    if (!subtract) {
+        // After an addition, adjust if there was a carry or a digit is out of range
+        if (carry || a > 0x99) {
+            a += 0x60;
+            carry = true;
+        }
+        if (flagH() || (a & 0x0F) > 0x09) {
+            a += 0x06;
+        }
     } else {
-        // Compare with register
-        value = getRegister8Bit(current_instruction->reg2);
+        // After a subtraction, only adjust if there was a borrow
+        if (carry) {
+            a -= 0x60;
+        }
+        if (flagH()) {
+            a -= 0x06;
+        }
     }
-    
-    // Calculate result (don't store it)
-    int result = a - value;
-    
-    // Set flags
-    setFlag(FLAG_Z, (result & 0xFF) == 0);
-    setFlag(FLAG_N, true);
-    setFlag(FLAG_H, ((int)(a & 0x0F) - (int)(value & 0x0F)) < 0); // Half borrow
-    setFlag(FLAG_C, result < 0); // Borrow
-}
 
-void CPU::executeRETI() {
-    // Return from interrupt
-    executeRET(); // Perform normal return
-    ime = true;   // Enable interrupts
+    registers.a = a;
+    flag_z = a;
+    flag_c = carry ? 0x100 : 0;
+    setNH(subtract, false);
 }
 
-void CPU::executeLDH() {
-    // Load to/from high RAM area (0xFF00 + offset)
-    if (current_instruction->addr_mode == Instructions::AddrMode::A8_R) {
-        // LDH (a8),A - Store A in high RAM
-        uint16_t addr = 0xFF00 + (current_instruction_data.immediate_value & 0xFF);
-        memory.write(addr, registers.a);
-    } else if (current_instruction->addr_mode == Instructions::AddrMode::R_A8) {
-        // LDH A,(a8) - Load A from high RAM
-        uint16_t addr = 0xFF00 + (current_instruction_data.immediate_value & 0xFF);
-        registers.a = memory.read(addr);
-    } else if (current_instruction->addr_mode == Instructions::AddrMode::MR_R) {
-        // LD (C),A - Store A in high RAM at 0xFF00+C
-        uint16_t addr = 0xFF00 + registers.c;
-        memory.write(addr, registers.a);
-    } else if (current_instruction->addr_mode == Instructions::AddrMode::R_MR) {
-        // LD A,(C) - Load A from high RAM at 0xFF00+C
-        uint16_t addr = 0xFF00 + registers.c;
-        registers.a = memory.read(addr);
-    }
+// CB-prefixed rotates and shifts: Z from the result, C from the bit shifted
+// out (moved up to bit 8), N and H cleared
+uint8_t CPU::executeRLC(uint8_t value) {
+    uint8_t result = static_cast<uint8_t>((value << 1) | (value >> 7));
+    flag_z = result;
+    flag_c = (value & 0x80) << 1;
+    setNH(false, false);
+    return result;
 }
 
-void CPU::executeDI() {
-    // Disable Interrupts
-    ime = false;
+uint8_t CPU::executeRRC(uint8_t value) {
+    uint8_t result = static_cast<uint8_t>((value >> 1) | (value << 7));
+    flag_z = result;
+    flag_c = (value & 0x01) << 8;
+    setNH(false, false);
+    return result;
 }
 
-void CPU::executeEI() {
-    // Enable Interrupts
-    ime = true;
+uint8_t CPU::executeRL(uint8_t value) {
+    uint8_t result = static_cast<uint8_t>((value << 1) | (flagC() ? 1 : 0));
+    flag_z = result;
+    flag_c = (value & 0x80) << 1;
+    setNH(false, false);
+    return result;
 }
 
-void CPU::executeRST() {
-    // Reset - Call to predefined address
-    uint16_t addr = current_instruction->param * 8; // RST param is 0-7, address is param*8
-    
-    // Push current PC to stack
-    registers.sp -= 2;
-    memory.write16(registers.sp, registers.pc);
-    
-    // Jump to reset address
-    registers.pc = addr;
+uint8_t CPU::executeRR(uint8_t value) {
+    uint8_t result = static_cast<uint8_t>((value >> 1) | (flagC() ? 0x80 : 0));
+    flag_z = result;
+    flag_c = (value & 0x01) << 8;
+    setNH(false, false);
+    return result;
 }
 
-void CPU::executeRLC() {
-    // Rotate Left Circular
-    uint8_t value;
-    uint8_t bit7;
-    
-    if (current_instruction->addr_mode == Instructions::AddrMode::MR) {
-        // Operate on memory
-        uint16_t addr = getRegister16Bit(current_instruction->reg1);
-        value = memory.read(addr);
-        bit7 = (value & 0x80) >> 7;
-        value = (value << 1) | bit7;
-        memory.write(addr, value);
-    } else {
-        // Operate on register
-        value = getRegister8Bit(current_instruction->reg1);
-        bit7 = (value & 0x80) >> 7;
-        value = (value << 1) | bit7;
-        setRegister8Bit(current_instruction->reg1, value);
-    }
-    
-    // Set flags
-    setFlag(FLAG_Z, value == 0);
-    setFlag(FLAG_N, false);
-    setFlag(FLAG_H, false);
-    setFlag(FLAG_C, bit7);
+uint8_t CPU::executeSLA(uint8_t value) {
+    uint8_t result = static_cast<uint8_t>(value << 1);
+    flag_z = result;
+    flag_c = (value & 0x80) << 1;
+    setNH(false, false);
+    return result;
 }
 
-void CPU::executeRRC() {
-    // Rotate Right Circular
-    uint8_t value;
-    uint8_t bit0;
-    
-    if (current_instruction->addr_mode == Instructions::AddrMode::MR) {
-        // Operate on memory
-        uint16_t addr = getRegister16Bit(current_instruction->reg1);
-        value = memory.read(addr);
-        bit0 = value & 0x01;
-        value = (value >> 1) | (bit0 << 7);
-        memory.write(addr, value);
-    } else {
-        // Operate on register
-        value = getRegister8Bit(current_instruction->reg1);
-        bit0 = value & 0x01;
-        value = (value >> 1) | (bit0 << 7);
-        setRegister8Bit(current_instruction->reg1, value);
-    }
-    
-    // Set flags
-    setFlag(FLAG_Z, value == 0);
-    setFlag(FLAG_N, false);
-    setFlag(FLAG_H, false);
-    setFlag(FLAG_C, bit0);
+uint8_t CPU::executeSRA(uint8_t value) {
+    // Arithmetic shift keeps bit 7
+    uint8_t result = static_cast<uint8_t>((value >> 1) | (value & 0x80));
+    flag_z = result;
+    flag_c = (value & 0x01) << 8;
+    setNH(false, false);
+    return result;
 }
 
-void CPU::executeRL() {
-    // Rotate Left through carry
-    uint8_t value;
-    uint8_t bit7;
-    uint8_t oldCarry = getFlag(FLAG_C) ? 1 : 0;
-    
-    if (current_instruction->addr_mode == Instructions::AddrMode::MR) {
-        // Operate on memory
-        uint16_t addr = getRegister16Bit(current_instruction->reg1);
-        value = memory.read(addr);
-        bit7 = (value & 0x80) >> 7;
-        value = (value << 1) | oldCarry;
-        memory.write(addr, value);
-    } else {
-        // Operate on register
-        value = getRegister8Bit(current_instruction->reg1);
-        bit7 = (value & 0x80) >> 7;
-        value = (value << 1) | oldCarry;
-        setRegister8Bit(current_instruction->reg1, value);
-    }
-    
-    // Set flags
-    setFlag(FLAG_Z, value == 0);
-    setFlag(FLAG_N, false);
-    setFlag(FLAG_H, false);
-    setFlag(FLAG_C, bit7);
+uint8_t CPU::executeSWAP(uint8_t value) {
+    uint8_t result = static_cast<uint8_t>((value << 4) | (value >> 4));
+    flag_z = result;
+    flag_c = 0;
+    setNH(false, false);
+    return result;
 }
 
-void CPU::executeRR() {
-    // Rotate Right through carry
-    uint8_t value;
-    uint8_t bit0;
-    uint8_t oldCarry = getFlag(FLAG_C) ? 1 : 0;
-    
-    if (current_instruction->addr_mode == Instructions::AddrMode::MR) {
-        // Operate on memory
-        uint16_t addr = getRegister16Bit(current_instruction->reg1);
-        value = memory.read(addr);
-        bit0 = value & 0x01;
-        value = (value >> 1) | (oldCarry << 7);
-        memory.write(addr, value);
-    } else {
-        // Operate on register
-        value = getRegister8Bit(current_instruction->reg1);
-        bit0 = value & 0x01;
-        value = (value >> 1) | (oldCarry << 7);
-        setRegister8Bit(current_instruction->reg1, value);
-    }
-    
-    // Set flags
-    setFlag(FLAG_Z, value == 0);
-    setFlag(FLAG_N, false);
-    setFlag(FLAG_H, false);
-    setFlag(FLAG_C, bit0);
+uint8_t CPU::executeSRL(uint8_t value) {
+    uint8_t result = value >> 1;
+    flag_z = result;
+    flag_c = (value & 0x01) << 8;
+    setNH(false, false);
+    return result;
 }
 
-void CPU::executeSLA() {
-    // Shift Left Arithmetic
-    uint8_t value;
-    uint8_t bit7;
-    
-    if (current_instruction->addr_mode == Instructions::AddrMode::MR) {
-        // Operate on memory
-        uint16_t addr = getRegister16Bit(current_instruction->reg1);
-        value = memory.read(addr);
-        bit7 = (value & 0x80) >> 7;
-        value = value << 1;
-        memory.write(addr, value);
-    } else {
-        // Operate on register
-        value = getRegister8Bit(current_instruction->reg1);
-        bit7 = (value & 0x80) >> 7;
-        value = value << 1;
-        setRegister8Bit(current_instruction->reg1, value);
-    }
-    
-    // Set flags
-    setFlag(FLAG_Z, value == 0);
-    setFlag(FLAG_N, false);
-    setFlag(FLAG_H, false);
-    setFlag(FLAG_C, bit7);
+void CPU::executeBIT(uint8_t bit, uint8_t value) {
+    // Carry is not affected by BIT
+    flag_z = value & (1 << bit);
+    setNH(false, true);
 }
 
-void CPU::executeSRA() {
-    // Shift Right Arithmetic (MSB doesn't change)
-    uint8_t value;
-    uint8_t bit0;
-    uint8_t bit7;
-    
-    if (current_instruction->addr_mode == Instructions::AddrMode::MR) {
-        // Operate on memory
-        uint16_t addr = getRegister16Bit(current_instruction->reg1);
-        value = memory.read(addr);
-        bit0 = value & 0x01;
-        bit7 = value & 0x80;
-        value = (value >> 1) | bit7;
-        memory.write(addr, value);
-    } else {
-        // Operate on register
-        value = getRegister8Bit(current_instruction->reg1);
-        bit0 = value & 0x01;
-        bit7 = value & 0x80;
-        value = (value >> 1) | bit7;
-        setRegister8Bit(current_instruction->reg1, value);
-    }
-    
-    // Set flags
-    setFlag(FLAG_Z, value == 0);
-    setFlag(FLAG_N, false);
-    setFlag(FLAG_H, false);
-    setFlag(FLAG_C, bit0);
-}
+void CPU::executeHALT() {
+    uint8_t pending = memory.read(0xFF0F) & memory.read(0xFFFF) & 0x1F;
 
-void CPU::executeSWAP() {
-    // Swap upper and lower nibbles
-    uint8_t value;
-    
-    if (current_instruction->addr_mode == Instructions::AddrMode::MR) {
-        // Operate on memory
-        uint16_t addr = getRegister16Bit(current_instruction->reg1);
-        value = memory.read(addr);
-        value = ((value & 0x0F) << 4) | ((value & 0xF0) >> 4);
-        memory.write(addr, value);
+    if (!ime && pending != 0) {
+        // HALT bug: with IME off and an interrupt already pending the CPU
+        // doesn't halt, and the next opcode byte is read twice
+        halt_bug_active = true;
     } else {
-        // Operate on register
-        value = getRegister8Bit(current_instruction->reg1);
-        value = ((value & 0x0F) << 4) | ((value & 0xF0) >> 4);
-        setRegister8Bit(current_instruction->reg1, value);
+        // Halt the CPU until an interrupt occurs
+        halted = true;
+    }
+}
+
+// ==============================================
+// Opcode handlers
+// ==============================================
+// Every opcode gets its own handler, instantiated from a template over the
+// opcode byte. The usual SM83 decoding (x = bits 7-6, y = bits 5-3,
+// z = bits 2-0, p = y >> 1, q = y & 1) is resolved with if constexpr, so each
+// handler only contains the code for its own registers and addressing mode.
+// Handlers run with PC already past the opcode byte and return the T-cycles
+// the whole instruction took.
+
+struct CPU::Ops {
+    // Operand fetch
+    static uint8_t fetch8(CPU& cpu) {
+        return cpu.memory.read(cpu.registers.pc++);
+    }
+
+    static uint16_t fetch16(CPU& cpu) {
+        uint16_t low = fetch8(cpu);
+        uint16_t high = fetch8(cpu);
+        return static_cast<uint16_t>(low | (high << 8));
+    }
+
+    // 8-bit operand r[i]: B, C, D, E, H, L, (HL), A
+    template <int R>
+    static uint8_t get8(CPU& cpu) {
+        if constexpr (R == 0) return cpu.registers.b;
+        else if constexpr (R == 1) return cpu.registers.c;
+        else if constexpr (R == 2) return cpu.registers.d;
+        else if constexpr (R == 3) return cpu.registers.e;
+        else if constexpr (R == 4) return cpu.registers.h;
+        else if constexpr (R == 5) return cpu.registers.l;
+        else if constexpr (R == 6) return cpu.memory.read(cpu.registers.hl);
+        else return cpu.registers.a;
+    }
+
+    template <int R>
+    static void set8(CPU& cpu, uint8_t value) {
+        if constexpr (R == 0) cpu.registers.b = value;
+        else if constexpr (R == 1) cpu.registers.c = value;
+        else if constexpr (R == 2) cpu.registers.d = value;
+        else if constexpr (R == 3) cpu.registers.e = value;
+        else if constexpr (R == 4) cpu.registers.h = value;
+        else if constexpr (R == 5) cpu.registers.l = value;
+        else if constexpr (R == 6) cpu.memory.write(cpu.registers.hl, value);
+        else cpu.registers.a = value;
+    }
+
+    // 16-bit operand rp[p]: BC, DE, HL, SP
+    template <int P>
+    static uint16_t& rp(CPU& cpu) {
+        if constexpr (P == 0) return cpu.registers.bc;
+        else if constexpr (P == 1) return cpu.registers.de;
+        else if constexpr (P == 2) return cpu.registers.hl;
+        else return cpu.registers.sp;
+    }
+
+    // Condition cc[i]: NZ, Z, NC, C
+    template <int CC>
+    static bool condition(CPU& cpu) {
+        if constexpr (CC == 0) return !cpu.flagZ();
+        else if constexpr (CC == 1) return cpu.flagZ();
+        else if constexpr (CC == 2) return !cpu.flagC();
+        else return cpu.flagC();
+    }
+
+    // Stack helpers
+    static void push16(CPU& cpu, uint16_t value) {
+        cpu.memory.write(--cpu.registers.sp, value >> 8);
+        cpu.memory.write(--cpu.registers.sp, value & 0xFF);
+    }
+
+    static uint16_t pop16(CPU& cpu) {
+        uint16_t low = cpu.memory.read(cpu.registers.sp++);
+        uint16_t high = cpu.memory.read(cpu.registers.sp++);
+        return static_cast<uint16_t>(low | (high << 8));
+    }
+
+    // alu[y] A, value: ADD, ADC, SUB, SBC, AND, XOR, OR, CP
+    template <int Y>
+    static void alu(CPU& cpu, uint8_t value) {
+        if constexpr (Y == 0) cpu.executeADD(value);
+        else if constexpr (Y == 1) cpu.executeADC(value);
+        else if constexpr (Y == 2) cpu.executeSUB(value);
+        else if constexpr (Y == 3) cpu.executeSBC(value);
+        else if constexpr (Y == 4) cpu.executeAND(value);
+        else if constexpr (Y == 5) cpu.executeXOR(value);
+        else if constexpr (Y == 6) cpu.executeOR(value);
+        else cpu.executeCP(value);
+    }
+
+    // rot[y] value: RLC, RRC, RL, RR, SLA, SRA, SWAP, SRL
+    template <int Y>
+    static uint8_t rot(CPU& cpu, uint8_t value) {
+        if constexpr (Y == 0) return cpu.executeRLC(value);
+        else if constexpr (Y == 1) return cpu.executeRRC(value);
+        else if constexpr (Y == 2) return cpu.executeRL(value);
+        else if constexpr (Y == 3) return cpu.executeRR(value);
+        else if constexpr (Y == 4) return cpu.executeSLA(value);
+        else if constexpr (Y == 5) return cpu.executeSRA(value);
+        else if constexpr (Y == 6) return cpu.executeSWAP(value);
+        else return cpu.executeSRL(value);
+    }
+
+    // The eleven unused opcodes lock up real hardware; we treat them as a NOP
+    static uint8_t illegal(CPU&) {
+        return 4;
+    }
+
+    // Handler for one unprefixed opcode
+    template <uint8_t OP>
+    static uint8_t op(CPU& cpu) {
+        constexpr int x = OP >> 6;
+        constexpr int y = (OP >> 3) & 7;
+        constexpr int z = OP & 7;
+        constexpr int p = y >> 1;
+        constexpr int q = y & 1;
+
+        if constexpr (OP == 0x76) {
+            // HALT
+            cpu.executeHALT();
+            return 4;
+        } else if constexpr (x == 1) {
+            // LD r, r'
+            set8<y>(cpu, get8<z>(cpu));
+            return (y == 6 || z == 6) ? 8 : 4;
+        } else if constexpr (x == 2) {
+            // ALU A, r
+            alu<y>(cpu, get8<z>(cpu));
+            return z == 6 ? 8 : 4;
+        } else if constexpr (x == 0) {
+            if constexpr (z == 0) {
+                if constexpr (y == 0) {
+                    // NOP
+                    return 4;
+                } else if constexpr (y == 1) {
+                    // LD (a16), SP
+                    uint16_t addr = fetch16(cpu);
+                    cpu.memory.write(addr, cpu.registers.sp & 0xFF);
+                    cpu.memory.write(addr + 1, cpu.registers.sp >> 8);
+                    return 20;
+                } else if constexpr (y == 2) {
+                    // STOP - consumes its padding byte; treated as a NOP otherwise
+                    fetch8(cpu);
+                    return 4;
+                } else {
+                    // JR r8 / JR cc, r8
+                    int8_t offset = static_cast<int8_t>(fetch8(cpu));
+                    if constexpr (y == 3) {
+                        cpu.registers.pc += offset;
+                        return 12;
+                    } else {
+                        if (!condition<y - 4>(cpu)) {
+                            return 8;
+                        }
+                        cpu.registers.pc += offset;
+                        return 12;
+                    }
+                }
+            } else if constexpr (z == 1) {
+                if constexpr (q == 0) {
+                    // LD rr, d16
+                    rp<p>(cpu) = fetch16(cpu);
+                    return 12;
+                } else {
+                    // ADD HL, rr
+                    cpu.executeADDHL(rp<p>(cpu));
+                    return 8;
+                }
+            } else if constexpr (z == 2) {
+                // Indirect loads through BC, DE, HL+ and HL-
+                uint16_t addr;
+                if constexpr (p == 0) addr = cpu.registers.bc;
+                else if constexpr (p == 1) addr = cpu.registers.de;
+                else if constexpr (p == 2) addr = cpu.registers.hl++;
+                else addr = cpu.registers.hl--;
+
+                if constexpr (q == 0) {
+                    cpu.memory.write(addr, cpu.registers.a);
+                } else {
+                    cpu.registers.a = cpu.memory.read(addr);
+                }
+                return 8;
+            } else if constexpr (z == 3) {
+                // INC rr / DEC rr (no flags)
+                if constexpr (q == 0) rp<p>(cpu)++;
+                else rp<p>(cpu)--;
+                return 8;
+            } else if constexpr (z == 4) {
+                // INC r
+                set8<y>(cpu, cpu.executeINC(get8<y>(cpu)));
+                return y == 6 ? 12 : 4;
+            } else if constexpr (z == 5) {
+                // DEC r
+                set8<y>(cpu, cpu.executeDEC(get8<y>(cpu)));
+                return y == 6 ? 12 : 4;
+            } else if constexpr (z == 6) {
+                // LD r, d8
+                set8<y>(cpu, fetch8(cpu));
+                return y == 6 ? 12 : 8;
+            } else {
+                // Accumulator rotates and flag operations
+                if constexpr (y <= 3) {
+                    // RLCA, RRCA, RLA, RRA: like the CB versions but Z is always cleared
+                    cpu.registers.a = rot<y>(cpu, cpu.registers.a);
+                    cpu.flag_z = 1;
+                } else if constexpr (y == 4) {
+                    cpu.executeDAA();
+                } else if constexpr (y == 5) {
+                    // CPL
+                    cpu.registers.a = ~cpu.registers.a;
+                    cpu.setNH(true, true);
+                } else if constexpr (y == 6) {
+                    // SCF
+                    cpu.flag_c = 0x100;
+                    cpu.setNH(false, false);
+                } else {
+                    // CCF
+                    cpu.flag_c ^= 0x100;
+                    cpu.setNH(false, false);
+                }
+                return 4;
+            }
+        } else {
+            if constexpr (z == 0) {
+                if constexpr (y <= 3) {
+                    // RET cc
+                    if (!condition<y>(cpu)) {
+                        return 8;
+                    }
+                    cpu.registers.pc = pop16(cpu);
+                    return 20;
+                } else if constexpr (y == 4) {
+                    // LDH (a8), A
+                    cpu.memory.write(0xFF00 + fetch8(cpu), cpu.registers.a);
+                    return 12;
+                } else if constexpr (y == 5) {
+                    // ADD SP, r8
+                    cpu.registers.sp = cpu.executeADDSP(static_cast<int8_t>(fetch8(cpu)));
+                    return 16;
+                } else if constexpr (y == 6) {
+                    // LDH A, (a8)
+                    cpu.registers.a = cpu.memory.read(0xFF00 + fetch8(cpu));
+                    return 12;
+                } else {
+                    // LD HL, SP+r8
+                    cpu.registers.hl = cpu.executeADDSP(static_cast<int8_t>(fetch8(cpu)));
+                    return 12;
+                }
+            } else if constexpr (z == 1) {
+                if constexpr (q == 0) {
+                    // POP rr (AF instead of SP; the low nibble of F always reads 0)
+                    uint16_t value = pop16(cpu);
+                    if constexpr (p == 3) cpu.setRegisterAF(value);
+                    else rp<p>(cpu) = value;
+                    return 12;
+                } else if constexpr (p == 0) {
+                    // RET
+                    cpu.registers.pc = pop16(cpu);
+                    return 16;
+                } else if constexpr (p == 1) {
+                    // RETI enables interrupts immediately, unlike EI
+                    cpu.registers.pc = pop16(cpu);
+                    cpu.ime = true;
+                    return 16;
+                } else if constexpr (p == 2) {
+                    // JP HL
+                    cpu.registers.pc = cpu.registers.hl;
+                    return 4;
+                } else {
+                    // LD SP, HL
+                    cpu.registers.sp = cpu.registers.hl;
+                    return 8;
+                }
+            } else if constexpr (z == 2) {
+                if constexpr (y <= 3) {
+                    // JP cc, a16
+                    uint16_t addr = fetch16(cpu);
+                    if (!condition<y>(cpu)) {
+                        return 12;
+                    }
+                    cpu.registers.pc = addr;
+                    return 16;
+                } else if constexpr (y == 4) {
+                    // LD (C), A
+                    cpu.memory.write(0xFF00 + cpu.registers.c, cpu.registers.a);
+                    return 8;
+                } else if constexpr (y == 5) {
+                    // LD (a16), A
+                    cpu.memory.write(fetch16(cpu), cpu.registers.a);
+                    return 16;
+                } else if constexpr (y == 6) {
+                    // LD A, (C)
+                    cpu.registers.a = cpu.memory.read(0xFF00 + cpu.registers.c);
+                    return 8;
+                } else {
+                    // LD A, (a16)
+                    cpu.registers.a = cpu.memory.read(fetch16(cpu));
+                    return 16;
+                }
+            } else if constexpr (z == 3) {
+                if constexpr (y == 0) {
+                    // JP a16
+                    cpu.registers.pc = fetch16(cpu);
+                    return 16;
+                } else if constexpr (y == 1) {
+                    // CB prefix: the second table's handlers include the prefix cycles
+                    uint8_t cb_opcode = fetch8(cpu);
+                    return cb_table[cb_opcode](cpu);
+                } else if constexpr (y == 6) {
+                    // DI also cancels an EI that hasn't taken effect yet
+                    cpu.ime = false;
+                    cpu.ime_pending = false;
+                    return 4;
+                } else if constexpr (y == 7) {
+                    // EI takes effect after the following instruction
+                    cpu.ime_pending = true;
+                    return 4;
+                } else {
+                    return illegal(cpu);
+                }
+            } else if constexpr (z == 4) {
+                if constexpr (y <= 3) {
+                    // CALL cc, a16
+                    uint16_t addr = fetch16(cpu);
+                    if (!condition<y>(cpu)) {
+                        return 12;
+                    }
+                    push16(cpu, cpu.registers.pc);
+                    cpu.registers.pc = addr;
+                    return 24;
+                } else {
+                    return illegal(cpu);
+                }
+            } else if constexpr (z == 5) {
+                if constexpr (q == 0) {
+                    // PUSH rr (AF instead of SP)
+                    if constexpr (p == 3) push16(cpu, cpu.getRegisterAF());
+                    else push16(cpu, rp<p>(cpu));
+                    return 16;
+                } else if constexpr (p == 0) {
+                    // CALL a16
+                    uint16_t addr = fetch16(cpu);
+                    push16(cpu, cpu.registers.pc);
+                    cpu.registers.pc = addr;
+                    return 24;
+                } else {
+                    return illegal(cpu);
+                }
+            } else if constexpr (z == 6) {
+                // ALU A, d8
+                alu<y>(cpu, fetch8(cpu));
+                return 8;
+            } else {
+                // RST n
+                push16(cpu, cpu.registers.pc);
+                cpu.registers.pc = y * 8;
+                return 16;
+            }
+        }
     }
-    
-    // Set flags
-    setFlag(FLAG_Z, value == 0);
-    setFlag(FLAG_N, false);
-    setFlag(FLAG_H, false);
-    setFlag(FLAG_C, false);
-}
 
-void CPU::executeSRL() {
-    // Shift Right Logical (MSB becomes 0)
-    uint8_t value;
-    uint8_t bit0;
-    
-    if (current_instruction->addr_mode == Instructions::AddrMode::MR) {
-        // Operate on memory
-        uint16_t addr = getRegister16Bit(current_instruction->reg1);
-        value = memory.read(addr);
-        bit0 = value & 0x01;
-        value = value >> 1;
-        memory.write(addr, value);
-    } else {
-        // Operate on register
-        value = getRegister8Bit(current_instruction->reg1);
-        bit0 = value & 0x01;
-        value = value >> 1;
-        setRegister8Bit(current_instruction->reg1, value);
+    // Handler for one CB-prefixed opcode (cycles include the 0xCB prefix)
+    template <uint8_t OP>
+    static uint8_t cb(CPU& cpu) {
+        constexpr int x = OP >> 6;
+        constexpr int y = (OP >> 3) & 7;
+        constexpr int z = OP & 7;
+
+        if constexpr (x == 0) {
+            // Rotates and shifts
+            set8<z>(cpu, rot<y>(cpu, get8<z>(cpu)));
+            return z == 6 ? 16 : 8;
+        } else if constexpr (x == 1) {
+            // BIT y, r
+            cpu.executeBIT(y, get8<z>(cpu));
+            return z == 6 ? 12 : 8;
+        } else if constexpr (x == 2) {
+            // RES y, r
+            set8<z>(cpu, get8<z>(cpu) & static_cast<uint8_t>(~(1 << y)));
+            return z == 6 ? 16 : 8;
+        } else {
+            // SET y, r
+            set8<z>(cpu, get8<z>(cpu) | static_cast<uint8_t>(1 << y));
+            return z == 6 ? 16 : 8;
+        }
     }
-    
-    // Set flags
-    setFlag(FLAG_Z, value == 0);
-    setFlag(FLAG_N, false);
-    setFlag(FLAG_H, false);
-    setFlag(FLAG_C, bit0);
-}
 
-void CPU::executeBIT() {
-    // Test bit in register or memory
-    uint8_t value;
-    uint8_t bitPos = current_instruction->param;
-    uint8_t bitMask = 1 << bitPos;
-    
-    if (current_instruction->addr_mode == Instructions::AddrMode::MR) {
-        // Test bit in memory
-        uint16_t addr = getRegister16Bit(current_instruction->reg1);
-        value = memory.read(addr);
-    } else {
-        // Test bit in register
-        value = getRegister8Bit(current_instruction->reg1);
+    template <size_t... I>
+    static constexpr std::array<OpHandler, 256> makeTable(std::index_sequence<I...>) {
+        return {{ &op<static_cast<uint8_t>(I)>... }};
     }
-    
-    // Set flags
-    setFlag(FLAG_Z, (value & bitMask) == 0);
-    setFlag(FLAG_N, false);
-    setFlag(FLAG_H, true);
-    // C flag is unaffected
-}
 
-void CPU::executeRES() {
-    // Reset bit in register or memory
-    uint8_t value;
-    uint8_t bitPos = current_instruction->param;
-    uint8_t bitMask = ~(1 << bitPos);
-    
-    if (current_instruction->addr_mode == Instructions::AddrMode::MR) {
-        // Reset bit in memory
-        uint16_t addr = getRegister16Bit(current_instruction->reg1);
-        value = memory.read(addr);
-        value &= bitMask;
-        memory.write(addr, value);
-    } else {
-        // Reset bit in register
-        value = getRegister8Bit(current_instruction->reg1);
-        value &= bitMask;
-        setRegister8Bit(current_instruction->reg1, value);
+    template <size_t... I>
+    static constexpr std::array<OpHandler, 256> makeCBTable(std::index_sequence<I...>) {
+        return {{ &cb<static_cast<uint8_t>(I)>... }};
     }
-    
-    // No flags are affected
-}
+};
 
-void CPU::executeSET() {
-    // Set bit in register or memory
-    uint8_t value;
-    uint8_t bitPos = current_instruction->param;
-    uint8_t bitMask = 1 << bitPos;
-    
-    if (current_instruction->addr_mode == Instructions::AddrMode::MR) {
-        // Set bit in memory
-        uint16_t addr = getRegister16Bit(current_instruction->reg1);
-        value = memory.read(addr);
-        value |= bitMask;
-        memory.write(addr, value);
-    } else {
-        // Set bit in register
-        value = getRegister8Bit(current_instruction->reg1);
-        value |= bitMask;
-        setRegister8Bit(current_instruction->reg1, value);
-    }
-    
-    // No flags are affected
-} 
\ No newline at end of file
+// The 256 + 256 handler tables, built at compile time
+const std::array<CPU::OpHandler, 256> CPU::op_table = CPU::Ops::makeTable(std::make_index_sequence<256>{});
+const std::array<CPU::OpHandler, 256> CPU::cb_table = CPU::Ops::makeCBTable(std::make_index_sequence<256>{});
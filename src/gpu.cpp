@@ -1,5 +1,9 @@
 #include "gpu.hpp"
 #include "memory.hpp"
+#include "scheduler.hpp"
+#include "log.hpp"
+#include "pixel_kernels.hpp"
+#include "savestate.hpp"
 #include <fstream>
 #include <iostream>
 #include <iomanip>  // Make sure this is included for I/O manipulators
@@ -11,9 +15,24 @@ using std::setw;
 using std::setfill;
 using std::setprecision;
 
-GPU::GPU(MemoryBus& memory) : memory(memory), current_mode(LCDMode::HBLANK), mode_cycles(0), line(0), frame_counter(0), using_debug_pattern(true), cycles_since_last_debug(0) {
+#if GB_LOG_LEVEL >= GB_LOG_LEVEL_TRACE
+// Color indices of one decoded tile row as "c c c c c c c c", for fetcher trace output
+static std::string tileRowPattern(const uint8_t* row) {
+    std::string pattern;
+    for (int x = 0; x < 8; x++) {
+        pattern += static_cast<char>('0' + row[x]);
+        if (x < 7) pattern += ' ';
+    }
+    return pattern;
+}
+#endif
+
+GPU::GPU(MemoryBus& memory) : memory(memory), current_mode(LCDMode::HBLANK), mode_cycles(0), line(0), frame_counter(0), using_debug_pattern(true), cycles_since_last_debug(0), scheduler(nullptr), last_sync_cycle(0) {
     screen_buffer.resize(SCREEN_WIDTH * SCREEN_HEIGHT, 0xFFFFFFFF); // Initialize to white
     
+    // At most 10 sprites per line; reserving up front keeps OAM scans allocation-free
+    visible_sprites.reserve(MAX_SPRITES_PER_LINE);
+    
     // Initialize VRAM to zeros
     vram.fill(0);
     
@@ -34,7 +53,7 @@ GPU::GPU(MemoryBus& memory) : memory(memory), current_mode(LCDMode::HBLANK), mod
         vram[0x1C00 + i] = 2; // Use tile #2 for the window map
     }
     
-    std::cout << "GPU initialized with test pattern" << std::endl;
+    GB_LOG_INFO(LOG_GPU, "GPU initialized with test pattern");
 }
 
 void GPU::tick(uint64_t cycles) {
@@ -51,7 +70,6 @@ void GPU::tick(uint64_t cycles) {
     
     // Accumulate cycles
     mode_cycles += cycles;
-    cycles_since_last_debug += cycles;
     
     // Update LCD status based on current mode and line
     // The PPU state machine has 4 modes:
@@ -60,18 +78,31 @@ void GPU::tick(uint64_t cycles) {
     // Mode 0 (HBlank): Remaining cycles to 456 total
     // Mode 1 (VBlank): 10 lines of 456 cycles each
     
+#if GB_LOG_LEVEL >= GB_LOG_LEVEL_DEBUG
     // Debug: Every 1,000,000 cycles, log the current GPU state
+    cycles_since_last_debug += cycles;
     if (cycles_since_last_debug >= 1000000) {
         cycles_since_last_debug = 0;
-        std::cout << "GPU Mode: " << static_cast<int>(current_mode) 
-                  << ", Line: " << static_cast<int>(memory.read(LY_REG))
-                  << ", Mode cycles: " << mode_cycles 
-                  << ", LCDC: 0x" << std::hex << static_cast<int>(memory.read(LCDC_REG)) 
-                  << ", STAT: 0x" << static_cast<int>(memory.read(STAT_REG)) << std::dec << std::endl;
+        GB_LOG_DEBUG(LOG_GPU, "GPU Mode: " << static_cast<int>(current_mode) 
+                     << ", Line: " << static_cast<int>(memory.read(LY_REG))
+                     << ", Mode cycles: " << mode_cycles 
+                     << ", LCDC: 0x" << std::hex << static_cast<int>(memory.read(LCDC_REG)) 
+                     << ", STAT: 0x" << static_cast<int>(memory.read(STAT_REG)) << std::dec);
+    }
+#endif
+    
+    // Run the mode state machine until the accumulated cycles fall short of
+    // the current mode's duration (one call may cross several boundaries)
+    while (advanceMode()) {
     }
+}
+
+bool GPU::advanceMode() {
+    LCDMode previous_mode = current_mode;
     
     // Get the current line
     uint8_t current_line = memory.read(LY_REG);
+    uint8_t previous_line = current_line;
     
     // Process the current state
     switch (current_mode) {
@@ -79,12 +110,19 @@ void GPU::tick(uint64_t cycles) {
             // Mode 2 - OAM Scan (80 cycles)
             // During this time, OAM is inaccessible
             if (mode_cycles >= CYCLES_OAM) {
-                // Prepare the scanline data for rendering
-                scanOAM();
+                // Prepare the scanline data for rendering. Mode 3's length
+                // counts sprites itself, so skipped frames don't need them
+                if (draw_frame) {
+                    scanOAM();
+                } else {
+                    visible_sprites.clear();
+                }
                 
-                // Move to pixel transfer mode
+                // Move to pixel transfer mode. Its length depends on the
+                // line's sprites, scroll and window, so work it out once here
                 current_mode = LCDMode::TRANSFER;
                 startPixelTransfer();
+                mode3_duration = calculateMode3Duration(current_line);
                 
                 // Update STAT register
                 uint8_t stat = memory.read(STAT_REG);
@@ -100,14 +138,21 @@ void GPU::tick(uint64_t cycles) {
         
         case LCDMode::TRANSFER: {
             // Mode 3 - Pixel Transfer (variable duration)
-            // Calculate the duration based on rendering properties
-            uint16_t mode3_duration = calculateMode3Duration(current_line);
-            
-            // Process the current pixel fetching and FIFO operation
-            processScanline();
-            
             // Check if we've completed the transfer phase
             if (mode_cycles >= mode3_duration) {
+                // Draw the line with the selected renderer
+                if (!draw_frame) {
+                    // Skipped frame: nothing to draw, but the window line
+                    // counter still advances as renderWindow() would have it
+                    uint8_t lcdc = memory.read(LCDC_REG);
+                    window_active = (lcdc & 0x21) == 0x21 && current_line >= memory.read(WY_REG) &&
+                                    memory.read(WX_REG) <= 166;
+                } else if (renderer_mode == RendererMode::FIFO) {
+                    processScanline();
+                } else {
+                    renderScanline();
+                }
+                
                 // Finalize the scanline
                 finalizeCurrentLine();
                 
@@ -135,12 +180,12 @@ void GPU::tick(uint64_t cycles) {
         
         case LCDMode::HBLANK: {
             // Mode 0 - HBlank
-            uint16_t hblank_duration = CYCLES_SCANLINE - CYCLES_OAM - calculateMode3Duration(current_line);
+            uint16_t hblank_duration = CYCLES_SCANLINE - CYCLES_OAM - mode3_duration;
             
             if (mode_cycles >= hblank_duration) {
                 // Advance to the next line
                 current_line = (current_line + 1) % 154;
-                memory.write(LY_REG, current_line);
+                memory.setLY(current_line);
                 
                 // Check LYC=LY condition
                 checkLYC();
@@ -177,16 +222,22 @@ void GPU::tick(uint64_t cycles) {
                     // MODIFIED: Only draw test pattern during first 10 frames
                     if (frame_counter <= 10) {
                         drawTestPattern();
-                        std::cout << "Frame " << frame_counter << ": Drawing test pattern" << std::endl;
-                    } else if (frame_counter % 60 == 0) {
-                        // Every 60 frames, dump tilemap for debugging
-                        dumpTilemapDebug();
+                        GB_LOG_DEBUG(LOG_GPU, "Frame " << frame_counter << ": Drawing test pattern");
                     }
                     
-                    // Only in VBlank: Check VRAM for valid data (debug purposes)
-                    if (frame_counter % 30 == 0) {
-                        checkVRAMData();
+#if GB_LOG_LEVEL >= GB_LOG_LEVEL_DEBUG
+                    if (logEnabled(LOG_GPU)) {
+                        // Every 60 frames, dump tilemap for debugging
+                        if (frame_counter > 10 && frame_counter % 60 == 0) {
+                            dumpTilemapDebug();
+                        }
+                        
+                        // Only in VBlank: Check VRAM for valid data (debug purposes)
+                        if (frame_counter % 30 == 0) {
+                            checkVRAMData();
+                        }
                     }
+#endif
                 } else {
                     // Start a new OAM scan
                     current_mode = LCDMode::OAM;
@@ -213,7 +264,7 @@ void GPU::tick(uint64_t cycles) {
             if (mode_cycles >= CYCLES_SCANLINE) {
                 // Advance to the next line
                 current_line = (current_line + 1) % 154;
-                memory.write(LY_REG, current_line);
+                memory.setLY(current_line);
                 
                 // Check LYC=LY condition
                 checkLYC();
@@ -228,6 +279,7 @@ void GPU::tick(uint64_t cycles) {
                     
                     // Reset window line counter
                     window_line = 0;
+                    startFrame();
                     
                     // Update STAT register
                     uint8_t stat = memory.read(STAT_REG);
@@ -246,6 +298,71 @@ void GPU::tick(uint64_t cycles) {
             break;
         }
     }
+    
+    // A transition happened if either the mode or the line changed
+    return current_mode != previous_mode || current_line != previous_line;
+}
+
+void GPU::setFrameSkip(uint32_t frames) {
+    frame_skip = frames;
+    frames_to_skip = std::min(frames_to_skip, frames);
+}
+
+void GPU::startFrame() {
+    if (frames_to_skip > 0) {
+        frames_to_skip--;
+        draw_frame = false;
+    } else {
+        frames_to_skip = frame_skip;
+        draw_frame = true;
+    }
+}
+
+void GPU::setScheduler(Scheduler* scheduler_ptr) {
+    scheduler = scheduler_ptr;
+    
+    if (scheduler != nullptr) {
+        last_sync_cycle = scheduler->now();
+        scheduler->schedule(EventType::PPU_MODE, last_sync_cycle + cyclesUntilNextEvent());
+    }
+}
+
+void GPU::sync(uint64_t now) {
+    if (now > last_sync_cycle) {
+        tick(now - last_sync_cycle);
+    }
+    last_sync_cycle = now;
+    
+    // Post the next mode boundary
+    if (scheduler != nullptr) {
+        scheduler->schedule(EventType::PPU_MODE, now + cyclesUntilNextEvent());
+    }
+}
+
+uint32_t GPU::cyclesUntilNextEvent() {
+    // With the LCD off nothing changes; poll once per scanline so we notice it being turned back on
+    if (!isLCDEnabled()) {
+        return CYCLES_SCANLINE;
+    }
+    
+    uint32_t mode_duration = CYCLES_SCANLINE;
+    
+    switch (current_mode) {
+        case LCDMode::OAM:
+            mode_duration = CYCLES_OAM;
+            break;
+        case LCDMode::TRANSFER:
+            mode_duration = mode3_duration;
+            break;
+        case LCDMode::HBLANK:
+            mode_duration = CYCLES_SCANLINE - CYCLES_OAM - mode3_duration;
+            break;
+        case LCDMode::VBLANK:
+            mode_duration = CYCLES_SCANLINE;
+            break;
+    }
+    
+    return mode_duration > mode_cycles ? mode_duration - mode_cycles : 1;
 }
 
 // PIXEL FIFO IMPLEMENTATION METHODS
@@ -281,7 +398,7 @@ void GPU::scanOAM() {
     // Scan OAM for sprites that intersect with this scanline
     for (int i = 0; i < 40; i++) {
         uint16_t oam_addr = 0xFE00 + (i * 4);
-        uint8_t y_pos = memory.read(oam_addr) - 16;  // Y position is offset by 16
+        int y_pos = memory.read(oam_addr) - 16;  // Y position is offset by 16
         
         // Check if sprite is on this scanline
         if (current_line >= y_pos && current_line < y_pos + sprite_height) {
@@ -297,7 +414,7 @@ void GPU::scanOAM() {
             visible_sprites.push_back(sprite);
             
             // Game Boy hardware limited to 10 sprites per scanline
-            if (visible_sprites.size() >= 10) {
+            if (visible_sprites.size() >= MAX_SPRITES_PER_LINE) {
                 break;
             }
         }
@@ -319,8 +436,11 @@ void GPU::startPixelTransfer() {
 }
 
 void GPU::processScanline() {
-    // Process the fetcher and FIFO for the current pixel being rendered
-    while (pixel_x < SCREEN_WIDTH && mode_cycles < calculateMode3Duration(memory.read(LY_REG))) {
+    // The PPU is only brought up to date at mode boundaries, so the whole line
+    // goes through the fetcher and FIFO when mode 3 ends. The step limit only
+    // guards against a fetcher that stops feeding the FIFO
+    int steps = 0;
+    while (pixel_x < SCREEN_WIDTH && steps++ < CYCLES_SCANLINE * 4) {
         // Advance the tile fetcher state machine, which runs at 2MHz (half the CPU clock)
         if (++fetcher_cycles % 2 == 0) {
             fetchTileData();
@@ -376,16 +496,14 @@ void GPU::fetchTileData() {
             tile_idx = memory.read(tile_map_addr);
             
             // Debug output - dramatically reduce frequency
-            static int tile_fetch_count = 0;
-            if (++tile_fetch_count % 500000 == 0) {
-                std::cout << "TILE FETCH: map addr=0x" << std::hex << tile_map_addr
-                          << ", tile_idx=" << static_cast<int>(tile_idx)
-                          << ", at x=" << std::dec << static_cast<int>(x_pos)
-                          << ", y=" << static_cast<int>(y_pos / 8)
-                          << ", fetcher_x=" << fetcher_x
-                          << ", line=" << static_cast<int>(current_line)
-                          << ", window=" << (window_active ? "YES" : "NO") << std::endl;
-            }
+            GB_LOG_TRACE_EVERY(LOG_GPU, 500000,
+                "TILE FETCH: map addr=0x" << std::hex << tile_map_addr
+                << ", tile_idx=" << static_cast<int>(tile_idx)
+                << ", at x=" << std::dec << static_cast<int>(x_pos)
+                << ", y=" << static_cast<int>(y_pos / 8)
+                << ", fetcher_x=" << fetcher_x
+                << ", line=" << static_cast<int>(current_line)
+                << ", window=" << (window_active ? "YES" : "NO"));
             
             // Advance to next state
             fetcher_state = FetcherState::DATA_LOW;
@@ -393,9 +511,7 @@ void GPU::fetchTileData() {
         }
         
         case FetcherState::DATA_LOW: {
-            // Get the data address for the tile
-            uint16_t tile_data_addr = getTileDataAddress();
-            uint8_t current_line = memory.read(LY_REG);
+            // Row of the tile for this line
             uint8_t y_pos;
             
             if (window_active) {
@@ -404,27 +520,17 @@ void GPU::fetchTileData() {
                 y_pos = (memory.read(SCY_REG) + current_line) % 8;
             }
             
-            // Calculate the exact address based on the tile index and addressing mode
-            uint16_t tile_addr;
-            if (tile_data_addr == 0x8000) {
-                // Unsigned addressing mode
-                tile_addr = tile_data_addr + tile_idx * 16;
-            } else {
-                // Signed addressing mode
-                tile_addr = tile_data_addr + (static_cast<int8_t>(tile_idx) + 128) * 16;
-            }
-            
-            // Read the low byte of the tile data for this row
-            tile_data_low = memory.read(tile_addr + y_pos * 2);
+            // The tile cache already holds the row decoded, so both bit planes
+            // are picked up here; DATA_HIGH only keeps the fetcher's step count
+            uint16_t tile = getTileNumber(tile_idx);
+            tile_row = memory.getTileCache().getRow(tile, y_pos);
             
             // Debug output - drastically reduce frequency
-            static int data_low_count = 0;
-            if (++data_low_count % 500000 == 0) {
-                std::cout << "TILE DATA LOW: addr=0x" << std::hex << (tile_addr + y_pos * 2)
-                          << ", data=0x" << static_cast<int>(tile_data_low)
-                          << ", tile_idx=" << static_cast<int>(tile_idx)
-                          << ", y_offset=" << std::dec << static_cast<int>(y_pos) << std::endl;
-            }
+            GB_LOG_TRACE_EVERY(LOG_GPU, 500000,
+                "TILE DATA: tile=" << tile
+                << ", tile_idx=" << static_cast<int>(tile_idx)
+                << ", y_offset=" << static_cast<int>(y_pos)
+                << ", pattern: " << tileRowPattern(tile_row));
             
             // Advance to next state
             fetcher_state = FetcherState::DATA_HIGH;
@@ -432,45 +538,6 @@ void GPU::fetchTileData() {
         }
         
         case FetcherState::DATA_HIGH: {
-            // Get the data address for the tile
-            uint16_t tile_data_addr = getTileDataAddress();
-            uint8_t current_line = memory.read(LY_REG);
-            uint8_t y_pos;
-            
-            if (window_active) {
-                y_pos = window_line % 8;
-    } else {
-                y_pos = (memory.read(SCY_REG) + current_line) % 8;
-            }
-            
-            // Calculate the exact address based on the tile index and addressing mode
-            uint16_t tile_addr;
-            if (tile_data_addr == 0x8000) {
-                // Unsigned addressing mode
-                tile_addr = tile_data_addr + tile_idx * 16;
-            } else {
-                // Signed addressing mode
-                tile_addr = tile_data_addr + (static_cast<int8_t>(tile_idx) + 128) * 16;
-            }
-            
-            // Read the high byte of the tile data for this row
-            tile_data_high = memory.read(tile_addr + y_pos * 2 + 1);
-            
-            // Debug output - drastically reduce frequency 
-            static int data_high_count = 0;
-            if (++data_high_count % 500000 == 0) {
-                std::cout << "TILE DATA HIGH: addr=0x" << std::hex << (tile_addr + y_pos * 2 + 1)
-                          << ", data=0x" << static_cast<int>(tile_data_high)
-                          << ", combined data pattern:";
-                for (int bit = 7; bit >= 0; bit--) {
-                    uint8_t color_low = (tile_data_low >> bit) & 0x01;
-                    uint8_t color_high = (tile_data_high >> bit) & 0x01;
-                    uint8_t color_idx = (color_high << 1) | color_low;
-                    std::cout << " " << static_cast<int>(color_idx);
-                }
-                std::cout << std::dec << std::endl;
-            }
-            
             // Advance to next state
             fetcher_state = FetcherState::PUSH;
             break;
@@ -479,35 +546,15 @@ void GPU::fetchTileData() {
         case FetcherState::PUSH: {
             // Only push pixels to the FIFO if it has room (less than 8 pixels)
             if (bg_fifo.size() <= 8) {
-                // Debug output before pushing pixels - drastically reduce frequency
-                static int push_count = 0;
-                bool should_log = (++push_count % 500000 == 0);
-                
-                if (should_log) {
-                    std::cout << "PUSHING PIXELS TO FIFO: low=0x" << std::hex 
-                              << static_cast<int>(tile_data_low) << ", high=0x" 
-                              << static_cast<int>(tile_data_high) << std::dec 
-                              << ", pattern=";
-                }
-                
                 // Push 8 pixels to the FIFO
-                for (int bit = 7; bit >= 0; bit--) {
-                    uint8_t color_low = (tile_data_low >> bit) & 0x01;
-                    uint8_t color_high = (tile_data_high >> bit) & 0x01;
-                    uint8_t color_idx = (color_high << 1) | color_low;
-                    
-                    // Log the pixel being pushed if it's time
-                    if (should_log) {
-                        std::cout << static_cast<int>(color_idx);
-                        if (bit > 0) std::cout << " ";
-                    }
-                    
-                    bg_fifo.emplace_back(color_idx, false);
+                for (int x = 0; x < 8; x++) {
+                    bg_fifo.push(tile_row[x]);
                 }
                 
-                if (should_log) {
-                    std::cout << ", fifo size after push: " << bg_fifo.size() << std::endl;
-                }
+                // Debug output after pushing pixels - drastically reduce frequency
+                GB_LOG_TRACE_EVERY(LOG_GPU, 500000,
+                    "PUSHING PIXELS TO FIFO: pattern=" << tileRowPattern(tile_row)
+                    << ", fifo size after push: " << bg_fifo.size());
                 
                 // Move to the next tile
                 fetcher_x++;
@@ -531,7 +578,7 @@ void GPU::mixPixels() {
     for (const auto& sprite : visible_sprites) {
         // Check if the sprite is in range of the current pixel position
         int sprite_x = sprite.x;
-        if (pixel_x + bg_fifo.size() > sprite_x && pixel_x <= sprite_x + 8) {
+        if (pixel_x + static_cast<int>(bg_fifo.size()) > sprite_x && pixel_x <= sprite_x + 8) {
             // This sprite overlaps with the FIFO
             fetchSpriteTile(sprite);
         }
@@ -570,20 +617,13 @@ void GPU::fetchSpriteTile(const OAMEntry& sprite) {
         }
     }
     
-    // Calculate the tile data address (sprite tiles always use 0x8000 addressing)
-    uint16_t tile_addr = 0x8000 + tile * 16 + row * 2;
-    
-    // Read the tile data for this row
-    uint8_t data_low = memory.read(tile_addr);
-    uint8_t data_high = memory.read(tile_addr + 1);
+    // Decoded row of the sprite tile (sprite tiles always use 0x8000 addressing)
+    const uint8_t* sprite_row = memory.getTileCache().getRow(tile, row);
     
     // Process all 8 pixels of the sprite
     for (int x = 0; x < 8; x++) {
         // Apply X-flip if needed
-        uint8_t bit = x_flip ? x : 7 - x;
-        
-        // Get color index
-        uint8_t color_idx = ((data_low >> bit) & 0x01) | (((data_high >> bit) & 0x01) << 1);
+        uint8_t color_idx = sprite_row[x_flip ? 7 - x : x];
         
         // Skip transparent pixels (color 0)
         if (color_idx == 0) {
@@ -599,17 +639,18 @@ void GPU::fetchSpriteTile(const OAMEntry& sprite) {
         }
         
         // Add sprite pixel to the sprite FIFO at the correct position
-        int fifo_index = screen_x - pixel_x;
+        size_t fifo_index = static_cast<size_t>(screen_x - pixel_x);
         if (fifo_index < bg_fifo.size()) {
-            // Replace existing sprite pixel only if this one has higher priority
-            SpritePixelInfo pixel_info(color_idx, palette_num, priority, sprite.oam_idx);
-            
-            // Insert or update sprite pixel in the FIFO
+            // Expand the sprite FIFO with transparent pixels if needed
             if (sprite_fifo.size() <= fifo_index) {
-                // Expand the sprite FIFO if needed
                 sprite_fifo.resize(fifo_index + 1);
             }
-            sprite_fifo[fifo_index] = pixel_info;
+            
+            // visible_sprites is in priority order, so a pixel already taken by
+            // an earlier sprite is kept (only transparent slots are replaced)
+            if (sprite_fifo.at(fifo_index).color == 0) {
+                sprite_fifo.set(fifo_index, color_idx, palette_num, priority);
+            }
         }
     }
 }
@@ -619,27 +660,23 @@ void GPU::drawPixel() {
     uint8_t current_line = memory.read(LY_REG);
     
     // Pop off the front pixel from the FIFO
-    BGPixelInfo bg_pixel = {0, false};
+    Fifo::Pixel bg_pixel;
     if (!bg_fifo.empty()) {
-        bg_pixel = bg_fifo.front();
-        bg_fifo.pop_front();
+        bg_pixel = bg_fifo.pop();
     }
     
     // Get sprite pixel (if any) for this location
-    SpritePixelInfo sprite_pixel;
+    Fifo::Pixel sprite_pixel;
     if (!sprite_fifo.empty()) {
-        sprite_pixel = sprite_fifo.front();
-        sprite_fifo.pop_front();
+        sprite_pixel = sprite_fifo.pop();
     }
     
     // Debug: Log only every 500,000th pixel being drawn to verify the rendering pipeline
-    static int pixel_counter = 0;
-    if (++pixel_counter % 500000 == 0) {
-        std::cout << "Drawing pixel #" << pixel_counter << " at position " 
-                  << pixel_x << ", " << current_line 
-                  << " with BG color: " << static_cast<int>(bg_pixel.colorIndex)
-                  << ", sprite color: " << static_cast<int>(sprite_pixel.colorIndex) << std::endl;
-    }
+    GB_LOG_TRACE_EVERY(LOG_GPU, 500000,
+        "Drawing pixel at position " 
+        << pixel_x << ", " << static_cast<int>(current_line) 
+        << " with BG color: " << static_cast<int>(bg_pixel.color)
+        << ", sprite color: " << static_cast<int>(sprite_pixel.color));
     
     // Determine the final color
     uint8_t final_color_idx = 0;
@@ -648,21 +685,18 @@ void GPU::drawPixel() {
     bool bg_enabled = areBGAndWindowEnabled();
     
     // Log BGP register value much less frequently
-    static int bgp_debug_count = 0;
-    if (bgp_debug_count++ % 500000 == 0) {
-        uint8_t bg_palette = memory.read(BGP_REG);
-        std::cout << "BGP register value: 0x" << std::hex << static_cast<int>(bg_palette)
-                  << std::dec << " (BG Enabled: " << (bg_enabled ? "YES" : "NO") << ")" << std::endl;
-    }
+    GB_LOG_TRACE_EVERY(LOG_GPU, 500000,
+        "BGP register value: 0x" << std::hex << static_cast<int>(memory.read(BGP_REG))
+        << std::dec << " (BG Enabled: " << (bg_enabled ? "YES" : "NO") << ")");
     
     if (bg_enabled) {
         // Background is enabled
-        if (sprite_pixel.colorIndex != 0) {
+        if (sprite_pixel.color != 0) {
             // Sprite pixel is not transparent
             // Check sprite priority
-            if (sprite_pixel.priority && bg_pixel.colorIndex != 0) {
+            if (sprite_pixel.priority && bg_pixel.color != 0) {
                 // BG has priority over sprite (when sprite attr bit 7 is set and BG is not color 0)
-                final_color_idx = bg_pixel.colorIndex;
+                final_color_idx = bg_pixel.color;
                 
                 // Get the background palette
                 uint8_t bg_palette = memory.read(BGP_REG);
@@ -671,17 +705,17 @@ void GPU::drawPixel() {
                 final_color_idx = getColorFromPalette(bg_palette, final_color_idx);
             } else {
                 // Sprite has priority
-                final_color_idx = sprite_pixel.colorIndex;
+                final_color_idx = sprite_pixel.color;
                 
                 // Get the sprite palette
-                uint8_t sprite_palette = sprite_pixel.paletteNum ? memory.read(OBP1_REG) : memory.read(OBP0_REG);
+                uint8_t sprite_palette = sprite_pixel.palette ? memory.read(OBP1_REG) : memory.read(OBP0_REG);
                 
                 // Get the color from the palette
                 final_color_idx = getColorFromPalette(sprite_palette, final_color_idx);
             }
         } else {
             // Sprite pixel is transparent, use background
-            final_color_idx = bg_pixel.colorIndex;
+            final_color_idx = bg_pixel.color;
             
             // Get the background palette
             uint8_t bg_palette = memory.read(BGP_REG);
@@ -689,12 +723,12 @@ void GPU::drawPixel() {
             // Get the color from the palette
             final_color_idx = getColorFromPalette(bg_palette, final_color_idx);
         }
-    } else if (sprite_pixel.colorIndex != 0) {
+    } else if (sprite_pixel.color != 0) {
         // Background is disabled but sprite is visible
-        final_color_idx = sprite_pixel.colorIndex;
+        final_color_idx = sprite_pixel.color;
         
         // Get the sprite palette
-        uint8_t sprite_palette = sprite_pixel.paletteNum ? memory.read(OBP1_REG) : memory.read(OBP0_REG);
+        uint8_t sprite_palette = sprite_pixel.palette ? memory.read(OBP1_REG) : memory.read(OBP0_REG);
         
         // Get the color from the palette
         final_color_idx = getColorFromPalette(sprite_palette, final_color_idx);
@@ -763,66 +797,38 @@ uint8_t GPU::getSpriteHeight() const {
     return (lcdc & 0x04) ? 16 : 8;
 }
 
-// THE SECTIONS BELOW ARE KEPT FROM THE ORIGINAL IMPLEMENTATION
+// SCANLINE RENDERER
 
 void GPU::renderScanline() {
-    // Placeholder implementation - will be expanded later
-    uint8_t ly = memory.read(0xFF44);
-    uint8_t lcdc = memory.read(0xFF40);
-    
-    // Only render if LCD is enabled (bit 7 of LCDC)
-    if (lcdc & 0x80) {
-        // Render background, window, and sprites in that order
-        renderBackground(ly);
-        renderWindow(ly);
-        renderSprites(ly);
-    }
-    
-    // Debug: Check if screen buffer contains any non-white pixels
-    bool has_content = false;
-    for (int x = 0; x < SCREEN_WIDTH; x++) {
-        if (screen_buffer[ly * SCREEN_WIDTH + x] != 0xFFFFFFFF) {
-            has_content = true;
-            break;
-        }
+    uint8_t ly = memory.read(LY_REG);
+    if (ly >= SCREEN_HEIGHT) {
+        return;
     }
     
-    // If this is the first scanline with content, log it
-    static bool logged_content = false;
-    if (has_content && !logged_content) {
-        std::cout << "First non-white pixel detected on scanline " << (int)ly << std::endl;
-        logged_content = true;
-    }
+    uint8_t lcdc = memory.read(LCDC_REG);
+    uint32_t* row = &screen_buffer[ly * SCREEN_WIDTH];
     
-    // Every 60 frames, check the composition of the screen buffer
-    if (frame_counter % 60 == 0 && memory.read(LY_REG) == 80) {
-        // Count different colors in screen buffer to see what's being rendered
-        int white_pixels = 0, non_white_pixels = 0;
+    if (lcdc & 0x01) {
+        // Background then window fill in the raw color indices for the line
+        renderBackground(ly);
+        renderWindow(ly);
         
-        for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
-            if (screen_buffer[i] == 0xFFFFFFFF) {
-                white_pixels++;
-            } else {
-                non_white_pixels++;
-            }
+        // Map them through BGP once per line rather than once per pixel
+        uint8_t bg_palette = memory.read(BGP_REG);
+        uint32_t colors[4];
+        for (uint8_t i = 0; i < 4; i++) {
+            colors[i] = getRGBColor(getColorFromPalette(bg_palette, i));
         }
         
-        std::cout << "Screen buffer composition: " 
-                  << white_pixels << " white pixels, "
-                  << non_white_pixels << " non-white pixels" << std::endl;
-                  
-        // If we have content, dump the first few non-white pixel values
-        if (non_white_pixels > 0) {
-            std::cout << "Sample non-white pixels (hex): ";
-            int samples = 0;
-            for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT && samples < 5; i++) {
-                if (screen_buffer[i] != 0xFFFFFFFF) {
-                    std::cout << std::hex << "0x" << screen_buffer[i] << " ";
-                    samples++;
-                }
-            }
-            std::cout << std::dec << std::endl;
-        }
+        applyPalette(line_bg_index.data(), colors, row, SCREEN_WIDTH);
+    } else {
+        // BG and window disabled: the line is blank and sprites always win
+        line_bg_index.fill(0);
+        std::fill(row, row + SCREEN_WIDTH, getRGBColor(0));
+    }
+    
+    if (lcdc & 0x02) {
+        renderSprites(ly);
     }
 }
 
@@ -851,19 +857,139 @@ void GPU::checkLYC() {
     memory.write(STAT_REG, stat);
 }
 
+uint16_t GPU::getTileNumber(uint8_t tile_index) const {
+    // 0x8000 mode indexes tiles 0-255 upwards; 0x8800 mode uses a signed index around tile 256 (0x9000)
+    if (getTileDataAddress() == 0x8000) {
+        return tile_index;
+    }
+    return static_cast<uint16_t>(256 + static_cast<int8_t>(tile_index));
+}
+
 void GPU::renderBackground(int scanline) {
-    // This method is now deprecated in favor of the FIFO implementation
-    // But kept for reference
+    const uint8_t* vram_data = memory.getVRAM();
+    TileCache& tiles = memory.getTileCache();
+    uint8_t scroll_x = memory.read(SCX_REG);
+    uint8_t scroll_y = memory.read(SCY_REG);
+    
+    // The background is a 256x256 wrapping plane; find the map row for this line
+    uint8_t y = static_cast<uint8_t>(scroll_y + scanline);
+    const uint8_t* map_row = vram_data + (getBackgroundTileMap() - 0x8000) + (y / 8) * 32;
+    int tile_row = y % 8;
+    
+    // Copy one decoded tile row (8 pixels) at a time. The first tile may be cut by SCX
+    int tile_col = scroll_x / 8;
+    int first_px = scroll_x % 8;
+    int x = 0;
+    
+    while (x < SCREEN_WIDTH) {
+        const uint8_t* pixels = tiles.getRow(getTileNumber(map_row[tile_col & 0x1F]), tile_row);
+        
+        for (int px = first_px; px < 8 && x < SCREEN_WIDTH; px++) {
+            line_bg_index[x++] = pixels[px];
+        }
+        
+        first_px = 0;
+        tile_col++;
+    }
 }
 
 void GPU::renderWindow(int scanline) {
-    // This method is now deprecated in favor of the FIFO implementation
-    // But kept for reference
+    if (!isWindowEnabled()) {
+        return;
+    }
+    
+    // The window starts at (WX-7, WY) and is drawn from its own line counter
+    uint8_t wy = memory.read(WY_REG);
+    uint8_t wx = memory.read(WX_REG);
+    if (scanline < wy || wx > 166) {
+        return;
+    }
+    
+    const uint8_t* vram_data = memory.getVRAM();
+    TileCache& tiles = memory.getTileCache();
+    const uint8_t* map_row = vram_data + (getWindowTileMap() - 0x8000) + (window_line / 8) * 32;
+    int tile_row = window_line % 8;
+    
+    int start_x = wx - 7;
+    int x = std::max(start_x, 0);
+    
+    while (x < SCREEN_WIDTH) {
+        int window_x = x - start_x;
+        const uint8_t* pixels = tiles.getRow(getTileNumber(map_row[(window_x / 8) & 0x1F]), tile_row);
+        
+        for (int px = window_x % 8; px < 8 && x < SCREEN_WIDTH; px++) {
+            line_bg_index[x++] = pixels[px];
+        }
+    }
+    
+    // Tells finalizeCurrentLine() to advance the window line counter
+    window_active = true;
 }
 
 void GPU::renderSprites(int scanline) {
-    // This method is now deprecated in favor of the FIFO implementation
-    // But kept for reference
+    TileCache& tiles = memory.getTileCache();
+    uint8_t sprite_height = getSpriteHeight();
+    uint32_t* row = &screen_buffer[scanline * SCREEN_WIDTH];
+    
+    // Color lookups for OBP0 and OBP1
+    uint32_t colors[2][4];
+    uint8_t palettes[2] = {memory.read(OBP0_REG), memory.read(OBP1_REG)};
+    for (int p = 0; p < 2; p++) {
+        for (uint8_t i = 0; i < 4; i++) {
+            colors[p][i] = getRGBColor(getColorFromPalette(palettes[p], i));
+        }
+    }
+    
+    // visible_sprites is sorted by drawing priority (lowest X, then lowest OAM
+    // index). The first opaque sprite pixel at a position owns it, even when
+    // its BG-priority bit then lets the background show through
+    std::array<bool, SCREEN_WIDTH> claimed{};
+    
+    for (const auto& sprite : visible_sprites) {
+        bool y_flip = (sprite.attrs & 0x40) != 0;
+        bool x_flip = (sprite.attrs & 0x20) != 0;
+        int palette_num = (sprite.attrs & 0x10) ? 1 : 0;
+        bool behind_bg = (sprite.attrs & 0x80) != 0;
+        
+        // Row of the sprite on this line, then pick the tile (8x16 sprites span two)
+        int sprite_row = scanline - sprite.y;
+        if (y_flip) {
+            sprite_row = sprite_height - 1 - sprite_row;
+        }
+        
+        uint8_t tile = sprite.tile_idx;
+        if (sprite_height == 16) {
+            tile &= 0xFE;
+            if (sprite_row >= 8) {
+                tile++;
+                sprite_row -= 8;
+            }
+        }
+        
+        // Sprite tiles always use 0x8000 addressing
+        const uint8_t* pixels = tiles.getRow(tile, sprite_row);
+        
+        for (int px = 0; px < 8; px++) {
+            int x = sprite.x + px;
+            if (x < 0 || x >= SCREEN_WIDTH || claimed[x]) {
+                continue;
+            }
+            
+            uint8_t color_idx = pixels[x_flip ? 7 - px : px];
+            
+            // Color 0 is transparent
+            if (color_idx == 0) {
+                continue;
+            }
+            
+            claimed[x] = true;
+            if (behind_bg && line_bg_index[x] != 0) {
+                continue;
+            }
+            
+            row[x] = colors[palette_num][color_idx];
+        }
+    }
 }
 
 void GPU::checkVRAMData() {
@@ -914,13 +1040,10 @@ uint8_t GPU::getColorFromPalette(uint8_t palette, uint8_t colorIdx) {
     uint8_t colorValue = (palette >> (colorIdx * 2)) & 0x03;
     
     // Debug output - drastically limit to avoid spamming console
-    static int debug_count = 0;
-    if (debug_count++ % 1000000 == 0) {
-        std::cout << "Palette mapping: index " << static_cast<int>(colorIdx) 
-                  << " maps to color " << static_cast<int>(colorValue)
-                  << " (palette=0x" << std::hex << static_cast<int>(palette) << std::dec << ")" 
-                  << std::endl;
-    }
+    GB_LOG_TRACE_EVERY(LOG_GPU, 1000000,
+        "Palette mapping: index " << static_cast<int>(colorIdx) 
+        << " maps to color " << static_cast<int>(colorValue)
+        << " (palette=0x" << std::hex << static_cast<int>(palette) << std::dec << ")");
     
     return colorValue;
 }
@@ -949,15 +1072,89 @@ uint32_t GPU::getRGBColor(uint8_t colorValue) {
     }
     
     // Debug output - drastically limit to avoid spamming console
-    static int color_debug_count = 0;
-    if (color_debug_count++ % 1000000 == 0) {
-        std::cout << "RGB Color mapping: GB color " << static_cast<int>(colorValue) 
-                  << " maps to RGB 0x" << std::hex << color << std::dec << std::endl;
-    }
+    GB_LOG_TRACE_EVERY(LOG_GPU, 1000000,
+        "RGB Color mapping: GB color " << static_cast<int>(colorValue) 
+        << " maps to RGB 0x" << std::hex << color << std::dec);
     
     return color;
 }
 
+void GPU::saveState(StateWriter& writer) const {
+    writer.beginChunk("PPU ");
+    writer.write8(static_cast<uint8_t>(current_mode));
+    writer.write16(mode_cycles);
+    writer.write16(mode3_duration);
+    writer.write8(window_line);
+    writer.writeBool(window_active);
+    writer.write32(static_cast<uint32_t>(line));
+    writer.write32(static_cast<uint32_t>(frame_counter));
+    writer.writeBool(using_debug_pattern);
+    writer.write64(last_sync_cycle);
+    
+    // Sprites selected by the last OAM scan, drawn at the end of mode 3.
+    // All 10 slots are written, unused ones zeroed, so the chunk is the same
+    // size on every line
+    writer.write8(static_cast<uint8_t>(visible_sprites.size()));
+    for (size_t i = 0; i < MAX_SPRITES_PER_LINE; i++) {
+        OAMEntry sprite{};
+        if (i < visible_sprites.size()) {
+            sprite = visible_sprites[i];
+        }
+        writer.write16(static_cast<uint16_t>(sprite.y));
+        writer.write16(static_cast<uint16_t>(sprite.x));
+        writer.write8(sprite.tile_idx);
+        writer.write8(sprite.attrs);
+        writer.write8(sprite.oam_idx);
+    }
+    
+    writer.write32Array(screen_buffer.data(), screen_buffer.size());
+    writer.endChunk();
+}
+
+void GPU::loadState(StateReader& reader) {
+    if (!reader.openChunk("PPU ")) {
+        return;
+    }
+    
+    uint8_t mode = reader.read8();
+    if (mode > static_cast<uint8_t>(LCDMode::TRANSFER)) {
+        reader.fail();
+        return;
+    }
+    current_mode = static_cast<LCDMode>(mode);
+    mode_cycles = reader.read16();
+    mode3_duration = reader.read16();
+    window_line = reader.read8();
+    window_active = reader.readBool();
+    line = static_cast<int>(reader.read32());
+    frame_counter = static_cast<int>(reader.read32());
+    using_debug_pattern = reader.readBool();
+    last_sync_cycle = reader.read64();
+    
+    // At most 10 sprites per line, which visible_sprites has reserved room for.
+    // Version 1 states only hold the slots in use
+    uint8_t sprite_count = reader.read8();
+    if (sprite_count > MAX_SPRITES_PER_LINE) {
+        reader.fail();
+        return;
+    }
+    size_t slots = reader.version() >= 2 ? MAX_SPRITES_PER_LINE : sprite_count;
+    visible_sprites.clear();
+    for (size_t i = 0; i < slots; i++) {
+        OAMEntry sprite;
+        sprite.y = static_cast<int16_t>(reader.read16());
+        sprite.x = static_cast<int16_t>(reader.read16());
+        sprite.tile_idx = reader.read8();
+        sprite.attrs = reader.read8();
+        sprite.oam_idx = reader.read8();
+        if (i < sprite_count) {
+            visible_sprites.push_back(sprite);
+        }
+    }
+    
+    reader.read32Array(screen_buffer.data(), screen_buffer.size());
+}
+
 void GPU::reset() {
     // Reset screen buffer to white
     screen_buffer.resize(SCREEN_WIDTH * SCREEN_HEIGHT, 0xFFFFFFFF);
@@ -965,6 +1162,8 @@ void GPU::reset() {
     // Reset PPU state
     current_mode = LCDMode::HBLANK;
     mode_cycles = 0;
+    mode3_duration = CYCLES_TRANSFER;
+    line_bg_index.fill(0);
     
     // Reset LCD registers to power-on values
     memory.write(LCDC_REG, 0x91);  // LCD & BG enabled
@@ -985,6 +1184,8 @@ void GPU::reset() {
     using_debug_pattern = true;
     cycles_since_last_debug = 0;
     window_line = 0;
+    frames_to_skip = 0;
+    draw_frame = true;
     
     // Reset FIFO state
     bg_fifo.clear();
@@ -1012,7 +1213,7 @@ void GPU::reset() {
         vram[0x1C00 + i] = 2; // Use tile #2 for the window map
     }
     
-    std::cout << "GPU reset completed with test pattern" << std::endl;
+    GB_LOG_INFO(LOG_GPU, "GPU reset completed with test pattern");
 }
 
 // Calculate Mode 3 duration based on the current scanline
@@ -1040,12 +1241,17 @@ uint16_t GPU::calculateMode3Duration(uint8_t scanline) {
     
     // Count sprites on this scanline and add penalties
     // This is a simplification - accurate emulation would be more complex
+    // OAM reads as 0xFF during DMA, which puts no sprite on any line
+    if (memory.isDMAActive()) {
+        return duration;
+    }
+    
     uint8_t spriteHeight = (lcdc & 0x04) ? 16 : 8;
     int spritesOnLine = 0;
+    const uint8_t* oam = memory.getOAM();
     
     for (int i = 0; i < 40 && spritesOnLine < 10; i++) {
-        uint16_t oamAddr = 0xFE00 + (i * 4);
-        uint8_t spriteY = memory.read(oamAddr) - 16;
+        uint8_t spriteY = oam[i * 4] - 16;
         
         if (scanline >= spriteY && scanline < spriteY + spriteHeight) {
             spritesOnLine++;
@@ -1084,8 +1290,12 @@ void GPU::dumpVRAM(const std::string& filename) {
 
 void GPU::forceVRAMCheck() {
     // Debug function to force VRAM check
-    std::cout << "Force VRAM check called" << std::endl;
-    checkVRAMData();
+    GB_LOG_DEBUG(LOG_GPU, "Force VRAM check called");
+#if GB_LOG_LEVEL >= GB_LOG_LEVEL_DEBUG
+    if (logEnabled(LOG_GPU)) {
+        checkVRAMData();
+    }
+#endif
 }
 
 // Add this new function to draw a test pattern directly to the screen buffer
@@ -1122,14 +1332,14 @@ void GPU::drawTestPattern() {
     }
     
     // Debug: Make absolutely sure we're writing to the buffer
-    std::cout << "TEST PATTERN: Filling screen buffer with extreme test pattern" << std::endl;
-    std::cout << "Buffer address: " << &screen_buffer[0] << std::endl;
-    std::cout << "Buffer size: " << screen_buffer.size() << " pixels" << std::endl;
-    std::cout << "First 4 pixels (hex): " 
-              << std::hex << "0x" << screen_buffer[0] << " "
-              << "0x" << screen_buffer[1] << " "
-              << "0x" << screen_buffer[2] << " "
-              << "0x" << screen_buffer[3] << std::dec << std::endl;
+    GB_LOG_DEBUG(LOG_GPU, "TEST PATTERN: Filling screen buffer with extreme test pattern\n"
+                 << "Buffer address: " << &screen_buffer[0] << "\n"
+                 << "Buffer size: " << screen_buffer.size() << " pixels\n"
+                 << "First 4 pixels (hex): " 
+                 << std::hex << "0x" << screen_buffer[0] << " "
+                 << "0x" << screen_buffer[1] << " "
+                 << "0x" << screen_buffer[2] << " "
+                 << "0x" << screen_buffer[3] << std::dec);
 }
 
 // Add a new method for tilemap debugging
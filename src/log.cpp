@@ -0,0 +1,25 @@
+#include "log.hpp"
+#include <sstream>
+
+uint32_t gb_log_mask = LOG_ALL;
+
+bool parseLogCategories(const std::string& list, uint32_t& mask) {
+    uint32_t result = 0;
+    std::stringstream stream(list);
+    std::string name;
+
+    while (std::getline(stream, name, ',')) {
+        if (name == "all") result |= LOG_ALL;
+        else if (name == "none") continue;
+        else if (name == "cpu") result |= LOG_CPU;
+        else if (name == "memory" || name == "mem") result |= LOG_MEMORY;
+        else if (name == "gpu") result |= LOG_GPU;
+        else if (name == "timer") result |= LOG_TIMER;
+        else if (name == "cart") result |= LOG_CART;
+        else if (name == "system") result |= LOG_SYSTEM;
+        else return false;
+    }
+
+    mask = result;
+    return true;
+}
@@ -1,10 +1,23 @@
+#include "emulator.hpp"
 #include "cartridge.hpp"
 #include "cpu.hpp"
 #include "memory.hpp"
 #include "gpu.hpp"
 #include "emu.hpp"
 #include "timer.hpp"
+#include "scheduler.hpp"
+#include "log.hpp"
+#include "savestate.hpp"
+#include "rewind.hpp"
+#include "movie.hpp"
+#include "run_ahead.hpp"
+#include "apu.hpp"
+#include "audio_ring.hpp"
+#include "wav_writer.hpp"
+#include "triple_buffer.hpp"
+#ifdef GB_HAVE_SDL
 #include <SDL2/SDL.h>
+#endif
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -14,16 +27,41 @@
 #include <memory>
 #include <chrono>
 #include <thread>
+#include <atomic>
+#include <future>
 #include <algorithm>
 #include <cstring>  // For std::memcpy
 #include <iomanip>  // For std::setw and std::setfill
 
 static EmulatorState ctx;
+static Emulator* emulator = nullptr;
+
+// The emulator's components, for the frontend and debug helpers below
 static Cartridge* cart = nullptr;
 static MemoryBus* memory = nullptr;
 static CPU* cpu = nullptr;
 static GPU* gpu = nullptr;
 static Timer* timer = nullptr;
+static Scheduler* scheduler = nullptr;
+static SaveState* savestate = nullptr;
+static std::string savestate_path;  // <rom>.state, written with F5 and loaded with F8
+static RewindBuffer* rewind_buffer = nullptr;  // Only with --rewind=MB
+static Movie* movie = nullptr;  // Only with --record= or --play=
+static RunAhead* run_ahead = nullptr;  // Only with --run-ahead=N
+
+// Sound output: the audio device plays from the ring, --wav= gets a copy
+static AudioRing* audio_ring = nullptr;  // Only with an audio device open
+static WavWriter* wav_writer = nullptr;  // Only with --wav=
+
+// Game Boy buttons currently held on the keyboard (updateJoypadButton masks).
+// They only reach the joypad at the start of the next frame, which is what
+// makes input recordable
+static uint8_t live_buttons = 0;
+
+// Turbo only draws one emulated frame in this many plus one; the others run
+// the PPU's timing without drawing. Turbo runs many frames per host refresh,
+// so the ones shown are still recent
+static constexpr uint32_t TURBO_FRAME_SKIP = 9;
 
 // Game Boy interrupt register addresses
 static constexpr uint16_t IF_REG = 0xFF0F;  // Interrupt Flag Register
@@ -36,10 +74,19 @@ static constexpr uint8_t INT_TIMER = 0x04;
 static constexpr uint8_t INT_SERIAL = 0x08;
 static constexpr uint8_t INT_JOYPAD = 0x10;
 
-// SDL window and renderer
+#ifdef GB_HAVE_SDL
+// SDL window, and the renderer the presenter thread draws it with
 static SDL_Window* window = nullptr;
 static SDL_Renderer* renderer = nullptr;
 static SDL_Texture* screen_texture = nullptr;
+static SDL_AudioDeviceID audio_device = 0;
+
+// Finished frames go from the emulation loop to the presenter thread through
+// the triple buffer, so the emulator never waits on vsync or the GPU driver
+static TripleBuffer* frame_buffer = nullptr;
+static std::thread presenter_thread;
+static std::atomic<bool> presenter_running{false};
+#endif
 
 // Tracking executed instructions for post-mortem analysis
 static std::map<uint16_t, uint32_t> executed_addresses;
@@ -51,32 +98,11 @@ static int trace_limit = 50000; // Stop tracing after this many instructions
 // Global variables for button state
 static bool buttons[8] = {false}; // [Down, Up, Left, Right, Start, Select, B, A]
 
-// Add these global variables at the top with the other globals
-static bool use_debug_pattern = true; // Set to true by default to ensure we see something
-static bool use_alternating_pattern = false;
-
-bool init_sdl() {
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        std::cerr << "SDL initialization failed: " << SDL_GetError() << std::endl;
-        return false;
-    }
-    
-    std::cout << "SDL initialized successfully" << std::endl;
-    
-    // Create window and renderer
-    window = SDL_CreateWindow("GameBoy Emulator", 
-                              SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-                              SCREEN_WIDTH * 4, SCREEN_HEIGHT * 4,  // Scale display 4x
-                              SDL_WINDOW_SHOWN);
-    
-    if (!window) {
-        std::cerr << "Window creation failed: " << SDL_GetError() << std::endl;
-        return false;
-    }
-    
-    std::cout << "Window created successfully: " << SCREEN_WIDTH * 4 << "x" << SCREEN_HEIGHT * 4 << std::endl;
-    
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+#ifdef GB_HAVE_SDL
+// Create the renderer and screen texture. Called on the presenter thread:
+// a renderer may only be used from the thread that created it
+static bool init_renderer() {
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
     if (!renderer) {
         std::cerr << "Renderer creation failed: " << SDL_GetError() << std::endl;
         return false;
@@ -100,6 +126,8 @@ bool init_sdl() {
     
     if (!screen_texture) {
         std::cerr << "Texture creation failed: " << SDL_GetError() << std::endl;
+        SDL_DestroyRenderer(renderer);
+        renderer = nullptr;
         return false;
     }
     
@@ -110,165 +138,231 @@ bool init_sdl() {
     SDL_RenderClear(renderer);
     SDL_RenderPresent(renderer);
     std::cout << "Test frame rendered (should be red)" << std::endl;
-    SDL_Delay(500); // Pause so we can see the red screen
     
     return true;
 }
 
-void cleanup_sdl() {
-    if (screen_texture) {
-        SDL_DestroyTexture(screen_texture);
+// Upload a frame to the screen texture and draw it scaled to the window
+static void present_frame(const uint32_t* pixels) {
+    void* texture_pixels;
+    int pitch;
+    
+    if (SDL_LockTexture(screen_texture, nullptr, &texture_pixels, &pitch) != 0) {
+        std::cerr << "Failed to lock texture: " << SDL_GetError() << std::endl;
+        return;
     }
-    if (renderer) {
-        SDL_DestroyRenderer(renderer);
+    
+    // The texture's rows may be padded
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        std::memcpy(static_cast<uint8_t*>(texture_pixels) + y * pitch,
+                    pixels + y * SCREEN_WIDTH, SCREEN_WIDTH * sizeof(uint32_t));
     }
-    if (window) {
-        SDL_DestroyWindow(window);
+    
+    SDL_UnlockTexture(screen_texture);
+    
+    // Clear renderer
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); // Black
+    SDL_RenderClear(renderer);
+    
+    // Draw scaled texture to fill window
+    SDL_Rect dest_rect = {0, 0, SCREEN_WIDTH * 4, SCREEN_HEIGHT * 4};
+    SDL_RenderCopy(renderer, screen_texture, NULL, &dest_rect);
+    
+    // Blocks until vsync when the driver honours it; only this thread waits
+    SDL_RenderPresent(renderer);
+}
+
+// Presenter thread: owns the renderer and shows the latest frame the
+// emulation loop has published, once per host refresh
+static void presenter_main(std::promise<bool> ready) {
+    bool ok = init_renderer();
+    ready.set_value(ok);
+    if (!ok) {
+        return;
     }
-    SDL_Quit();
+    
+    while (presenter_running.load(std::memory_order_acquire)) {
+        if (frame_buffer->acquire()) {
+            present_frame(frame_buffer->front());
+        } else {
+            // Nothing new (paused, or the emulator is behind); don't spin
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    
+    SDL_DestroyTexture(screen_texture);
+    SDL_DestroyRenderer(renderer);
+    screen_texture = nullptr;
+    renderer = nullptr;
 }
 
-// Callback for VBLANK interrupt
-void request_vblank_interrupt() {
-    uint8_t if_value = memory->read(IF_REG);
-    memory->write(IF_REG, if_value | INT_VBLANK);
+bool init_sdl() {
+    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+        std::cerr << "SDL initialization failed: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    
+    std::cout << "SDL initialized successfully" << std::endl;
+    
+    // The window is created, and its events handled, on the main thread
+    window = SDL_CreateWindow("GameBoy Emulator", 
+                              SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                              SCREEN_WIDTH * 4, SCREEN_HEIGHT * 4,  // Scale display 4x
+                              SDL_WINDOW_SHOWN);
+    
+    if (!window) {
+        std::cerr << "Window creation failed: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    
+    std::cout << "Window created successfully: " << SCREEN_WIDTH * 4 << "x" << SCREEN_HEIGHT * 4 << std::endl;
+    
+    // Start the presenter and wait for it to have set up the renderer
+    frame_buffer = new TripleBuffer(SCREEN_WIDTH * SCREEN_HEIGHT);
+    std::promise<bool> ready;
+    std::future<bool> renderer_ok = ready.get_future();
+    presenter_running = true;
+    presenter_thread = std::thread(presenter_main, std::move(ready));
+    if (!renderer_ok.get()) {
+        presenter_running = false;
+        presenter_thread.join();
+        return false;
+    }
+    
+    SDL_Delay(500); // Pause so we can see the red screen
+    
+    return true;
 }
 
-// Callback for LCD STAT interrupt
-void request_lcd_stat_interrupt() {
-    uint8_t if_value = memory->read(IF_REG);
-    memory->write(IF_REG, if_value | INT_LCD_STAT);
+// Runs on SDL's audio thread. Whatever the emulator hasn't produced yet is
+// played as silence
+static void audio_callback(void*, Uint8* stream, int length) {
+    int16_t* out = reinterpret_cast<int16_t*>(stream);
+    size_t frames = static_cast<size_t>(length) / (2 * sizeof(int16_t));
+    size_t copied = audio_ring->pop(out, frames);
+    std::memset(out + copied * 2, 0, (frames - copied) * 2 * sizeof(int16_t));
 }
 
-// Function to initialize the system to post-boot state
-void initializeSystem(CPU& cpu, GPU& gpu, MemoryBus& memory, Cartridge& cart, bool dmgMode = true) {
-    // 1. Initialize hardware registers to post-boot ROM values
-    // These match DMG boot state per PanDocs
-    
-    // Joypad
-    memory.write(0xFF00, 0xCF);  // P1/JOYP
-    
-    // Serial
-    memory.write(0xFF01, 0x00);  // SB
-    memory.write(0xFF02, 0x7E);  // SC
-    
-    // Timer registers
-    memory.write(0xFF04, 0xAB);  // DIV - random value at boot
-    memory.write(0xFF05, 0x00);  // TIMA
-    memory.write(0xFF06, 0x00);  // TMA
-    memory.write(0xFF07, 0xF8);  // TAC
-    
-    // Interrupt flag
-    memory.write(0xFF0F, 0xE1);  // IF
-    
-    // Audio registers
-    memory.write(0xFF10, 0x80);  // NR10
-    memory.write(0xFF11, 0xBF);  // NR11
-    memory.write(0xFF12, 0xF3);  // NR12
-    memory.write(0xFF13, 0xFF);  // NR13
-    memory.write(0xFF14, 0xBF);  // NR14
-    memory.write(0xFF16, 0x3F);  // NR21
-    memory.write(0xFF17, 0x00);  // NR22
-    memory.write(0xFF18, 0xFF);  // NR23 
-    memory.write(0xFF19, 0xBF);  // NR24
-    memory.write(0xFF1A, 0x7F);  // NR30
-    memory.write(0xFF1B, 0xFF);  // NR31
-    memory.write(0xFF1C, 0x9F);  // NR32
-    memory.write(0xFF1D, 0xFF);  // NR33
-    memory.write(0xFF1E, 0xBF);  // NR34
-    memory.write(0xFF20, 0xFF);  // NR41
-    memory.write(0xFF21, 0x00);  // NR42
-    memory.write(0xFF22, 0x00);  // NR43
-    memory.write(0xFF23, 0xBF);  // NR44
-    memory.write(0xFF24, 0x77);  // NR50
-    memory.write(0xFF25, 0xF3);  // NR51
-    memory.write(0xFF26, 0xF1);  // NR52
-    
-    // LCD registers
-    memory.write(0xFF40, 0x91);  // LCDC
-    memory.write(0xFF41, 0x85);  // STAT
-    memory.write(0xFF42, 0x00);  // SCY
-    memory.write(0xFF43, 0x00);  // SCX
-    memory.write(0xFF44, 0x00);  // LY
-    memory.write(0xFF45, 0x00);  // LYC
-    memory.write(0xFF47, 0xFC);  // BGP
-    memory.write(0xFF48, 0xFF);  // OBP0
-    memory.write(0xFF49, 0xFF);  // OBP1
-    memory.write(0xFF4A, 0x00);  // WY
-    memory.write(0xFF4B, 0x00);  // WX
-    
-    // Ensure DMA is properly initialized
-    memory.write(0xFF46, 0xFF);
-    
-    // Interrupt Enable
-    memory.write(0xFFFF, 0x00);
-    
-    // Reset CPU to correct boot state
-    cpu.reset();
-    
-    // Reset GPU state
-    gpu.reset();
-    
-    // Special setup for Tetris
-    if (cart.getTitle().find("TETRIS") != std::string::npos) {
-        // Tetris expects a RET instruction at 0xFFB6 for compatibility
-        memory.write(0xFFB6, 0xC9);
-        std::cout << "Initialized address 0xFFB6 with RET instruction (0xC9) for Tetris compatibility" << std::endl;
+// Open the default audio device. Failing to is not fatal: the game runs silent
+bool init_audio() {
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+        std::cerr << "SDL audio initialization failed: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    
+    // About 85 ms of queue, drained in 512-frame (~11 ms) blocks
+    audio_ring = new AudioRing(4096);
+    
+    SDL_AudioSpec wanted;
+    SDL_zero(wanted);
+    wanted.freq = APU::SAMPLE_RATE;
+    wanted.format = AUDIO_S16SYS;
+    wanted.channels = 2;
+    wanted.samples = 512;
+    wanted.callback = audio_callback;
+    
+    // SDL converts if the device wants something else
+    SDL_AudioSpec obtained;
+    audio_device = SDL_OpenAudioDevice(nullptr, 0, &wanted, &obtained, 0);
+    if (audio_device == 0) {
+        std::cerr << "Audio device could not be opened: " << SDL_GetError() << std::endl;
+        delete audio_ring;
+        audio_ring = nullptr;
+        return false;
     }
+    
+    SDL_PauseAudioDevice(audio_device, 0);
+    return true;
 }
 
-bool init_system(const char* rom_path) {
-    try {
-        // Create and load cartridge
-        cart = new Cartridge(rom_path);
-        
-        // Create timer
-        timer = new Timer(*memory);
+void cleanup_sdl() {
+    if (audio_device) {
+        SDL_CloseAudioDevice(audio_device);
+    }
+    // The presenter destroys the renderer on its way out
+    if (presenter_thread.joinable()) {
+        presenter_running = false;
+        presenter_thread.join();
+    }
+    delete frame_buffer;
+    frame_buffer = nullptr;
+    if (window) {
+        SDL_DestroyWindow(window);
+    }
+    SDL_Quit();
+}
+#endif
 
-        // Initialize memory and CPU
-        memory = new MemoryBus(*cart, *timer);
-        std::cout << "Memory bus initialized" << std::endl;
-        
-        // Set the memory reference in timer (fix circular dependency)
-        delete timer;
-        timer = new Timer(*memory);
+bool init_system(const EmulatorOptions& options) {
+    try {
+        // Build the machine, already in its post-boot state
+        emulator = new Emulator(options.rom_path);
+        cart = &emulator->getCartridge();
+        memory = &emulator->getMemory();
+        cpu = &emulator->getCPU();
+        gpu = &emulator->getGPU();
+        timer = &emulator->getTimer();
+        scheduler = &emulator->getScheduler();
+        savestate = &emulator->getSaveState();
+        GB_LOG_INFO(LOG_SYSTEM, "System initialized");
         
-        // Initialize the GPU
-        gpu = new GPU(*memory);
-        std::cout << "GPU initialized" << std::endl;
+        gpu->setRendererMode(options.renderer);
         
-        // Connect the GPU back to memory bus for VRAM sharing
-        memory->setGPU(gpu);
-        std::cout << "GPU connected to memory bus" << std::endl;
+#ifdef GB_HAVE_SDL
+        // Open the window unless we're running headless
+        if (!options.headless && !init_sdl()) {
+            return false;
+        }
+        if (!options.headless && !options.mute) {
+            init_audio();
+        }
+#endif
         
-        // Initialize the CPU
-        cpu = new CPU(*memory);
-        std::cout << "CPU initialized" << std::endl;
+        if (options.wav_path) {
+            wav_writer = new WavWriter();
+            if (!wav_writer->open(options.wav_path, APU::SAMPLE_RATE)) {
+                return false;
+            }
+        }
         
-        // Disable CPU debug output
-        cpu->debug_output_enabled = false;
+        // Samples go to whichever outputs are open. Fast-forwarded audio would
+        // only fill the device queue, so turbo skips it (the WAV gets everything)
+        if (audio_ring || wav_writer) {
+            emulator->getAPU().setSampleCallback([](const int16_t* samples, size_t frames) {
+                if (audio_ring && !ctx.turbo) {
+                    audio_ring->push(samples, frames);
+                }
+                if (wav_writer) {
+                    wav_writer->write(samples, frames);
+                }
+            });
+        }
         
-        // Register GPU interrupt callbacks
-        gpu->setVBlankInterruptCallback(request_vblank_interrupt);
-        gpu->setLCDStatInterruptCallback(request_lcd_stat_interrupt);
+        savestate_path = options.rom_path;
+        size_t dot_pos = savestate_path.find_last_of('.');
+        if (dot_pos != std::string::npos) {
+            savestate_path = savestate_path.substr(0, dot_pos);
+        }
+        savestate_path += ".state";
         
-        // Initialize SDL
-        if (!init_sdl()) {
-            return false;
+        if (options.rewind_mb > 0) {
+            rewind_buffer = new RewindBuffer(*savestate, options.rewind_mb << 20);
         }
         
-        // Special handling for Tetris
-        if (cart->getTitle() == "TETRIS") {
-            std::cout << "Tetris ROM detected - enabling special debug checks" << std::endl;
-            // Enable any specific debug flags for Tetris
-            
-            // Force specific LCD settings known to work with Tetris
-            memory->write(0xFF40, 0x91); // LCD Control (enable LCD and background)
-            memory->write(0xFF47, 0xFC); // Background palette (white, light gray, dark gray, black)
+        if (options.run_ahead > 0) {
+            run_ahead = new RunAhead(*emulator, options.run_ahead);
         }
         
-        // Initialize system to post-boot ROM state
-        initializeSystem(*cpu, *gpu, *memory, *cart);
+        // A recording starts from the machine as it is now; a movie being
+        // played replaces it with the movie's own initial state
+        if (options.record_path || options.play_path) {
+            movie = new Movie(*savestate, *cart);
+            if (options.record_path) {
+                movie->startRecording();
+            } else if (!movie->startPlayback(options.play_path)) {
+                return false;
+            }
+        }
         
         return true;
     } catch (const std::exception& e) {
@@ -278,12 +372,17 @@ bool init_system(const char* rom_path) {
 }
 
 void cleanup_system() {
-    cleanup_sdl();
-    delete gpu;
-    delete cpu;
-    delete timer;
-    delete memory;
-    delete cart;
+#ifdef GB_HAVE_SDL
+    if (window) {
+        cleanup_sdl();
+    }
+#endif
+    delete movie;
+    delete run_ahead;
+    delete rewind_buffer;
+    delete emulator;
+    delete wav_writer;
+    delete audio_ring;
 }
 
 // Utility function to generate a code execution map
@@ -324,7 +423,7 @@ void dump_execution_trace(const std::string& filename) {
     std::cout << "Execution trace written to " << filename << std::endl;
 }
 
-bool cpu_step() {
+bool cpu_step(uint8_t& cycles_used) {
     try {
         if (tracing_enabled) {
             uint16_t pc = cpu->getPC();
@@ -344,7 +443,7 @@ bool cpu_step() {
             }
         }
         
-        cpu->tick();
+        cycles_used = cpu->step();
         return true;
     } catch (const std::exception& e) {
         std::cerr << "CPU error: " << e.what() << std::endl;
@@ -352,79 +451,46 @@ bool cpu_step() {
     }
 }
 
-// Update screen with current GPU buffer
+#ifdef GB_HAVE_SDL
+// Hand the GPU's finished frame to the presenter thread. Only a copy into
+// the triple buffer: drawing and vsync happen on the presenter
 void update_display() {
-    const auto& buffer = gpu->getScreenBuffer();
+    // With run-ahead the screen shown is the one from the frames run ahead
+    // (turbo and rewind don't run ahead)
+    bool ahead = run_ahead && !ctx.turbo && !ctx.rewinding;
+    const auto& buffer = ahead ? run_ahead->getScreen() : gpu->getScreenBuffer();
     
+#if GB_LOG_LEVEL >= GB_LOG_LEVEL_DEBUG
     // Debug info
     static int frame_count = 0;
     frame_count++;
     
-    // Dump VRAM debug information at specific frame numbers
-    if (frame_count == 50 || frame_count == 100 || frame_count == 200) {
-        std::cout << "Dumping VRAM debug info at frame " << frame_count << std::endl;
-        gpu->dumpVRAMDebug();
-    }
-    
-    // Every 10 frames, log what's in the first few pixels
-    if (frame_count % 10 == 0) {
-        std::cout << "UPDATE DISPLAY - Frame " << frame_count << std::endl;
-        std::cout << "First 4 pixels in display buffer (full 32-bit hex): ";
-        for (int i = 0; i < 4 && i < buffer.size(); i++) {
-            std::cout << std::hex << "0x" << std::setw(8) << std::setfill('0') 
-                      << buffer[i] << " ";
+    if (logEnabled(LOG_SYSTEM)) {
+        // Dump VRAM debug information at specific frame numbers
+        if (frame_count == 50 || frame_count == 100 || frame_count == 200) {
+            std::cout << "Dumping VRAM debug info at frame " << frame_count << std::endl;
+            gpu->dumpVRAMDebug();
         }
-        std::cout << std::dec << std::endl;
-        std::cout << "Buffer size: " << buffer.size() << " pixels" << std::endl;
-    }
-    
-    // Copy the GPU buffer directly to our display buffer
-    static std::vector<uint32_t> display_buffer(SCREEN_WIDTH * SCREEN_HEIGHT, 0);
-    std::copy(buffer.begin(), buffer.end(), display_buffer.begin());
-    
-    // Add a small debug indicator in the corner (just 8x8 pixels)
-    // This helps us know if the display is updating without interfering with game rendering
-    for (int y = 0; y < 8; y++) {
-        for (int x = 0; x < 8; x++) {
-            display_buffer[y * SCREEN_WIDTH + x] = 0xFFFF00FF; // Magenta corner marker
+        
+        // Every 10 frames, log what's in the first few pixels
+        if (frame_count % 10 == 0) {
+            std::cout << "UPDATE DISPLAY - Frame " << frame_count << std::endl;
+            std::cout << "First 4 pixels in display buffer (full 32-bit hex): ";
+            for (size_t i = 0; i < 4 && i < buffer.size(); i++) {
+                std::cout << std::hex << "0x" << std::setw(8) << std::setfill('0') 
+                          << buffer[i] << " ";
+            }
+            std::cout << std::dec << std::endl;
+            std::cout << "Buffer size: " << buffer.size() << " pixels" << std::endl;
         }
     }
+#endif
     
-    if (frame_count % 10 == 0) {
-        std::cout << "Using GPU buffer with corner marker for display" << std::endl;
-    }
-    
-    // Update SDL texture
-    void* pixels;
-    int pitch;
-    
-    if (SDL_LockTexture(screen_texture, nullptr, &pixels, &pitch) != 0) {
-        std::cerr << "Failed to lock texture: " << SDL_GetError() << std::endl;
-        return;
-    }
-    
-    // Copy our buffer to the texture
-    std::memcpy(pixels, display_buffer.data(), SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint32_t));
-    
-    // Unlock texture
-    SDL_UnlockTexture(screen_texture);
-    
-    // Clear renderer
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); // Black
-    SDL_RenderClear(renderer);
-    
-    // Draw scaled texture to fill window
-    SDL_Rect dest_rect = {0, 0, SCREEN_WIDTH * 4, SCREEN_HEIGHT * 4};
-    SDL_RenderCopy(renderer, screen_texture, NULL, &dest_rect);
-    
-    // Present the renderer
-    SDL_RenderPresent(renderer);
-    
-    if (frame_count % 10 == 0) {
-        std::cout << "Rendered frame " << frame_count << " to screen" << std::endl;
-    }
+    frame_buffer->publish(buffer.data());
 }
 
+#endif
+
 // Replace the complex update_timer function with this simplified version
 void update_timer(uint64_t cycles, MemoryBus& memory) {
     if (timer) {
@@ -432,32 +498,28 @@ void update_timer(uint64_t cycles, MemoryBus& memory) {
     }
 }
 
-// And update the system_tick function to use it properly
-bool system_tick(uint64_t cycles) {
-    static uint64_t total_ticks = 0;
-    total_ticks++;
-    
-    // Debug output every million ticks
-    if (total_ticks % 1000000 == 0) {
-        std::cout << "System tick: " << total_ticks 
-                  << ", total CPU cycles: " << cpu->getCycles()
-                  << std::endl;
-    }
-    
-    // Execute one CPU cycle
-    if (!cpu_step()) {
-        return false;
+// Run the machine until target_cycle. With tracing on, the CPU is stepped one
+// instruction at a time (still stopping at every scheduled event) so every PC
+// gets recorded
+bool system_run_until(uint64_t target_cycle) {
+    if (!tracing_enabled) {
+        return emulator->runUntil(target_cycle);
     }
     
-    // Update GPU with the elapsed CPU cycles
-    if (gpu) {
-        gpu->tick(cycles);
-    }
-    
-    // Update timer with the elapsed CPU cycles
-    if (timer) {
-        timer->tick(cycles);
+    while (cpu->getCycles() < target_cycle) {
+        // The next event is looked up again after every instruction: a timer
+        // register write can move it earlier
+        while (cpu->getCycles() < std::min(target_cycle, scheduler->nextEventTime())) {
+            uint8_t cycles_used = 0;
+            if (!cpu_step(cycles_used)) {
+                return false;
+            }
+        }
+        
+        // Service every event that has become due
+        scheduler->dispatchDue();
     }
+    emulator->getAPU().endFrame(cpu->getCycles());
     
     return true;
 }
@@ -517,7 +579,7 @@ void update_joypad_state() {
         uint8_t if_value = memory->read(IF_REG);
         memory->write(IF_REG, if_value | INT_JOYPAD);
         
-        std::cout << "Joypad interrupt requested" << std::endl;
+        GB_LOG_DEBUG(LOG_SYSTEM, "Joypad interrupt requested");
     }
     
     // Update the joypad register
@@ -525,6 +587,7 @@ void update_joypad_state() {
     last_state = joypad_state;
 }
 
+#ifdef GB_HAVE_SDL
 // Function to handle SDL key events and map them to Game Boy buttons
 void handle_key_event(SDL_KeyboardEvent& key, bool pressed) {
     // Handle Game Boy buttons
@@ -547,13 +610,8 @@ void handle_key_event(SDL_KeyboardEvent& key, bool pressed) {
     // Update joypad state whenever a Game Boy button changes
     update_joypad_state();
     
-    if (pressed) {
-        std::cout << "Key pressed: ";
-    } else {
-        std::cout << "Key released: ";
-    }
-    
-    std::cout << SDL_GetKeyName(key.keysym.sym) << std::endl;
+    GB_LOG_DEBUG(LOG_SYSTEM, (pressed ? "Key pressed: " : "Key released: ")
+                 << SDL_GetKeyName(key.keysym.sym));
 }
 
 void handleInput(SDL_Event& event) {
@@ -577,189 +635,383 @@ void handleInput(SDL_Event& event) {
             default: return;
         }
         
-        // Update the button state in memory
-        memory->updateJoypadButton(mask, pressed);
+        // Latched into the joypad at the next frame boundary
+        if (pressed) {
+            live_buttons |= mask;
+        } else {
+            live_buttons &= ~mask;
+        }
         
         // Debug output
-        if (pressed) {
-            std::cout << "Button pressed: ";
+        GB_LOG_DEBUG(LOG_SYSTEM, (pressed ? "Button pressed: " : "Button released: ")
+                     << SDL_GetKeyName(event.key.keysym.sym));
+    }
+}
+
+// Process pending window events. Returns false once the user asked to quit.
+// Loading a state moves next_frame_cycle to the loaded CPU cycle count
+bool handle_sdl_events(uint64_t total_frames, uint64_t& next_frame_cycle) {
+    SDL_Event event;
+    while (SDL_PollEvent(&event)) {
+        if (event.type == SDL_QUIT) {
+            return false;
+        } else if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) {
+            if (event.key.keysym.sym == SDLK_ESCAPE) {
+                return false;
+            } else if (event.key.keysym.sym == SDLK_SPACE && event.type == SDL_KEYDOWN) {
+                ctx.paused = !ctx.paused;
+                std::cout << (ctx.paused ? "Emulation paused" : "Emulation resumed") << std::endl;
+            } else if (event.key.keysym.sym == SDLK_TAB && event.type == SDL_KEYDOWN) {
+                // Toggle fast-forward
+                ctx.turbo = !ctx.turbo;
+                std::cout << (ctx.turbo ? "Turbo on" : "Turbo off") << std::endl;
+            } else if (event.key.keysym.sym == SDLK_F5 && event.type == SDL_KEYDOWN) {
+                if (savestate->saveToFile(savestate_path)) {
+                    std::cout << "State saved to " << savestate_path << std::endl;
+                }
+            } else if (event.key.keysym.sym == SDLK_F8 && event.type == SDL_KEYDOWN) {
+                if (movie && (movie->isRecording() || movie->isPlaying())) {
+                    // The movie would no longer match what's on screen
+                    std::cout << "Can't load a state while a movie is recording or playing" << std::endl;
+                } else if (savestate->loadFromFile(savestate_path)) {
+                    std::cout << "State loaded from " << savestate_path << std::endl;
+                    
+                    // The loaded cycle count becomes the new frame start, as
+                    // after a rewind step
+                    next_frame_cycle = cpu->getCycles();
+                    
+                    // History from before the load no longer leads here
+                    if (rewind_buffer) {
+                        rewind_buffer->clear();
+                    }
+                }
+            } else if (event.key.keysym.sym == SDLK_BACKSPACE) {
+                // Rewind while held
+                ctx.rewinding = rewind_buffer != nullptr && event.type == SDL_KEYDOWN &&
+                                !(movie && (movie->isRecording() || movie->isPlaying()));
+            } else if (event.key.keysym.sym == SDLK_d && event.type == SDL_KEYDOWN) {
+                // Dump VRAM to file
+                std::string filename = "vram_dump_" + std::to_string(total_frames) + ".txt";
+                std::cout << "Dumping VRAM to " << filename << std::endl;
+                gpu->dumpVRAM(filename);
+            } else {
+                // Handle Game Boy button presses
+                handleInput(event);
+            }
+        }
+    }
+    
+    return true;
+}
+#endif
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <rom_file>" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --headless    Run without a window (no SDL)" << std::endl;
+    std::cerr << "  --frames=N    Stop after N frames" << std::endl;
+    std::cerr << "  --turbo       Run as fast as possible (Tab toggles it at runtime)" << std::endl;
+    std::cerr << "  --speed=N     Run at N times normal speed (e.g. 2, 0.5)" << std::endl;
+    std::cerr << "  --rewind=MB   Keep up to MB megabytes of rewind history (hold Backspace)" << std::endl;
+    std::cerr << "  --renderer=R  Line renderer: scanline (default) or fifo" << std::endl;
+    std::cerr << "  --record=PATH Record joypad input to a movie file, written on exit" << std::endl;
+    std::cerr << "  --play=PATH   Replay a movie file (headless runs stop at its end)" << std::endl;
+    std::cerr << "  --wav=PATH    Write the sound output to a WAV file" << std::endl;
+    std::cerr << "  --mute        Don't play sound (--wav= still records it)" << std::endl;
+    std::cerr << "  --run-ahead=N Show the screen N frames ahead to hide the game's input lag" << std::endl;
+    std::cerr << "  --log=LIST    Log categories: cpu,memory,gpu,timer,cart,system,all,none" << std::endl;
+}
+
+// Parse the command line. Returns false on a bad argument or missing ROM path
+bool parse_options(int argc, char** argv, EmulatorOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        
+        if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg.rfind("--frames=", 0) == 0) {
+            try {
+                options.max_frames = std::stoull(arg.substr(9));
+            } catch (const std::exception&) {
+                std::cerr << "Invalid frame count: " << arg << std::endl;
+                return false;
+            }
+        } else if (arg.rfind("--log=", 0) == 0) {
+            uint32_t mask = 0;
+            if (!parseLogCategories(arg.substr(6), mask)) {
+                std::cerr << "Unknown log category in: " << arg << std::endl;
+                return false;
+            }
+            setLogMask(mask);
+        } else if (arg == "--turbo") {
+            options.turbo = true;
+        } else if (arg.rfind("--speed=", 0) == 0) {
+            try {
+                options.speed = std::stod(arg.substr(8));
+            } catch (const std::exception&) {
+                options.speed = 0.0;
+            }
+            if (!(options.speed > 0.0)) {
+                std::cerr << "Invalid speed: " << arg << std::endl;
+                return false;
+            }
+        } else if (arg.rfind("--rewind=", 0) == 0) {
+            try {
+                options.rewind_mb = std::stoul(arg.substr(9));
+            } catch (const std::exception&) {
+                std::cerr << "Invalid rewind budget: " << arg << std::endl;
+                return false;
+            }
+        } else if (arg.rfind("--renderer=", 0) == 0) {
+            std::string name = arg.substr(11);
+            if (name == "scanline") {
+                options.renderer = RendererMode::SCANLINE;
+            } else if (name == "fifo") {
+                options.renderer = RendererMode::FIFO;
+            } else {
+                std::cerr << "Unknown renderer: " << arg << std::endl;
+                return false;
+            }
+        } else if (arg.rfind("--record=", 0) == 0) {
+            options.record_path = argv[i] + 9;
+        } else if (arg.rfind("--play=", 0) == 0) {
+            options.play_path = argv[i] + 7;
+        } else if (arg.rfind("--wav=", 0) == 0) {
+            options.wav_path = argv[i] + 6;
+        } else if (arg == "--mute") {
+            options.mute = true;
+        } else if (arg.rfind("--run-ahead=", 0) == 0) {
+            try {
+                options.run_ahead = std::stoi(arg.substr(12));
+            } catch (const std::exception&) {
+                options.run_ahead = -1;
+            }
+            if (options.run_ahead < 0 || options.run_ahead > 8) {
+                std::cerr << "Invalid run-ahead (0-8 frames): " << arg << std::endl;
+                return false;
+            }
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
         } else {
-            std::cout << "Button released: ";
+            options.rom_path = argv[i];
         }
-        std::cout << SDL_GetKeyName(event.key.keysym.sym) << std::endl;
     }
+    
+    if (options.record_path && options.play_path) {
+        std::cerr << "--record and --play can't be used together" << std::endl;
+        return false;
+    }
+    
+    return options.rom_path != nullptr;
 }
 
 int emu_run(int argc, char** argv) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <rom_file>" << std::endl;
+    EmulatorOptions options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage(argv[0]);
         return -1;
     }
 
-    if (!init_system(argv[1])) {
+#ifndef GB_HAVE_SDL
+    if (!options.headless) {
+        std::cout << "Built without SDL2 - running headless" << std::endl;
+        options.headless = true;
+    }
+#endif
+
+    if (!init_system(options)) {
         std::cerr << "Failed to initialize system" << std::endl;
         return -2;
     }
 
     // Define constants before using them
-    const uint64_t GB_CLOCK_SPEED = 4194304; // GameBoy CPU runs at ~4.19 MHz
-    const uint64_t CYCLES_PER_FRAME = GB_CLOCK_SPEED / 60; // ~69905 cycles per frame at 60 FPS
+    const uint64_t GB_CLOCK_SPEED = 4194304; // GameBoy CPU runs at ~4.19 MHz (~59.73 frames/s)
 
-    std::cout << "System initialized with ROM: " << argv[1] << std::endl;
-    std::cout << "CPU cycles per frame: " << GB_CLOCK_SPEED / 60 << std::endl;
-    std::cout << "Display: " << SCREEN_WIDTH << "x" << SCREEN_HEIGHT << std::endl;
+    std::cout << "System initialized with ROM: " << options.rom_path << std::endl;
+    std::cout << "CPU cycles per frame: " << CYCLES_PER_FRAME << std::endl;
+    std::cout << "Display: " << SCREEN_WIDTH << "x" << SCREEN_HEIGHT
+              << (options.headless ? " (headless)" : "") << std::endl;
 
     ctx.running = true;
     ctx.paused = false;
     ctx.ticks = 0;
-    
-    uint64_t frame_cycles = 0;
-    uint64_t last_time = SDL_GetTicks();
-    uint64_t frame_time = 0;
+    ctx.turbo = options.turbo;
+    ctx.rewinding = false;
+    
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point start_time = Clock::now();
+    
+    // Emulated frames are paced against a wall-clock deadline that advances by
+    // one (speed-scaled) frame period per frame. Presentation happens on its
+    // own thread; in turbo, frames are only published once per host refresh
+    // so the loop doesn't spend its time copying frames nobody will see
+    const std::chrono::duration<double> frame_period(
+        static_cast<double>(CYCLES_PER_FRAME) / GB_CLOCK_SPEED / options.speed);
+    Clock::time_point next_frame_deadline = start_time;
+#ifdef GB_HAVE_SDL
+    const auto present_interval = std::chrono::microseconds(1000000 / 60);
+    Clock::time_point last_present = start_time - present_interval;
+#endif
+    
+    uint64_t next_frame_cycle = cpu->getCycles();
     uint64_t total_frames = 0;
     
-    uint64_t last_automatic_vram_dump = 0;
-    bool already_dumped_vram = false;
-    std::cout << "Key Commands:" << std::endl;
-    std::cout << "  ESC - Quit" << std::endl;
-    std::cout << "  SPACE - Pause/Resume" << std::endl;
-    std::cout << "  D - Dump VRAM to file" << std::endl;
-    std::cout << "  T - Dump execution trace to file" << std::endl;
-    std::cout << "Game Controls:" << std::endl;
-    std::cout << "  Arrow Keys - D-pad" << std::endl;
-    std::cout << "  Enter - Start" << std::endl;
-    std::cout << "  Right Shift - Select" << std::endl;
-    std::cout << "  Z - B button" << std::endl;
-    std::cout << "  X - A button" << std::endl;
+    if (!options.headless) {
+        std::cout << "Key Commands:" << std::endl;
+        std::cout << "  ESC - Quit" << std::endl;
+        std::cout << "  SPACE - Pause/Resume" << std::endl;
+        std::cout << "  TAB - Toggle turbo" << std::endl;
+        std::cout << "  F5/F8 - Save/load state" << std::endl;
+        if (rewind_buffer) {
+            std::cout << "  BACKSPACE (hold) - Rewind" << std::endl;
+        }
+        std::cout << "  D - Dump VRAM to file" << std::endl;
+        std::cout << "Game Controls:" << std::endl;
+        std::cout << "  Arrow Keys - D-pad" << std::endl;
+        std::cout << "  Enter - Start" << std::endl;
+        std::cout << "  Right Shift - Select" << std::endl;
+        std::cout << "  Z - B button" << std::endl;
+        std::cout << "  X - A button" << std::endl;
+    }
+
+    // A headless replay without --frames runs exactly the movie
+    if (options.headless && options.max_frames == 0 && movie && movie->isPlaying()) {
+        options.max_frames = movie->frameCount();
+    }
 
     std::cout << "Starting emulation loop..." << std::endl;
     
-    SDL_Event event;
     while (ctx.running) {
+#ifdef GB_HAVE_SDL
         // Handle SDL events
-        while (SDL_PollEvent(&event)) {
-            if (event.type == SDL_QUIT) {
-                ctx.running = false;
-                break;
-            } else if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) {
-                if (event.key.keysym.sym == SDLK_ESCAPE) {
-                    ctx.running = false;
-                    break;
-                } else if (event.key.keysym.sym == SDLK_SPACE && event.type == SDL_KEYDOWN) {
-                    ctx.paused = !ctx.paused;
-                    std::cout << (ctx.paused ? "Emulation paused" : "Emulation resumed") << std::endl;
-                } else if (event.key.keysym.sym == SDLK_d && event.type == SDL_KEYDOWN) {
-                    // Dump VRAM to file
-                    std::string filename = "vram_dump_" + std::to_string(total_frames) + ".txt";
-                    std::cout << "Dumping VRAM to " << filename << std::endl;
-                    gpu->dumpVRAM(filename);
-                } else if (event.key.keysym.sym == SDLK_t && event.type == SDL_KEYDOWN) {
-                    // Toggle between debug pattern and game rendering
-                    static bool debug_pattern_enabled = false;
-                    debug_pattern_enabled = !debug_pattern_enabled;
-                    std::cout << "Debug pattern " << (debug_pattern_enabled ? "enabled" : "disabled") << std::endl;
-                    
-                    // Set the flag that update_display() checks
-                    use_debug_pattern = debug_pattern_enabled;
-                    use_alternating_pattern = false;  // Stop auto-toggling when manually toggled
-                } else {
-                    // Handle Game Boy button presses
-                    handleInput(event);
-                }
-            }
+        if (!options.headless && !handle_sdl_events(total_frames, next_frame_cycle)) {
+            ctx.running = false;
+            break;
         }
+#endif
 
         if (ctx.paused) {
-            SDL_Delay(10);
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            next_frame_deadline = Clock::now();
             continue;
         }
 
-        // Get current time
-        uint64_t current_time = SDL_GetTicks();
-        frame_time += current_time - last_time;
-        last_time = current_time;
-        
-        // Run CPU cycles for one frame
-        while (frame_cycles < CYCLES_PER_FRAME && ctx.running && !ctx.paused) {
-            if (!system_tick(1)) {  // Pass 1 cycle to the system
+        if (ctx.rewinding) {
+            // Step back one recorded frame instead of running one. The
+            // restored CPU cycle count becomes the new frame start
+            rewind_buffer->stepBack();
+            next_frame_cycle = cpu->getCycles();
+        } else {
+            // Latch this frame's input: the keyboard, or the movie when one is playing
+            uint8_t frame_buttons = live_buttons;
+            if (movie) {
+                bool was_playing = movie->isPlaying();
+                frame_buttons = movie->nextFrame(live_buttons);
+                if (was_playing && !movie->isPlaying()) {
+                    std::cout << "Movie finished after " << movie->frameCount() << " frames" << std::endl;
+                }
+            }
+            memory->setJoypadButtons(frame_buttons);
+            gpu->setFrameSkip(ctx.turbo ? TURBO_FRAME_SKIP : 0);
+            
+            // Run CPU instructions for one frame
+            next_frame_cycle += CYCLES_PER_FRAME;
+            if (!system_run_until(next_frame_cycle)) {
                 std::cerr << "CPU Stopped" << std::endl;
                 ctx.running = false;
-                break;
             }
             
-            frame_cycles++;
+            if (ctx.running && rewind_buffer) {
+                rewind_buffer->push();
+            }
+            
+            // Work out the screen a few frames on; the machine itself is
+            // left as the real frame left it. Pointless while fast-forwarding
+            if (ctx.running && run_ahead && !ctx.turbo && !run_ahead->run()) {
+                std::cerr << "Run-ahead turned off" << std::endl;
+                delete run_ahead;
+                run_ahead = nullptr;
+            }
         }
         
-        // Reset frame cycle counter
-        if (frame_cycles >= CYCLES_PER_FRAME) {
+        if (ctx.running) {
             total_frames++;
             
             // Debug output every 60 frames (about once per second)
             if (total_frames % 60 == 0) {
-                std::cout << "Running for " << total_frames << " frames, " 
-                          << "CPU cycles: " << cpu->getCycles() 
-                          << ", Time: " << SDL_GetTicks() / 1000.0 << "s" 
-                          << std::endl;
+                GB_LOG_DEBUG(LOG_SYSTEM, "Running for " << total_frames << " frames, " 
+                             << "CPU cycles: " << cpu->getCycles() 
+                             << ", Time: " << std::chrono::duration<double>(Clock::now() - start_time).count() << "s");
             }
             
-            // Automatically dump VRAM at specific milestones
-            if (!already_dumped_vram && total_frames == 60) {  // After ~1 second
-                std::string filename = "vram_dump_initial.txt";
-                std::cout << "Automatically dumping initial VRAM to " << filename << std::endl;
-                gpu->dumpVRAM(filename);
-                already_dumped_vram = true;
-            }
-            
-            frame_cycles = 0;
-            
-            // Render screen
-            update_display();
-            
-            // Cap to 60 FPS
-            if (frame_time < 16) {
-                SDL_Delay(16 - frame_time);
+#ifdef GB_HAVE_SDL
+            if (!options.headless) {
+                // Automatically dump VRAM at specific milestones
+                static bool already_dumped_vram = false;
+                if (!already_dumped_vram && total_frames == 60) {  // After ~1 second
+                    std::string filename = "vram_dump_initial.txt";
+                    std::cout << "Automatically dumping initial VRAM to " << filename << std::endl;
+                    gpu->dumpVRAM(filename);
+                    already_dumped_vram = true;
+                }
+                
+                // Publish the frame for the presenter
+                Clock::time_point now = Clock::now();
+                if (!ctx.turbo || now - last_present >= present_interval) {
+                    update_display();
+                    last_present = now;
+                }
             }
-            frame_time = 0;
+#endif
 
-            if (cart->getTitle() == "TETRIS" && total_frames % 120 == 0) {
-                // Periodically press buttons to make sure game advances
-                static int button_sequence = 0;
-                
-                std::cout << "Tetris helper: Pressing button sequence " << button_sequence << std::endl;
-                
-                switch (button_sequence) {
-                    case 0: // Press START to advance past title
-                        memory->updateJoypadButton(0x10, true);  // Press START
-                        SDL_Delay(50);
-                        memory->updateJoypadButton(0x10, false); // Release START
-                        break;
-                        
-                    case 1: // Press A to advance past menu
-                        memory->updateJoypadButton(0x80, true);  // Press A
-                        SDL_Delay(50);
-                        memory->updateJoypadButton(0x80, false); // Release A
-                        break;
-                        
-                    case 2: // Press START again to start game
-                        memory->updateJoypadButton(0x10, true);  // Press START
-                        SDL_Delay(50); 
-                        memory->updateJoypadButton(0x10, false); // Release START
-                        break;
-                        
-                    default:
-                        // No automatic button presses after game starts
-                        break;
+            // Pace emulation unless fast-forwarding. A headless run without
+            // an explicit --speed always runs flat out
+            bool paced = !ctx.turbo && (!options.headless || options.speed != 1.0);
+            if (paced) {
+                next_frame_deadline += std::chrono::duration_cast<Clock::duration>(frame_period);
+                Clock::time_point now = Clock::now();
+                if (next_frame_deadline > now) {
+                    std::this_thread::sleep_until(next_frame_deadline);
+                } else if (now - next_frame_deadline > std::chrono::milliseconds(100)) {
+                    // Too far behind (slow host, or we were just in turbo) - don't try to catch up
+                    next_frame_deadline = now;
                 }
-                
-                button_sequence = (button_sequence + 1) % 4;
+            } else {
+                next_frame_deadline = Clock::now();
+            }
+
+            if (options.max_frames != 0 && total_frames >= options.max_frames) {
+                ctx.running = false;
             }
         }
         
         ctx.ticks++;
     }
 
+    std::chrono::duration<double> elapsed = Clock::now() - start_time;
     std::cout << "Emulation stopped after " << total_frames << " frames" << std::endl;
     std::cout << "Total CPU cycles: " << cpu->getCycles() << std::endl;
+    if (elapsed.count() > 0) {
+        std::cout << "Elapsed: " << elapsed.count() << "s ("
+                  << total_frames / elapsed.count() << " frames/s)" << std::endl;
+    }
+    
+    if (run_ahead && run_ahead->getRuns() > 0) {
+        std::cout << "Run-ahead " << run_ahead->getFrames() << ": snapshot "
+                  << run_ahead->averageSnapshotMicros() << " us, restore "
+                  << run_ahead->averageRestoreMicros() << " us, frames ahead "
+                  << run_ahead->averageAheadMicros() << " us per frame ("
+                  << run_ahead->stateSize() << " byte state)" << std::endl;
+    }
+    
+    if (rewind_buffer && rewind_buffer->droppedFrames() > 0) {
+        std::cout << "Rewind: " << rewind_buffer->droppedFrames() << " frames could not be recorded" << std::endl;
+    }
+    
+    if (movie && movie->isRecording() && movie->saveToFile(options.record_path)) {
+        std::cout << "Recorded " << movie->frameCount() << " frames to " << options.record_path << std::endl;
+    }
     
     // Ensure execution trace is saved
     if (tracing_enabled) {
@@ -1,6 +1,11 @@
 #include "memory.hpp"
 #include "timer.hpp"
+#include "serial.hpp"
+#include "apu.hpp"
 #include "gpu.hpp"
+#include "scheduler.hpp"
+#include "log.hpp"
+#include "savestate.hpp"
 #include <iostream>
 #include <iomanip>
 
@@ -47,6 +52,7 @@ constexpr uint16_t NR44_REGISTER = 0xFF23;  // Sound channel 4 counter/consecuti
 constexpr uint16_t NR50_REGISTER = 0xFF24;  // Sound control: SO1 volume and Vin->SO1 enable
 constexpr uint16_t NR51_REGISTER = 0xFF25;  // Sound control: Selection of sound output terminal
 constexpr uint16_t NR52_REGISTER = 0xFF26;  // Sound control: Sound on/off
+constexpr uint16_t WAVE_RAM_END = 0xFF3F;   // Wave pattern RAM is 0xFF30-0xFF3F
 
 // LCD registers
 constexpr uint16_t LCDC_REG = 0xFF40;  // LCD Control
@@ -69,7 +75,7 @@ constexpr uint16_t HRAM_END = 0xFFFE;
 // Interrupt Enable register
 constexpr uint16_t IE_REGISTER = 0xFFFF;
 
-MemoryBus::MemoryBus(Cartridge& cart, Timer& timer) : cartridge(cart), timer(timer), gpu(nullptr), ie_register(0), joypad_state(0xFF), joypad_select(0xF0) {
+MemoryBus::MemoryBus(Cartridge& cart) : vram{}, ie_register(0), tile_cache(vram.data()), cartridge(cart), timer(nullptr), gpu(nullptr), scheduler(nullptr), joypad_state(0xFF), joypad_select(0xF0) {
     // Initialize all memory regions to 0
     vram.fill(0);
     wram.fill(0);
@@ -104,10 +110,52 @@ MemoryBus::MemoryBus(Cartridge& cart, Timer& timer) : cartridge(cart), timer(tim
     
     // Initialize counters for debugging
     vram_write_counter = 0;
-    write_counter = 0;
     
-    std::cout << "MemoryBus initialized" << std::endl;
-    std::cout << "Initialized address 0xFFB6 with RET instruction (0xC9) for Tetris compatibility" << std::endl;
+    // Build the page table
+    mapInternalMemory();
+    remapCartridge();
+    
+    GB_LOG_INFO(LOG_MEMORY, "MemoryBus initialized");
+    GB_LOG_INFO(LOG_MEMORY, "Initialized address 0xFFB6 with RET instruction (0xC9) for Tetris compatibility");
+}
+
+void MemoryBus::mapInternalMemory() {
+    read_pages.fill(nullptr);
+    write_pages.fill(nullptr);
+    
+    // VRAM (0x8000-0x9FFF): reads are direct, writes stay on the handler path
+    read_pages[0x8] = vram.data();
+    read_pages[0x9] = vram.data() + 0x1000;
+    
+    // WRAM (0xC000-0xDFFF)
+    for (int page = 0xC; page <= 0xD; page++) {
+        uint8_t* ptr = wram.data() + ((page - 0xC) << PAGE_SHIFT);
+        read_pages[page] = ptr;
+        write_pages[page] = ptr;
+    }
+    
+    // Echo RAM (0xE000-0xEFFF) mirrors the first WRAM page; 0xF000-0xFFFF
+    // mixes echo RAM, OAM, I/O and HRAM so it always uses the handlers
+    read_pages[0xE] = wram.data();
+    write_pages[0xE] = wram.data();
+}
+
+void MemoryBus::remapCartridge() {
+    // ROM is read-only; writes to it are MBC register writes and need the handler
+    const uint8_t* bank0 = cartridge.getRomBank0();
+    const uint8_t* bankN = cartridge.getRomBankN();
+    for (int i = 0; i < 4; i++) {
+        read_pages[i] = bank0 ? bank0 + (i << PAGE_SHIFT) : nullptr;
+        read_pages[4 + i] = bankN ? bankN + (i << PAGE_SHIFT) : nullptr;
+    }
+    
+    // External RAM (0xA000-0xBFFF)
+    uint8_t* ram_bank = cartridge.getRamBank();
+    for (int i = 0; i < 2; i++) {
+        uint8_t* ptr = ram_bank ? ram_bank + (i << PAGE_SHIFT) : nullptr;
+        read_pages[0xA + i] = ptr;
+        write_pages[0xA + i] = ptr;
+    }
 }
 
 void MemoryBus::setGPU(GPU* gpu_ptr) {
@@ -115,12 +163,16 @@ void MemoryBus::setGPU(GPU* gpu_ptr) {
     
     // Force the GPU to check VRAM data immediately
     if (gpu != nullptr) {
-        std::cout << "Forcing GPU to check VRAM data..." << std::endl;
+        GB_LOG_INFO(LOG_MEMORY, "Forcing GPU to check VRAM data...");
         gpu->forceVRAMCheck();
     }
 }
 
-uint8_t MemoryBus::read(uint16_t addr) const {
+void MemoryBus::setLY(uint8_t value) {
+    io_regs[LY_REGISTER - IO_REGISTERS_START] = value;
+}
+
+uint8_t MemoryBus::readSlow(uint16_t addr) const {
     // ROM bank 0 & switchable ROM bank (handled by cartridge)
     if (addr < 0x8000) {
         return cartridge.read(addr);
@@ -130,11 +182,8 @@ uint8_t MemoryBus::read(uint16_t addr) const {
         // Check if VRAM is accessible - it's only inaccessible during pixel transfer (Mode 3)
         if (gpu && gpu->getCurrentMode() == LCDMode::TRANSFER) {
             // Debug: Log the first 10 blocked VRAM reads
-            static int vram_read_blocked_count = 0;
-            if (vram_read_blocked_count < 10) {
-                std::cout << "VRAM read blocked (Mode 3) - addr: 0x" << std::hex << addr << std::dec << std::endl;
-                vram_read_blocked_count++;
-            }
+            GB_LOG_TRACE_FIRST(LOG_MEMORY, 10,
+                "VRAM read blocked (Mode 3) - addr: 0x" << std::hex << addr << std::dec);
             
             // IMPORTANT: For debugging - always allow VRAM access regardless of LCD mode
             // This bypass helps diagnose VRAM content issues
@@ -160,16 +209,18 @@ uint8_t MemoryBus::read(uint16_t addr) const {
     }
     // OAM
     else if (isInRange(addr, 0xFE00, 0xFE9F)) {
+        // OAM is owned by the DMA unit while a transfer is running
+        if (dma_active) {
+            return 0xFF;
+        }
+        
         // Check if OAM is accessible - it's inaccessible during OAM scan (Mode 2) and pixel transfer (Mode 3)
         if (gpu && (gpu->getCurrentMode() == LCDMode::OAM || 
                    gpu->getCurrentMode() == LCDMode::TRANSFER)) {
             // Debug: Log the first 10 blocked OAM reads
-            static int oam_read_blocked_count = 0;
-            if (oam_read_blocked_count < 10) {
-                std::cout << "OAM read blocked (Mode " << (gpu->getCurrentMode() == LCDMode::OAM ? "2" : "3") 
-                          << ") - addr: 0x" << std::hex << addr << std::dec << std::endl;
-                oam_read_blocked_count++;
-            }
+            GB_LOG_TRACE_FIRST(LOG_MEMORY, 10,
+                "OAM read blocked (Mode " << (gpu->getCurrentMode() == LCDMode::OAM ? "2" : "3") 
+                << ") - addr: 0x" << std::hex << addr << std::dec);
             
             // IMPORTANT: For debugging - allow OAM access regardless of LCD mode
             return oam[addr - 0xFE00];
@@ -188,7 +239,15 @@ uint8_t MemoryBus::read(uint16_t addr) const {
     else if (isInRange(addr, IO_REGISTERS_START, IO_REGISTERS_END)) {
         // Special handling for timer registers
         if (isInRange(addr, DIV_REGISTER, TAC_REGISTER)) {
-            return timer.readRegister(addr);
+            return timer ? timer->readRegister(addr) : 0xFF;
+        }
+        // Serial port registers
+        if ((addr == SB_REGISTER || addr == SC_REGISTER) && serial) {
+            return serial->readRegister(addr);
+        }
+        // Sound registers and wave RAM
+        if (isInRange(addr, NR10_REGISTER, WAVE_RAM_END) && apu) {
+            return apu->readRegister(addr);
         }
         // Handle joypad register (0xFF00)
         if (addr == P1_REGISTER) {
@@ -233,67 +292,63 @@ uint8_t MemoryBus::read(uint16_t addr) const {
     }
 }
 
-void MemoryBus::write(uint16_t addr, uint8_t value) {
-    write_counter++;
-    
+void MemoryBus::writeSlow(uint16_t addr, uint8_t value) {
     // ROM bank 0 & switchable ROM bank (handled by cartridge)
     if (addr < 0x8000) {
         cartridge.write(addr, value);
+        
+        // MBC register writes can switch banks or enable/disable RAM
+        remapCartridge();
     }
     // VRAM
     else if (isInRange(addr, 0x8000, 0x9FFF)) {
-        vram_write_counter++;
-        
         // Check if VRAM is accessible - it's only inaccessible during pixel transfer (Mode 3)
         if (gpu && gpu->getCurrentMode() == LCDMode::TRANSFER) {
             // DEBUGGING: Temporarily allow all VRAM writes even during Mode 3 to verify game data
             // Comment out the warning and allow the write to proceed
-            std::cout << "VRAM write during Mode 3 (allowed for debugging) - addr: 0x" << std::hex << addr 
-                      << ", value: 0x" << static_cast<int>(value) << std::dec << std::endl;
+            GB_LOG_TRACE(LOG_MEMORY, "VRAM write during Mode 3 (allowed for debugging) - addr: 0x" << std::hex << addr 
+                         << ", value: 0x" << static_cast<int>(value) << std::dec);
             
             // Allow the write to go through during debugging
             vram[addr - 0x8000] = value;
+            tile_cache.markDirty(addr - 0x8000);
             
             // Log more detailed information for the first 5 writes
-            static int detailed_vram_writes = 0;
-            if (detailed_vram_writes < 5) {
-                std::cout << "DETAILED VRAM WRITE: address 0x" << std::hex << addr 
-                          << " (offset 0x" << (addr - 0x8000) << ")" << std::endl;
-                std::cout << "  - Value: 0x" << static_cast<int>(value) << std::dec << std::endl;
-                std::cout << "  - Is tile data: " << (addr < 0x9800 ? "YES" : "NO") << std::endl;
-                std::cout << "  - Is tilemap: " << (addr >= 0x9800 ? "YES" : "NO") << std::endl;
-                detailed_vram_writes++;
-            }
+            GB_LOG_TRACE_FIRST(LOG_MEMORY, 5,
+                "DETAILED VRAM WRITE: address 0x" << std::hex << addr 
+                << " (offset 0x" << (addr - 0x8000) << ")\n"
+                << "  - Value: 0x" << static_cast<int>(value) << std::dec << "\n"
+                << "  - Is tile data: " << (addr < 0x9800 ? "YES" : "NO") << "\n"
+                << "  - Is tilemap: " << (addr >= 0x9800 ? "YES" : "NO"));
             
             // Normal behavior would be to return without writing
             //return;
         }
         
+#if GB_LOG_LEVEL >= GB_LOG_LEVEL_TRACE
+        vram_write_counter++;
+        
         // Debug: Log all VRAM writes to the background tiles memory (0x8000-0x97FF)
         if (addr >= 0x8000 && addr <= 0x97FF) {
-            std::cout << "VRAM TILE WRITE: addr=0x" << std::hex << addr 
-                      << ", value=0x" << static_cast<int>(value) << std::dec << std::endl;
+            GB_LOG_TRACE(LOG_MEMORY, "VRAM TILE WRITE: addr=0x" << std::hex << addr 
+                         << ", value=0x" << static_cast<int>(value) << std::dec);
         }
         
         // Debug: Log all VRAM writes to the background map (0x9800-0x9BFF)
         if (addr >= 0x9800 && addr <= 0x9BFF) {
-            std::cout << "VRAM MAP WRITE: addr=0x" << std::hex << addr 
-                      << ", value=0x" << static_cast<int>(value) << std::dec << std::endl;
-        }
-        
-        // Debug: Log first 100 VRAM writes
-        if (vram_write_counter <= 100) {
-            std::cout << "VRAM write #" << vram_write_counter << " - addr: 0x" << std::hex << addr 
-                      << ", value: 0x" << static_cast<int>(value) << std::dec << std::endl;
+            GB_LOG_TRACE(LOG_MEMORY, "VRAM MAP WRITE: addr=0x" << std::hex << addr 
+                         << ", value=0x" << static_cast<int>(value) << std::dec);
         }
         
-        // Log periodic writes to see if VRAM writes continue
-        if (vram_write_counter % 1000 == 0) {
-            std::cout << "VRAM write #" << vram_write_counter << " - addr: 0x" << std::hex << addr 
-                      << ", value: 0x" << static_cast<int>(value) << std::dec << std::endl;
+        // Debug: Log first 100 VRAM writes, then every 1000th to see if VRAM writes continue
+        if (vram_write_counter <= 100 || vram_write_counter % 1000 == 0) {
+            GB_LOG_TRACE(LOG_MEMORY, "VRAM write #" << vram_write_counter << " - addr: 0x" << std::hex << addr 
+                         << ", value: 0x" << static_cast<int>(value) << std::dec);
         }
+#endif
         
         vram[addr - 0x8000] = value;
+        tile_cache.markDirty(addr - 0x8000);
     }
     // External RAM (handled by cartridge)
     else if (isInRange(addr, 0xA000, 0xBFFF)) {
@@ -309,12 +364,17 @@ void MemoryBus::write(uint16_t addr, uint8_t value) {
     }
     // OAM
     else if (isInRange(addr, 0xFE00, 0xFE9F)) {
+        // CPU writes to OAM are dropped while a DMA transfer owns it
+        if (dma_active) {
+            return;
+        }
+        
         // Check if OAM is accessible - it's inaccessible during OAM scan (Mode 2) and pixel transfer (Mode 3)
         if (gpu && (gpu->getCurrentMode() == LCDMode::OAM || 
                    gpu->getCurrentMode() == LCDMode::TRANSFER)) {
             // DEBUGGING: Temporarily allow OAM writes during restricted modes
-            std::cout << "OAM write during restricted mode (allowed for debugging) - addr: 0x" << std::hex << addr 
-                      << ", value: 0x" << static_cast<int>(value) << std::dec << std::endl;
+            GB_LOG_TRACE(LOG_MEMORY, "OAM write during restricted mode (allowed for debugging) - addr: 0x" << std::hex << addr 
+                         << ", value: 0x" << static_cast<int>(value) << std::dec);
             
             // Allow the write to proceed
             oam[addr - 0xFE00] = value;
@@ -333,25 +393,29 @@ void MemoryBus::write(uint16_t addr, uint8_t value) {
     // I/O Registers
     else if (isInRange(addr, IO_REGISTERS_START, IO_REGISTERS_END)) {
         // Additional debug for important I/O registers
+#if GB_LOG_LEVEL >= GB_LOG_LEVEL_DEBUG
         if (addr == LCDC_REG) {
-            std::cout << "LCD Control write: 0x" << std::hex << static_cast<int>(value) << std::dec 
-                      << " (LCD " << ((value & 0x80) ? "ON" : "OFF") 
-                      << ", BG " << ((value & 0x01) ? "ON" : "OFF") 
-                      << ", Sprites " << ((value & 0x02) ? "ON" : "OFF") << ")" << std::endl;
+            GB_LOG_DEBUG(LOG_MEMORY, "LCD Control write: 0x" << std::hex << static_cast<int>(value) << std::dec 
+                         << " (LCD " << ((value & 0x80) ? "ON" : "OFF") 
+                         << ", BG " << ((value & 0x01) ? "ON" : "OFF") 
+                         << ", Sprites " << ((value & 0x02) ? "ON" : "OFF") << ")");
         }
         else if (addr == DMA_REG) {
-            std::cout << "DMA Transfer initiated from: 0x" << std::hex << (value * 0x100) << std::dec << std::endl;
+            GB_LOG_DEBUG(LOG_MEMORY, "DMA Transfer initiated from: 0x" << std::hex << (value * 0x100) << std::dec);
         }
         else if (addr == BGP_REG) {
-            std::cout << "Background Palette set: 0x" << std::hex << static_cast<int>(value) << std::dec << std::endl;
+            GB_LOG_DEBUG(LOG_MEMORY, "Background Palette set: 0x" << std::hex << static_cast<int>(value) << std::dec);
         }
         else if (addr == OBP0_REG || addr == OBP1_REG) {
-            std::cout << "Sprite Palette " << ((addr == OBP0_REG) ? "0" : "1") << " set: 0x" << std::hex << static_cast<int>(value) << std::dec << std::endl;
+            GB_LOG_DEBUG(LOG_MEMORY, "Sprite Palette " << ((addr == OBP0_REG) ? "0" : "1") << " set: 0x" << std::hex << static_cast<int>(value) << std::dec);
         }
+#endif
         
         // Special handling for timer registers
         if (isInRange(addr, DIV_REGISTER, TAC_REGISTER)) {
-            timer.writeRegister(addr, value);
+            if (timer) {
+                timer->writeRegister(addr, value);
+            }
             
             // Also store the value in our I/O registers array for consistency
             if (addr != DIV_REGISTER) { // DIV always reads as 0 after writing
@@ -362,6 +426,20 @@ void MemoryBus::write(uint16_t addr, uint8_t value) {
             return;
         }
         
+        // Serial port registers
+        if ((addr == SB_REGISTER || addr == SC_REGISTER) && serial) {
+            serial->writeRegister(addr, value);
+            io_regs[addr - IO_REGISTERS_START] = value;
+            return;
+        }
+        
+        // Sound registers and wave RAM
+        if (isInRange(addr, NR10_REGISTER, WAVE_RAM_END) && apu) {
+            apu->writeRegister(addr, value);
+            io_regs[addr - IO_REGISTERS_START] = value;
+            return;
+        }
+        
         // Handle joypad register (0xFF00)
         if (addr == P1_REGISTER) {
             // Only bits 4-5 are writable (select bits)
@@ -374,6 +452,12 @@ void MemoryBus::write(uint16_t addr, uint8_t value) {
         if (addr == DMA_REG) {
             performDMATransfer(value);
             io_regs[DMA_REG - IO_REGISTERS_START] = value;
+            
+            // The transfer takes 160 M-cycles (640 T-cycles) on hardware
+            if (scheduler) {
+                dma_active = true;
+                scheduler->scheduleIn(EventType::DMA_COMPLETE, 640);
+            }
             return;
         }
         
@@ -456,3 +540,45 @@ void MemoryBus::updateJoypadButton(uint8_t button_mask, bool pressed) {
         write(IF_REGISTER, if_value | INT_JOYPAD);
     }
 }
+
+void MemoryBus::setJoypadButtons(uint8_t held) {
+    uint8_t changed = static_cast<uint8_t>(~joypad_state) ^ held;
+    for (uint8_t mask = 0x01; changed != 0; mask <<= 1) {
+        if (changed & mask) {
+            updateJoypadButton(mask, (held & mask) != 0);
+            changed &= ~mask;
+        }
+    }
+}
+
+void MemoryBus::saveState(StateWriter& writer) const {
+    writer.beginChunk("MEM ");
+    writer.writeBytes(vram.data(), vram.size());
+    writer.writeBytes(wram.data(), wram.size());
+    writer.writeBytes(oam.data(), oam.size());
+    writer.writeBytes(io_regs.data(), io_regs.size());
+    writer.writeBytes(hram.data(), hram.size());
+    writer.write8(ie_register);
+    writer.writeBool(dma_active);
+    writer.write8(joypad_state);
+    writer.write8(joypad_select);
+    writer.endChunk();
+}
+
+void MemoryBus::loadState(StateReader& reader) {
+    if (!reader.openChunk("MEM ")) {
+        return;
+    }
+    reader.readBytes(vram.data(), vram.size());
+    reader.readBytes(wram.data(), wram.size());
+    reader.readBytes(oam.data(), oam.size());
+    reader.readBytes(io_regs.data(), io_regs.size());
+    reader.readBytes(hram.data(), hram.size());
+    ie_register = reader.read8();
+    dma_active = reader.readBool();
+    joypad_state = reader.read8();
+    joypad_select = reader.read8();
+    
+    // VRAM was replaced behind the tile cache's back
+    tile_cache.invalidateAll();
+}
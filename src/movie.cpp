@@ -0,0 +1,137 @@
+#include "movie.hpp"
+#include "savestate.hpp"
+#include "cartridge.hpp"
+#include "log.hpp"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+static const char MOVIE_MAGIC[4] = {'G', 'B', 'M', 'V'};
+
+// Header: magic, version, ROM hash (the same layout as a save state header)
+constexpr size_t MOVIE_HEADER_SIZE = 12;
+
+Movie::Movie(SaveState& state, const Cartridge& cart) : state(state), cart(cart) {
+}
+
+void Movie::startRecording() {
+    initial_state.resize(state.size());
+    state.snapshot(initial_state.data(), initial_state.size());
+    inputs.clear();
+    position = 0;
+    mode = Mode::RECORDING;
+}
+
+bool Movie::startPlayback(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to open movie: " << path << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    if (data.size() < MOVIE_HEADER_SIZE || std::memcmp(data.data(), MOVIE_MAGIC, sizeof(MOVIE_MAGIC)) != 0) {
+        std::cerr << "Not a movie: " << path << std::endl;
+        return false;
+    }
+
+    uint32_t version = static_cast<uint32_t>(data[4]) | (static_cast<uint32_t>(data[5]) << 8) |
+                       (static_cast<uint32_t>(data[6]) << 16) | (static_cast<uint32_t>(data[7]) << 24);
+    uint32_t rom_hash = static_cast<uint32_t>(data[8]) | (static_cast<uint32_t>(data[9]) << 8) |
+                        (static_cast<uint32_t>(data[10]) << 16) | (static_cast<uint32_t>(data[11]) << 24);
+
+    if (version > MOVIE_VERSION) {
+        std::cerr << "Movie version " << version << " is newer than supported ("
+                  << MOVIE_VERSION << ")" << std::endl;
+        return false;
+    }
+    if (rom_hash != cart.getROMHash()) {
+        std::cerr << "Movie was recorded on a different ROM" << std::endl;
+        return false;
+    }
+
+    StateReader reader(data.data(), data.size());
+    std::vector<uint8_t> init;
+    if (reader.openChunk("INIT")) {
+        init.resize(reader.remaining());
+        reader.readBytes(init.data(), init.size());
+    }
+    std::vector<uint8_t> frames;
+    if (reader.openChunk("INPT")) {
+        frames.resize(reader.remaining());
+        reader.readBytes(frames.data(), frames.size());
+    }
+    if (reader.failed()) {
+        std::cerr << "Movie is truncated or corrupt: " << path << std::endl;
+        return false;
+    }
+
+    // An empty initial state means the movie starts at power-on, which is
+    // where the machine already is
+    if (!init.empty() && !state.restore(init.data(), init.size())) {
+        return false;
+    }
+
+    initial_state = std::move(init);
+    inputs = std::move(frames);
+    position = 0;
+    mode = Mode::PLAYING;
+
+    GB_LOG_INFO(LOG_SYSTEM, "Playing movie: " << path << " (" << inputs.size() << " frames)");
+    return true;
+}
+
+bool Movie::saveToFile(const std::string& path) const {
+    auto write = [&](StateWriter& writer) {
+        writer.writeBytes(MOVIE_MAGIC, sizeof(MOVIE_MAGIC));
+        writer.write32(MOVIE_VERSION);
+        writer.write32(cart.getROMHash());
+
+        writer.beginChunk("INIT");
+        writer.writeBytes(initial_state.data(), initial_state.size());
+        writer.endChunk();
+
+        writer.beginChunk("INPT");
+        writer.writeBytes(inputs.data(), inputs.size());
+        writer.endChunk();
+
+        writer.beginChunk("END ");
+        writer.endChunk();
+    };
+
+    // Measure, then write
+    StateWriter measure(nullptr, 0);
+    write(measure);
+    std::vector<uint8_t> buffer(measure.size());
+    StateWriter writer(buffer.data(), buffer.size());
+    write(writer);
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file || writer.overflowed()) {
+        std::cerr << "Failed to write movie: " << path << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+
+    GB_LOG_INFO(LOG_SYSTEM, "Saved movie to: " << path << " (" << inputs.size() << " frames)");
+    return true;
+}
+
+uint8_t Movie::nextFrame(uint8_t live_buttons) {
+    switch (mode) {
+        case Mode::RECORDING:
+            inputs.push_back(live_buttons);
+            return live_buttons;
+
+        case Mode::PLAYING:
+            if (position < inputs.size()) {
+                return inputs[position++];
+            }
+            mode = Mode::IDLE;
+            return live_buttons;
+
+        default:
+            return live_buttons;
+    }
+}
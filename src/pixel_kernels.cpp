@@ -0,0 +1,171 @@
+#include "pixel_kernels.hpp"
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// The vector decoders work the same way at every width: a plane byte is
+// repeated across 8 lanes, each lane tests one bit (bit 7 in the leftmost
+// lane) and the compare result is turned into 1 (low plane) or 2 (high plane)
+
+// One plane byte repeated in every byte of a 64-bit value
+static inline uint64_t repeatByte(uint8_t value) {
+    return value * 0x0101010101010101ULL;
+}
+
+void decodeTileRowsScalar(const uint8_t* data, int rows, uint8_t* out) {
+    for (int row = 0; row < rows; row++) {
+        uint8_t low = data[row * 2];
+        uint8_t high = data[row * 2 + 1];
+        
+        for (int bit = 7; bit >= 0; bit--) {
+            *out++ = static_cast<uint8_t>((((high >> bit) & 0x01) << 1) | ((low >> bit) & 0x01));
+        }
+    }
+}
+
+void applyPaletteScalar(const uint8_t* indices, const uint32_t* colors, uint32_t* out, int count) {
+    for (int i = 0; i < count; i++) {
+        out[i] = colors[indices[i] & 0x03];
+    }
+}
+
+#if defined(__SSE2__)
+// Two rows (16 pixels) per iteration
+void decodeTileRowsSSE2(const uint8_t* data, int rows, uint8_t* out) {
+    // Bit tested by each lane, leftmost pixel = bit 7
+    const __m128i bits = _mm_set_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, static_cast<char>(0x80),
+                                      0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, static_cast<char>(0x80));
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i two = _mm_set1_epi8(2);
+    
+    int row = 0;
+    for (; row + 2 <= rows; row += 2) {
+        const uint8_t* src = data + row * 2;
+        __m128i low = _mm_set_epi64x(static_cast<long long>(repeatByte(src[2])), static_cast<long long>(repeatByte(src[0])));
+        __m128i high = _mm_set_epi64x(static_cast<long long>(repeatByte(src[3])), static_cast<long long>(repeatByte(src[1])));
+        
+        __m128i low_set = _mm_cmpeq_epi8(_mm_and_si128(low, bits), bits);
+        __m128i high_set = _mm_cmpeq_epi8(_mm_and_si128(high, bits), bits);
+        __m128i result = _mm_or_si128(_mm_and_si128(low_set, one), _mm_and_si128(high_set, two));
+        
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + row * 8), result);
+    }
+    
+    // Odd row count
+    if (row < rows) {
+        decodeTileRowsScalar(data + row * 2, rows - row, out + row * 8);
+    }
+}
+
+// Four pixels per step: widen the indices to 32 bits, turn bit 0 and bit 1
+// of each into a full lane mask and pick the color with two levels of
+// bitwise select
+void applyPaletteSSE2(const uint8_t* indices, const uint32_t* colors, uint32_t* out, int count) {
+    const __m128i c0 = _mm_set1_epi32(static_cast<int>(colors[0]));
+    const __m128i c2 = _mm_set1_epi32(static_cast<int>(colors[2]));
+    const __m128i c01 = _mm_set1_epi32(static_cast<int>(colors[0] ^ colors[1]));
+    const __m128i c23 = _mm_set1_epi32(static_cast<int>(colors[2] ^ colors[3]));
+    const __m128i zero = _mm_setzero_si128();
+    
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i idx8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + i));
+        __m128i idx16[2] = {_mm_unpacklo_epi8(idx8, zero), _mm_unpackhi_epi8(idx8, zero)};
+        
+        for (int j = 0; j < 4; j++) {
+            __m128i idx = (j & 1) ? _mm_unpackhi_epi16(idx16[j >> 1], zero) : _mm_unpacklo_epi16(idx16[j >> 1], zero);
+            __m128i bit0 = _mm_srai_epi32(_mm_slli_epi32(idx, 31), 31);
+            __m128i bit1 = _mm_srai_epi32(_mm_slli_epi32(idx, 30), 31);
+            
+            // select(mask, a, b) = b ^ ((a ^ b) & mask)
+            __m128i low_pair = _mm_xor_si128(c0, _mm_and_si128(c01, bit0));
+            __m128i high_pair = _mm_xor_si128(c2, _mm_and_si128(c23, bit0));
+            __m128i result = _mm_xor_si128(low_pair, _mm_and_si128(_mm_xor_si128(low_pair, high_pair), bit1));
+            
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + j * 4), result);
+        }
+    }
+    
+    applyPaletteScalar(indices + i, colors, out + i, count - i);
+}
+#endif
+
+#if defined(__AVX2__)
+// Four rows (32 pixels) per iteration
+void decodeTileRowsAVX2(const uint8_t* data, int rows, uint8_t* out) {
+    const __m256i bits = _mm256_set1_epi64x(static_cast<long long>(0x0102040810204080ULL));
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i two = _mm256_set1_epi8(2);
+    
+    int row = 0;
+    for (; row + 4 <= rows; row += 4) {
+        const uint8_t* src = data + row * 2;
+        __m256i low = _mm256_set_epi64x(static_cast<long long>(repeatByte(src[6])), static_cast<long long>(repeatByte(src[4])),
+                                        static_cast<long long>(repeatByte(src[2])), static_cast<long long>(repeatByte(src[0])));
+        __m256i high = _mm256_set_epi64x(static_cast<long long>(repeatByte(src[7])), static_cast<long long>(repeatByte(src[5])),
+                                         static_cast<long long>(repeatByte(src[3])), static_cast<long long>(repeatByte(src[1])));
+        
+        __m256i low_set = _mm256_cmpeq_epi8(_mm256_and_si256(low, bits), bits);
+        __m256i high_set = _mm256_cmpeq_epi8(_mm256_and_si256(high, bits), bits);
+        __m256i result = _mm256_or_si256(_mm256_and_si256(low_set, one), _mm256_and_si256(high_set, two));
+        
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + row * 8), result);
+    }
+    
+    if (row < rows) {
+        decodeTileRowsSSE2(data + row * 2, rows - row, out + row * 8);
+    }
+}
+
+// Eight pixels per step: the 4 colors sit in a register and each widened
+// index selects its lane with a permute
+void applyPaletteAVX2(const uint8_t* indices, const uint32_t* colors, uint32_t* out, int count) {
+    const __m256i table = _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(colors)));
+    const __m256i mask = _mm256_set1_epi32(0x03);
+    
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint64_t packed;
+        std::memcpy(&packed, indices + i, sizeof(packed));
+        __m256i idx = _mm256_and_si256(_mm256_cvtepu8_epi32(_mm_cvtsi64_si128(static_cast<long long>(packed))), mask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permutevar8x32_epi32(table, idx));
+    }
+    
+    applyPaletteScalar(indices + i, colors, out + i, count - i);
+}
+#endif
+
+void decodeTileRows(const uint8_t* data, int rows, uint8_t* out) {
+#if defined(__AVX2__)
+    decodeTileRowsAVX2(data, rows, out);
+#elif defined(__SSE2__)
+    decodeTileRowsSSE2(data, rows, out);
+#else
+    decodeTileRowsScalar(data, rows, out);
+#endif
+}
+
+void applyPalette(const uint8_t* indices, const uint32_t* colors, uint32_t* out, int count) {
+#if defined(__AVX2__)
+    applyPaletteAVX2(indices, colors, out, count);
+#elif defined(__SSE2__)
+    applyPaletteSSE2(indices, colors, out, count);
+#else
+    applyPaletteScalar(indices, colors, out, count);
+#endif
+}
+
+const char* pixelKernelName() {
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE2__)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,253 @@
+#include "rewind.hpp"
+#include "savestate.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+RewindBuffer::RewindBuffer(SaveState& state, size_t byte_budget, int keyframe_interval)
+    : state(state), keyframe_interval(std::max(keyframe_interval, 1)), state_size(state.size()),
+      arena(byte_budget), current(state_size, 0), scratch(state_size, 0),
+      encoded(state_size * 2 + 32) {
+    // Worst case the encoder emits 2 count bytes for every literal byte, plus
+    // the varint tails; state_size * 2 + 32 covers that
+}
+
+void RewindBuffer::clear() {
+    entries.clear();
+    write_pos = 0;
+    frames_since_keyframe = 0;
+}
+
+size_t RewindBuffer::bytesUsed() const {
+    size_t used = 0;
+    for (const auto& entry : entries) {
+        used += entry.length;
+    }
+    return used;
+}
+
+static uint8_t* writeVarint(uint8_t* out, size_t value) {
+    while (value >= 0x80) {
+        *out++ = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<uint8_t>(value);
+    return out;
+}
+
+static const uint8_t* readVarint(const uint8_t* in, const uint8_t* end, size_t& value) {
+    value = 0;
+    int shift = 0;
+    while (in < end) {
+        uint8_t byte = *in++;
+        value |= static_cast<size_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+        shift += 7;
+    }
+    return in;
+}
+
+size_t RewindBuffer::encodeXor(const uint8_t* a, const uint8_t* b, size_t size, uint8_t* out) {
+    uint8_t* start = out;
+    size_t pos = 0;
+    
+    while (pos < size) {
+        // Skip unchanged bytes, a word at a time where possible
+        size_t zero_start = pos;
+        while (pos + 8 <= size) {
+            uint64_t wa, wb;
+            std::memcpy(&wa, a + pos, 8);
+            std::memcpy(&wb, b + pos, 8);
+            if (wa != wb) {
+                break;
+            }
+            pos += 8;
+        }
+        while (pos < size && a[pos] == b[pos]) {
+            pos++;
+        }
+        if (pos == size) {
+            break;  // Trailing zeros aren't stored
+        }
+        
+        // Changed bytes; a single unchanged byte in between is cheaper to
+        // keep as a literal than to start a new triple
+        size_t literal_start = pos;
+        while (pos < size && (a[pos] != b[pos] || (pos + 1 < size && a[pos + 1] != b[pos + 1]))) {
+            pos++;
+        }
+        
+        out = writeVarint(out, literal_start - zero_start);
+        out = writeVarint(out, pos - literal_start);
+        for (size_t i = literal_start; i < pos; i++) {
+            *out++ = a[i] ^ b[i];
+        }
+    }
+    
+    return static_cast<size_t>(out - start);
+}
+
+void RewindBuffer::applyXor(const uint8_t* encoded_data, size_t length, uint8_t* target, size_t size) {
+    const uint8_t* in = encoded_data;
+    const uint8_t* end = encoded_data + length;
+    size_t pos = 0;
+    
+    while (in < end) {
+        size_t zeros, literals;
+        in = readVarint(in, end, zeros);
+        in = readVarint(in, end, literals);
+        pos += zeros;
+        
+        literals = std::min({literals, size - std::min(pos, size), static_cast<size_t>(end - in)});
+        for (size_t i = 0; i < literals; i++) {
+            target[pos + i] ^= in[i];
+        }
+        in += literals;
+        pos += literals;
+    }
+}
+
+void RewindBuffer::evictOldestGroup() {
+    // A keyframe and the deltas that follow it go together, since the deltas
+    // can't be decoded without it
+    entries.pop_front();
+    while (!entries.empty() && !entries.front().keyframe) {
+        entries.pop_front();
+    }
+    if (entries.empty()) {
+        write_pos = 0;
+        frames_since_keyframe = 0;
+    }
+}
+
+bool RewindBuffer::allocate(size_t length, size_t& offset) {
+    if (length > arena.size()) {
+        return false;
+    }
+    
+    // Entries are laid out one after another, wrapping to the start of the
+    // arena when the next one doesn't fit at the end
+    bool wrap = write_pos + length > arena.size();
+    offset = wrap ? 0 : write_pos;
+    
+    // Going round the ring, the oldest entry is always the next one along,
+    // so only the front can be in the way. Wrapping gives up the rest of the
+    // arena too, along with the older entries still in it
+    auto overlaps = [&](const Entry& entry) {
+        return (offset < entry.offset + entry.length && entry.offset < offset + length) ||
+               (wrap && entry.offset >= write_pos);
+    };
+    while (!entries.empty() && overlaps(entries.front())) {
+        evictOldestGroup();
+        if (entries.empty()) {
+            offset = 0;
+        }
+    }
+    
+    write_pos = offset + length;
+    return true;
+}
+
+void RewindBuffer::resize() {
+    // Only ever grows. Smaller states are stored zero-padded to state_size;
+    // restore() stops at the END chunk, so the padding is never read
+    size_t new_size = state.size();
+    if (new_size <= state_size) {
+        return;
+    }
+    state_size = new_size;
+    current.resize(state_size, 0);
+    scratch.resize(state_size, 0);
+    encoded.resize(state_size * 2 + 32);
+}
+
+void RewindBuffer::dropFrame() {
+    if (dropped_frames++ == 0) {
+        std::cerr << "Rewind: failed to record a frame, history has gaps" << std::endl;
+    }
+}
+
+void RewindBuffer::push() {
+    size_t length = state.snapshot(scratch.data(), scratch.size());
+    if (length == 0) {
+        // The state outgrew the buffers; measure it again
+        resize();
+        length = state.snapshot(scratch.data(), scratch.size());
+    }
+    if (length == 0) {
+        dropFrame();
+        return;
+    }
+    std::fill(scratch.begin() + length, scratch.end(), 0);
+    
+    // The first entry after a reset (or eviction of everything) must be a keyframe
+    bool keyframe = entries.empty() || frames_since_keyframe >= keyframe_interval;
+    if (keyframe) {
+        std::fill(current.begin(), current.end(), 0);
+    }
+    length = encodeXor(scratch.data(), current.data(), state_size, encoded.data());
+    
+    size_t offset;
+    if (!allocate(length, offset)) {
+        // Doesn't fit in the budget at all - rewind is effectively off
+        clear();
+        dropFrame();
+        return;
+    }
+    
+    // Allocation may have evicted the group this delta belongs to; it then
+    // has to be re-encoded as a keyframe
+    if (!keyframe && entries.empty()) {
+        keyframe = true;
+        write_pos = 0;
+        std::fill(current.begin(), current.end(), 0);
+        length = encodeXor(scratch.data(), current.data(), state_size, encoded.data());
+        if (!allocate(length, offset)) {
+            clear();
+            dropFrame();
+            return;
+        }
+    }
+    
+    std::memcpy(arena.data() + offset, encoded.data(), length);
+    entries.push_back({offset, length, keyframe});
+    frames_since_keyframe = keyframe ? 1 : frames_since_keyframe + 1;
+    current.swap(scratch);
+}
+
+void RewindBuffer::rebuildCurrent() {
+    // Find the newest keyframe, then replay the deltas after it
+    size_t key = entries.size() - 1;
+    while (key > 0 && !entries[key].keyframe) {
+        key--;
+    }
+    
+    std::fill(current.begin(), current.end(), 0);
+    for (size_t i = key; i < entries.size(); i++) {
+        applyXor(arena.data() + entries[i].offset, entries[i].length, current.data(), state_size);
+    }
+    frames_since_keyframe = static_cast<int>(entries.size() - key);
+}
+
+bool RewindBuffer::stepBack() {
+    if (entries.size() < 2) {
+        return false;
+    }
+    
+    Entry newest = entries.back();
+    entries.pop_back();
+    write_pos = newest.offset;
+    
+    if (newest.keyframe) {
+        // The previous frame belongs to the group before this keyframe
+        rebuildCurrent();
+    } else {
+        // newest = previous XOR delta, so the same XOR takes it back
+        applyXor(arena.data() + newest.offset, newest.length, current.data(), state_size);
+        frames_since_keyframe--;
+    }
+    
+    return state.restore(current.data(), state_size);
+}
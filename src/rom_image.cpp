@@ -0,0 +1,137 @@
+#include "rom_image.hpp"
+#include "log.hpp"
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GB_ROM_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Images opened from files, keyed by file identity. The cache only holds weak
+// references, so an image goes away with the last Cartridge using it
+static std::mutex cache_mutex;
+static std::map<std::string, std::weak_ptr<const RomImage>> cache;
+
+std::shared_ptr<const RomImage> RomImage::open(const std::string& path) {
+#ifdef GB_ROM_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open: " << path << std::endl;
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return readFile(path);
+    }
+
+    // Device and inode find the same file under any path; size and mtime
+    // keep a ROM rebuilt in place from picking up the old image
+    std::string key = std::to_string(st.st_dev) + ":" + std::to_string(st.st_ino) + ":" +
+                      std::to_string(st.st_size) + ":" + std::to_string(st.st_mtime);
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if (std::shared_ptr<const RomImage> image = cache[key].lock()) {
+        ::close(fd);
+        return image;
+    }
+
+    size_t length = static_cast<size_t>(st.st_size);
+    void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);  // The mapping keeps its own reference to the file
+
+    std::shared_ptr<const RomImage> image;
+    if (mapping != MAP_FAILED) {
+        std::shared_ptr<RomImage> mapped_image(new RomImage());
+        mapped_image->bytes = static_cast<const uint8_t*>(mapping);
+        mapped_image->length = length;
+        mapped_image->mapped = true;
+        image = mapped_image;
+    } else {
+        GB_LOG_INFO(LOG_CART, "mmap failed, reading " << path << " into memory instead");
+        image = readFile(path);
+        if (!image) {
+            return nullptr;
+        }
+    }
+    
+    // Drop entries whose images have all been released
+    for (auto it = cache.begin(); it != cache.end();) {
+        it = it->second.expired() ? cache.erase(it) : std::next(it);
+    }
+    cache[key] = image;
+    return image;
+#else
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if (std::shared_ptr<const RomImage> image = cache[path].lock()) {
+        return image;
+    }
+    std::shared_ptr<const RomImage> image = readFile(path);
+    if (image) {
+        cache[path] = image;
+    }
+    return image;
+#endif
+}
+
+std::shared_ptr<const RomImage> RomImage::readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open: " << path << std::endl;
+        return nullptr;
+    }
+
+    auto fileSize = file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    std::vector<uint8_t> data(static_cast<size_t>(fileSize));
+    file.read(reinterpret_cast<char*>(data.data()), fileSize);
+    return fromData(std::move(data));
+}
+
+std::shared_ptr<const RomImage> RomImage::fromData(std::vector<uint8_t> data) {
+    std::shared_ptr<RomImage> image(new RomImage());
+    image->owned = std::move(data);
+    image->bytes = image->owned.data();
+    image->length = image->owned.size();
+    return image;
+}
+
+RomImage::~RomImage() {
+#ifdef GB_ROM_MMAP
+    if (mapped) {
+        munmap(const_cast<uint8_t*>(bytes), length);
+    }
+#endif
+}
+
+// CRC-32 (IEEE 802.3, as used by zip and most ROM databases)
+uint32_t RomImage::crc32() const {
+    std::call_once(crc_once, [this] {
+        static const auto table = [] {
+            std::array<uint32_t, 256> t{};
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                t[i] = c;
+            }
+            return t;
+        }();
+
+        uint32_t value = 0xFFFFFFFFu;
+        for (size_t i = 0; i < length; i++) {
+            value = table[(value ^ bytes[i]) & 0xFF] ^ (value >> 8);
+        }
+        crc = value ^ 0xFFFFFFFFu;
+    });
+    return crc;
+}
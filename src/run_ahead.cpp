@@ -0,0 +1,68 @@
+#include "run_ahead.hpp"
+#include "emulator.hpp"
+#include "apu.hpp"
+#include "savestate.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedNs(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+RunAhead::RunAhead(Emulator& emulator, int frames)
+    : emulator(emulator), frames(std::max(frames, 1)),
+      state(emulator.getSaveState().size()), screen(emulator.getGPU().getScreenBuffer()) {
+}
+
+bool RunAhead::run() {
+    SaveState& savestate = emulator.getSaveState();
+    APU& apu = emulator.getAPU();
+    const std::vector<uint32_t>& real = emulator.getGPU().getScreenBuffer();
+
+    // The frames run ahead are never heard; the blip buffers stay where the
+    // real frame left them
+    apu.suspendOutput();
+
+    Clock::time_point start = Clock::now();
+    size_t state_size = savestate.snapshot(state.data(), state.size());
+    if (state_size == 0) {
+        // The state outgrew the buffer; measure again and allocate to fit
+        state.resize(savestate.size());
+        state_size = savestate.snapshot(state.data(), state.size());
+    }
+    if (state_size == 0) {
+        // Nothing to come back to, so don't run ahead at all
+        std::cerr << "Run-ahead: failed to snapshot the machine" << std::endl;
+        std::copy(real.begin(), real.end(), screen.begin());
+        apu.resumeOutput();
+        return false;
+    }
+    Clock::time_point snapshot_done = Clock::now();
+
+    bool ok = true;
+    for (int i = 0; i < frames && ok; i++) {
+        ok = emulator.runFrame();
+    }
+    const std::vector<uint32_t>& ahead = emulator.getGPU().getScreenBuffer();
+    std::copy(ahead.begin(), ahead.end(), screen.begin());
+    Clock::time_point ahead_done = Clock::now();
+
+    if (!savestate.restore(state.data(), state_size)) {
+        std::cerr << "Run-ahead: failed to restore the machine, it is now "
+                  << frames << " frames ahead" << std::endl;
+        apu.resumeOutput();
+        return false;
+    }
+    Clock::time_point restore_done = Clock::now();
+
+    apu.resumeOutput();
+
+    runs++;
+    snapshot_ns += elapsedNs(start, snapshot_done);
+    ahead_ns += elapsedNs(snapshot_done, ahead_done);
+    restore_ns += elapsedNs(ahead_done, restore_done);
+    return ok;
+}
@@ -0,0 +1,322 @@
+#include "savestate.hpp"
+#include "cpu.hpp"
+#include "memory.hpp"
+#include "gpu.hpp"
+#include "timer.hpp"
+#include "serial.hpp"
+#include "apu.hpp"
+#include "cartridge.hpp"
+#include "scheduler.hpp"
+#include "log.hpp"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+static const char SAVESTATE_MAGIC[4] = {'G', 'B', 'S', 'S'};
+
+// Header: magic, version, ROM checksum
+constexpr size_t HEADER_SIZE = 12;
+
+// Chunk header: tag, payload size
+constexpr size_t CHUNK_HEADER_SIZE = 8;
+
+// STATE WRITER
+
+void StateWriter::writeBytes(const void* data, size_t length) {
+    if (buffer != nullptr) {
+        if (overflow || length > capacity - position) {
+            overflow = true;
+        } else {
+            std::memcpy(buffer + position, data, length);
+        }
+    }
+    position += length;
+}
+
+void StateWriter::write16(uint16_t value) {
+    uint8_t bytes[2] = {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8)};
+    writeBytes(bytes, sizeof(bytes));
+}
+
+void StateWriter::write32(uint32_t value) {
+    uint8_t bytes[4];
+    for (int i = 0; i < 4; i++) {
+        bytes[i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+    writeBytes(bytes, sizeof(bytes));
+}
+
+void StateWriter::write64(uint64_t value) {
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+    writeBytes(bytes, sizeof(bytes));
+}
+
+void StateWriter::write32Array(const uint32_t* values, size_t count) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (size_t i = 0; i < count; i++) {
+        write32(values[i]);
+    }
+#else
+    // Already in file order on little-endian hosts
+    writeBytes(values, count * sizeof(uint32_t));
+#endif
+}
+
+void StateWriter::beginChunk(const char* tag) {
+    writeBytes(tag, 4);
+    
+    // The payload size is patched in by endChunk()
+    chunk_start = position;
+    write32(0);
+}
+
+void StateWriter::endChunk() {
+    size_t payload = position - chunk_start - 4;
+    if (buffer != nullptr && !overflow) {
+        for (int i = 0; i < 4; i++) {
+            buffer[chunk_start + i] = static_cast<uint8_t>(payload >> (i * 8));
+        }
+    }
+}
+
+// STATE READER
+
+bool StateReader::openChunk(const char* tag) {
+    size_t start = 0;
+    size_t end = 0;
+    if (!findChunk(tag, start, end)) {
+        error = true;
+        return false;
+    }
+    position = start;
+    chunk_end = end;
+    return true;
+}
+
+bool StateReader::hasChunk(const char* tag) const {
+    size_t start = 0;
+    size_t end = 0;
+    return findChunk(tag, start, end);
+}
+
+uint32_t StateReader::version() const {
+    if (data_size < HEADER_SIZE) {
+        return 0;
+    }
+    return static_cast<uint32_t>(data[4]) | (static_cast<uint32_t>(data[5]) << 8) |
+           (static_cast<uint32_t>(data[6]) << 16) | (static_cast<uint32_t>(data[7]) << 24);
+}
+
+bool StateReader::findChunk(const char* tag, size_t& start, size_t& end) const {
+    // Chunks start right after the header; walk them until the tag matches
+    size_t offset = HEADER_SIZE;
+    
+    while (offset + CHUNK_HEADER_SIZE <= data_size) {
+        const uint8_t* chunk = data + offset;
+        uint32_t payload = static_cast<uint32_t>(chunk[4]) | (static_cast<uint32_t>(chunk[5]) << 8) |
+                           (static_cast<uint32_t>(chunk[6]) << 16) | (static_cast<uint32_t>(chunk[7]) << 24);
+        if (payload > data_size - offset - CHUNK_HEADER_SIZE) {
+            break;  // Truncated or corrupt
+        }
+        
+        if (std::memcmp(chunk, tag, 4) == 0) {
+            start = offset + CHUNK_HEADER_SIZE;
+            end = start + payload;
+            return true;
+        }
+        if (std::memcmp(chunk, "END ", 4) == 0) {
+            break;
+        }
+        
+        offset += CHUNK_HEADER_SIZE + payload;
+    }
+    
+    return false;
+}
+
+void StateReader::readBytes(void* out, size_t length) {
+    if (error || length > chunk_end - position) {
+        error = true;
+        std::memset(out, 0, length);
+        return;
+    }
+    std::memcpy(out, data + position, length);
+    position += length;
+}
+
+void StateReader::read32Array(uint32_t* out, size_t count) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (size_t i = 0; i < count; i++) {
+        out[i] = read32();
+    }
+#else
+    readBytes(out, count * sizeof(uint32_t));
+#endif
+}
+
+uint8_t StateReader::read8() {
+    uint8_t value;
+    readBytes(&value, 1);
+    return value;
+}
+
+uint16_t StateReader::read16() {
+    uint8_t bytes[2];
+    readBytes(bytes, sizeof(bytes));
+    return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+}
+
+uint32_t StateReader::read32() {
+    uint8_t bytes[4];
+    readBytes(bytes, sizeof(bytes));
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+uint64_t StateReader::read64() {
+    uint8_t bytes[8];
+    readBytes(bytes, sizeof(bytes));
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+// SAVE STATE
+
+SaveState::SaveState(CPU& cpu, MemoryBus& memory, GPU& gpu, Timer& timer, Serial& serial, APU& apu, Cartridge& cart, Scheduler& scheduler)
+    : cpu(cpu), memory(memory), gpu(gpu), timer(timer), serial(serial), apu(apu), cart(cart), scheduler(scheduler) {
+}
+
+uint32_t SaveState::romChecksum() const {
+    const CartridgeHeader& header = cart.getHeader();
+    return (static_cast<uint32_t>(header.globalChecksum) << 16) |
+           (static_cast<uint32_t>(header.headerChecksum) << 8) | header.cartridgeType;
+}
+
+void SaveState::write(StateWriter& writer) const {
+    writer.writeBytes(SAVESTATE_MAGIC, sizeof(SAVESTATE_MAGIC));
+    writer.write32(SAVESTATE_VERSION);
+    writer.write32(romChecksum());
+    
+    cpu.saveState(writer);
+    memory.saveState(writer);
+    gpu.saveState(writer);
+    timer.saveState(writer);
+    serial.saveState(writer);
+    apu.saveState(writer);
+    cart.saveState(writer);
+    scheduler.saveState(writer);
+    
+    writer.beginChunk("END ");
+    writer.endChunk();
+}
+
+size_t SaveState::size() const {
+    StateWriter measure(nullptr, 0);
+    write(measure);
+    return measure.size();
+}
+
+size_t SaveState::snapshot(uint8_t* buffer, size_t capacity) const {
+    StateWriter writer(buffer, capacity);
+    write(writer);
+    return writer.overflowed() ? 0 : writer.size();
+}
+
+bool SaveState::restore(const uint8_t* data, size_t size) {
+    if (size < HEADER_SIZE || std::memcmp(data, SAVESTATE_MAGIC, sizeof(SAVESTATE_MAGIC)) != 0) {
+        std::cerr << "Not a save state" << std::endl;
+        return false;
+    }
+    
+    StateReader reader(data, size);
+    uint32_t version = reader.version();
+    uint32_t checksum = static_cast<uint32_t>(data[8]) | (static_cast<uint32_t>(data[9]) << 8) |
+                        (static_cast<uint32_t>(data[10]) << 16) | (static_cast<uint32_t>(data[11]) << 24);
+    
+    if (version > SAVESTATE_VERSION) {
+        std::cerr << "Save state version " << version << " is newer than supported (" 
+                  << SAVESTATE_VERSION << ")" << std::endl;
+        return false;
+    }
+    if (checksum != romChecksum()) {
+        std::cerr << "Save state belongs to a different ROM" << std::endl;
+        return false;
+    }
+    
+    // Every chunk has to be there before anything is touched
+    for (const char* tag : {"CPU ", "MEM ", "PPU ", "TIMR", "CART", "SCHD"}) {
+        if (!reader.openChunk(tag)) {
+            std::cerr << "Save state is missing the " << tag << " chunk" << std::endl;
+            return false;
+        }
+    }
+    
+    cpu.loadState(reader);
+    memory.loadState(reader);
+    gpu.loadState(reader);
+    timer.loadState(reader);
+    if (reader.hasChunk("SRL ")) {
+        // Not in states from before the serial port existed
+        serial.loadState(reader);
+    }
+    if (reader.hasChunk("APU ")) {
+        apu.loadState(reader);
+    } else {
+        // From before the APU: silence until the game next starts a sound
+        apu.reset();
+    }
+    cart.loadState(reader);
+    scheduler.loadState(reader);
+    
+    // The page table and tile cache are derived from the restored memory and MBC state
+    memory.remapCartridge();
+    memory.getTileCache().invalidateAll();
+    
+    if (reader.failed()) {
+        std::cerr << "Save state is truncated or corrupt" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool SaveState::saveToFile(const std::string& path) const {
+    std::vector<uint8_t> buffer(size());
+    size_t written = snapshot(buffer.data(), buffer.size());
+    
+    std::ofstream file(path, std::ios::binary);
+    if (!file || written == 0) {
+        std::cerr << "Failed to write save state: " << path << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(buffer.data()), written);
+    
+    GB_LOG_INFO(LOG_SYSTEM, "Saved state to: " << path << " (" << written << " bytes)");
+    return true;
+}
+
+bool SaveState::loadFromFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to open save state: " << path << std::endl;
+        return false;
+    }
+    
+    std::vector<uint8_t> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (!restore(buffer.data(), buffer.size())) {
+        return false;
+    }
+    
+    GB_LOG_INFO(LOG_SYSTEM, "Loaded state from: " << path);
+    return true;
+}
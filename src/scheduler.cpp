@@ -0,0 +1,150 @@
+#include "scheduler.hpp"
+#include "savestate.hpp"
+#include <utility>
+
+Scheduler::Scheduler() : size(0), clock(nullptr) {
+    positions.fill(NOT_QUEUED);
+}
+
+void Scheduler::setHandler(EventType type, Handler handler) {
+    handlers[index(type)] = handler;
+}
+
+void Scheduler::schedule(EventType type, uint64_t when) {
+    uint8_t pos = positions[index(type)];
+
+    if (pos == NOT_QUEUED) {
+        // New event goes at the end of the heap and bubbles up
+        pos = static_cast<uint8_t>(size++);
+        heap[pos] = {when, type};
+        positions[index(type)] = pos;
+        siftUp(pos);
+        updateNextEvent();
+        return;
+    }
+
+    // Already queued - move it to its new timestamp
+    uint64_t old_when = heap[pos].when;
+    heap[pos].when = when;
+    if (when < old_when) {
+        siftUp(pos);
+    } else {
+        siftDown(pos);
+    }
+    updateNextEvent();
+}
+
+void Scheduler::cancel(EventType type) {
+    uint8_t pos = positions[index(type)];
+    if (pos != NOT_QUEUED) {
+        removeAt(pos);
+    }
+}
+
+uint64_t Scheduler::getEventTime(EventType type) const {
+    uint8_t pos = positions[index(type)];
+    return pos == NOT_QUEUED ? NO_EVENT : heap[pos].when;
+}
+
+int Scheduler::dispatchDue() {
+    int dispatched = 0;
+    uint64_t current = now();
+
+    // Handlers usually reschedule their own event, so pop before calling them
+    while (size > 0 && heap[0].when <= current) {
+        EventType type = heap[0].type;
+        removeAt(0);
+
+        if (handlers[index(type)]) {
+            handlers[index(type)](current);
+        }
+        dispatched++;
+    }
+
+    return dispatched;
+}
+
+void Scheduler::siftUp(size_t pos) {
+    while (pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if (heap[parent].when <= heap[pos].when) {
+            break;
+        }
+        swapEntries(pos, parent);
+        pos = parent;
+    }
+}
+
+void Scheduler::siftDown(size_t pos) {
+    while (true) {
+        size_t left = pos * 2 + 1;
+        size_t right = left + 1;
+        size_t smallest = pos;
+
+        if (left < size && heap[left].when < heap[smallest].when) {
+            smallest = left;
+        }
+        if (right < size && heap[right].when < heap[smallest].when) {
+            smallest = right;
+        }
+        if (smallest == pos) {
+            break;
+        }
+
+        swapEntries(pos, smallest);
+        pos = smallest;
+    }
+}
+
+void Scheduler::swapEntries(size_t a, size_t b) {
+    std::swap(heap[a], heap[b]);
+    positions[index(heap[a].type)] = static_cast<uint8_t>(a);
+    positions[index(heap[b].type)] = static_cast<uint8_t>(b);
+}
+
+void Scheduler::removeAt(size_t pos) {
+    positions[index(heap[pos].type)] = NOT_QUEUED;
+    size--;
+
+    if (pos == size) {
+        updateNextEvent();
+        return;
+    }
+
+    // Move the last entry into the hole and restore the heap property
+    heap[pos] = heap[size];
+    positions[index(heap[pos].type)] = static_cast<uint8_t>(pos);
+    siftDown(pos);
+    siftUp(pos);
+    updateNextEvent();
+}
+
+void Scheduler::saveState(StateWriter& writer) const {
+    // One timestamp per event type, NO_EVENT when it isn't pending
+    writer.beginChunk("SCHD");
+    writer.write8(static_cast<uint8_t>(EVENT_COUNT));
+    for (size_t i = 0; i < EVENT_COUNT; i++) {
+        writer.write64(getEventTime(static_cast<EventType>(i)));
+    }
+    writer.endChunk();
+}
+
+void Scheduler::loadState(StateReader& reader) {
+    if (!reader.openChunk("SCHD")) {
+        return;
+    }
+    
+    // Event types added after the state was written stay unscheduled;
+    // ones this build doesn't know about are skipped
+    size_t count = reader.read8();
+    size = 0;
+    positions.fill(NOT_QUEUED);
+    updateNextEvent();
+    
+    for (size_t i = 0; i < count; i++) {
+        uint64_t when = reader.read64();
+        if (i < EVENT_COUNT && when != NO_EVENT) {
+            schedule(static_cast<EventType>(i), when);
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#include "serial.hpp"
+#include "memory.hpp"
+#include "scheduler.hpp"
+#include "savestate.hpp"
+#include "log.hpp"
+
+// Serial register addresses
+constexpr uint16_t SB_REGISTER_ADDR = 0xFF01;
+constexpr uint16_t SC_REGISTER_ADDR = 0xFF02;
+
+// Interrupt flags address and the serial bit
+constexpr uint16_t IF_REGISTER_ADDR = 0xFF0F;
+constexpr uint8_t SERIAL_INTERRUPT_FLAG = 0x08;
+
+// SC bits
+constexpr uint8_t SC_TRANSFER_START = 0x80;
+constexpr uint8_t SC_INTERNAL_CLOCK = 0x01;
+
+// 8 bits at 8192 Hz
+constexpr uint64_t TRANSFER_CYCLES = 8 * 512;
+
+Serial::Serial(MemoryBus& memory) : memory(memory) {
+}
+
+uint8_t Serial::readRegister(uint16_t address) const {
+    if (address == SB_REGISTER_ADDR) {
+        return sb;
+    }
+
+    // Bits 1-6 of SC are unused and read as 1 on the DMG
+    return sc | 0x7E;
+}
+
+void Serial::writeRegister(uint16_t address, uint8_t value) {
+    if (address == SB_REGISTER_ADDR) {
+        sb = value;
+        return;
+    }
+
+    sc = value & (SC_TRANSFER_START | SC_INTERNAL_CLOCK);
+
+    if ((sc & SC_TRANSFER_START) && (sc & SC_INTERNAL_CLOCK)) {
+        if (scheduler) {
+            scheduler->scheduleIn(EventType::SERIAL_TRANSFER, TRANSFER_CYCLES);
+        } else {
+            completeTransfer();
+        }
+    } else if (scheduler) {
+        // Stopped, or waiting on an external clock that never comes
+        scheduler->cancel(EventType::SERIAL_TRANSFER);
+    }
+}
+
+void Serial::completeTransfer() {
+    uint8_t sent = sb;
+
+    // Nothing on the other end: the bits shifted in are all 1
+    sb = 0xFF;
+    sc &= ~SC_TRANSFER_START;
+    memory.write(IF_REGISTER_ADDR, memory.read(IF_REGISTER_ADDR) | SERIAL_INTERRUPT_FLAG);
+
+    output += static_cast<char>(sent);
+    if (output_callback) {
+        output_callback(sent);
+    }
+
+    GB_LOG_DEBUG(LOG_MEMORY, "Serial byte sent: 0x" << std::hex << static_cast<int>(sent) << std::dec);
+}
+
+void Serial::saveState(StateWriter& writer) const {
+    writer.beginChunk("SRL ");
+    writer.write8(sb);
+    writer.write8(sc);
+    writer.endChunk();
+}
+
+void Serial::loadState(StateReader& reader) {
+    if (!reader.openChunk("SRL ")) {
+        return;
+    }
+    sb = reader.read8();
+    sc = reader.read8();
+}
@@ -0,0 +1,12 @@
+#include "tile_cache.hpp"
+#include "pixel_kernels.hpp"
+
+TileCache::TileCache(const uint8_t* vram) : vram(vram) {
+    // Nothing is decoded until a tile is first used
+    dirty.fill(true);
+}
+
+void TileCache::decodeTile(uint16_t tile) {
+    decodeTileRows(vram + tile * 16, 8, pixels[tile].data());
+    dirty[tile] = false;
+}
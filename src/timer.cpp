@@ -1,5 +1,8 @@
 #include "timer.hpp"
 #include "memory.hpp"
+#include "scheduler.hpp"
+#include "savestate.hpp"
+#include <algorithm>
 
 // Timer register addresses
 constexpr uint16_t DIV_REGISTER_ADDR = 0xFF04;
@@ -15,6 +18,8 @@ constexpr uint8_t TIMER_INTERRUPT_FLAG = 0x04;
 
 Timer::Timer(MemoryBus& memory)
     : memory(memory), 
+      scheduler(nullptr),
+      last_sync_cycle(0),
       div_counter(0), 
       div(0), 
       tima(0), 
@@ -25,9 +30,8 @@ Timer::Timer(MemoryBus& memory)
       previous_bit_state(false) {
 }
 
-void Timer::tick(uint8_t cycles) {
-    // For each CPU M-cycle
-    for (uint8_t i = 0; i < cycles; i++) {
+void Timer::tick(uint32_t cycles) {
+    while (cycles > 0) {
         // Handle TIMA reload that was scheduled in the previous cycle
         if (tima_reload_scheduled) {
             tima = tma;
@@ -41,26 +45,26 @@ void Timer::tick(uint8_t cycles) {
             memory.write(IF_REGISTER_ADDR, if_value | TIMER_INTERRUPT_FLAG);
         }
         
-        // Increment the system counter (DIV internal counter)
-        div_counter++;
-        
-        // DIV register is the upper 8 bits of the 16-bit system counter
-        div = div_counter >> 8;
-        
-        // Get the currently selected bit from the system counter based on TAC
-        bool current_bit_state = false;
+        // Advance straight to the next falling edge of the selected counter bit,
+        // or through all remaining cycles if the edge is further away
+        uint32_t step = cycles;
+        bool falling_edge = false;
         
         if (isTimerEnabled()) {
-            switch (tac & 0x03) {
-                case 0: current_bit_state = (div_counter & (1 << 9)) != 0; break;  // 4096Hz (bit 9)
-                case 1: current_bit_state = (div_counter & (1 << 3)) != 0; break;  // 262144Hz (bit 3)
-                case 2: current_bit_state = (div_counter & (1 << 5)) != 0; break;  // 65536Hz (bit 5)
-                case 3: current_bit_state = (div_counter & (1 << 7)) != 0; break;  // 16384Hz (bit 7)
+            uint32_t period = getTimerPeriod();
+            uint32_t cycles_to_edge = period - (div_counter & (period - 1));
+            
+            if (cycles_to_edge <= step) {
+                step = cycles_to_edge;
+                falling_edge = true;
             }
         }
         
-        // Falling edge detector
-        if (previous_bit_state && !current_bit_state) {
+        // The system counter (DIV internal counter) wraps at 16 bits
+        div_counter = static_cast<uint16_t>(div_counter + step);
+        cycles -= step;
+        
+        if (falling_edge) {
             // Increment TIMA on falling edge
             tima++;
             
@@ -70,13 +74,76 @@ void Timer::tick(uint8_t cycles) {
                 tima_reload_scheduled = true;
             }
         }
+    }
+    
+    // DIV register is the upper 8 bits of the 16-bit system counter
+    div = div_counter >> 8;
+    
+    // Keep the edge detector state in line with the counter
+    previous_bit_state = isTimerEnabled() && (div_counter & (getTimerPeriod() >> 1)) != 0;
+}
+
+void Timer::setScheduler(Scheduler* scheduler_ptr) {
+    scheduler = scheduler_ptr;
+    
+    if (scheduler != nullptr) {
+        last_sync_cycle = scheduler->now();
+        scheduleOverflow();
+    }
+}
+
+void Timer::sync(uint64_t now) {
+    if (now > last_sync_cycle) {
+        uint64_t elapsed = now - last_sync_cycle;
         
-        // Update previous state for next cycle's edge detection
-        previous_bit_state = current_bit_state;
+        // tick() takes 32-bit counts, so split very long gaps
+        while (elapsed > 0) {
+            uint32_t chunk = static_cast<uint32_t>(std::min<uint64_t>(elapsed, UINT32_MAX));
+            tick(chunk);
+            elapsed -= chunk;
+        }
+    }
+    last_sync_cycle = now;
+    
+    scheduleOverflow();
+}
+
+uint64_t Timer::cyclesUntilInterrupt() const {
+    // A pending reload fires on the very next cycle
+    if (tima_reload_scheduled) {
+        return 1;
+    }
+    
+    if (!isTimerEnabled()) {
+        return UINT64_MAX;
+    }
+    
+    // Cycles to the next TIMA increment, then one period per remaining count
+    // until TIMA wraps, then one more cycle for the delayed reload
+    uint32_t period = getTimerPeriod();
+    uint32_t cycles_to_edge = period - (div_counter & (period - 1));
+    return cycles_to_edge + static_cast<uint64_t>(0xFF - tima) * period + 1;
+}
+
+void Timer::scheduleOverflow() {
+    if (scheduler == nullptr) {
+        return;
+    }
+    
+    uint64_t cycles_left = cyclesUntilInterrupt();
+    if (cycles_left == UINT64_MAX) {
+        scheduler->cancel(EventType::TIMER_OVERFLOW);
+    } else {
+        scheduler->schedule(EventType::TIMER_OVERFLOW, last_sync_cycle + cycles_left);
     }
 }
 
-uint8_t Timer::readRegister(uint16_t address) const {
+uint8_t Timer::readRegister(uint16_t address) {
+    // Bring the timer up to date before exposing its registers
+    if (scheduler != nullptr) {
+        sync(scheduler->now());
+    }
+    
     switch (address) {
         case DIV_REGISTER_ADDR:
             return div;
@@ -92,6 +159,11 @@ uint8_t Timer::readRegister(uint16_t address) const {
 }
 
 void Timer::writeRegister(uint16_t address, uint8_t value) {
+    // Bring the timer up to date before changing its registers
+    if (scheduler != nullptr) {
+        sync(scheduler->now());
+    }
+    
     // Get the current bit state before any changes
     bool old_bit_state = false;
     if (isTimerEnabled()) {
@@ -177,6 +249,9 @@ void Timer::writeRegister(uint16_t address, uint8_t value) {
             previous_bit_state = new_bit_state;
             break;
     }
+    
+    // The write may have moved (or cancelled) the next overflow
+    scheduleOverflow();
 }
 
 uint32_t Timer::getTimerFrequency() const {
@@ -190,7 +265,48 @@ uint32_t Timer::getTimerFrequency() const {
     }
 }
 
+uint32_t Timer::getTimerPeriod() const {
+    // TIMA increments on the falling edge of system counter bit 9/3/5/7,
+    // which happens once every 2^(bit + 1) cycles
+    switch (tac & 0x03) {
+        case 0: return 1024;
+        case 1: return 16;
+        case 2: return 64;
+        case 3: return 256;
+        default: return 1024;
+    }
+}
+
 bool Timer::isTimerEnabled() const {
     // TAC bit 2 determines if the timer is enabled
     return (tac & 0x04) != 0;
-} 
\ No newline at end of file
+} 
+
+void Timer::saveState(StateWriter& writer) const {
+    writer.beginChunk("TIMR");
+    writer.write64(last_sync_cycle);
+    writer.write16(div_counter);
+    writer.write8(div);
+    writer.write8(tima);
+    writer.write8(tma);
+    writer.write8(tac);
+    writer.writeBool(interrupt_requested);
+    writer.writeBool(tima_reload_scheduled);
+    writer.writeBool(previous_bit_state);
+    writer.endChunk();
+}
+
+void Timer::loadState(StateReader& reader) {
+    if (!reader.openChunk("TIMR")) {
+        return;
+    }
+    last_sync_cycle = reader.read64();
+    div_counter = reader.read16();
+    div = reader.read8();
+    tima = reader.read8();
+    tma = reader.read8();
+    tac = reader.read8();
+    interrupt_requested = reader.readBool();
+    tima_reload_scheduled = reader.readBool();
+    previous_bit_state = reader.readBool();
+}
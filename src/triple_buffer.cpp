@@ -0,0 +1,29 @@
+#include "triple_buffer.hpp"
+#include <cstring>
+
+TripleBuffer::TripleBuffer(size_t frame_pixels) {
+    for (auto& frame : frames) {
+        frame.assign(frame_pixels, 0);
+    }
+}
+
+void TripleBuffer::publish() {
+    // Release makes the back buffer's contents visible with it; acquire
+    // makes sure the consumer is done with the buffer handed back
+    uint8_t previous = middle.exchange(back_index | FRESH, std::memory_order_acq_rel);
+    back_index = previous & INDEX_MASK;
+}
+
+void TripleBuffer::publish(const uint32_t* pixels) {
+    std::memcpy(back(), pixels, framePixels() * sizeof(uint32_t));
+    publish();
+}
+
+bool TripleBuffer::acquire() {
+    if ((middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+        return false;
+    }
+    uint8_t previous = middle.exchange(front_index, std::memory_order_acq_rel);
+    front_index = previous & INDEX_MASK;
+    return true;
+}
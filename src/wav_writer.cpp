@@ -0,0 +1,85 @@
+#include "wav_writer.hpp"
+#include <algorithm>
+#include <iostream>
+
+constexpr uint16_t WAV_CHANNELS = 2;
+constexpr uint16_t WAV_BITS = 16;
+constexpr uint32_t WAV_FRAME_BYTES = WAV_CHANNELS * WAV_BITS / 8;
+constexpr uint32_t WAV_HEADER_BYTES = 44;
+
+// WAV fields are little-endian whatever the host is
+static void put16(char* out, uint16_t value) {
+    out[0] = static_cast<char>(value & 0xFF);
+    out[1] = static_cast<char>(value >> 8);
+}
+
+static void put32(char* out, uint32_t value) {
+    put16(out, static_cast<uint16_t>(value & 0xFFFF));
+    put16(out + 2, static_cast<uint16_t>(value >> 16));
+}
+
+bool WavWriter::open(const std::string& path, uint32_t sample_rate) {
+    close();
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Failed to create: " << path << std::endl;
+        return false;
+    }
+    frames_written = 0;
+    writeHeader(sample_rate, 0);
+    return true;
+}
+
+void WavWriter::writeHeader(uint32_t sample_rate, uint32_t data_bytes) {
+    char header[WAV_HEADER_BYTES];
+    std::copy_n("RIFF", 4, header);
+    put32(header + 4, WAV_HEADER_BYTES - 8 + data_bytes);
+    std::copy_n("WAVE", 4, header + 8);
+    std::copy_n("fmt ", 4, header + 12);
+    put32(header + 16, 16);                            // fmt chunk size
+    put16(header + 20, 1);                             // PCM
+    put16(header + 22, WAV_CHANNELS);
+    put32(header + 24, sample_rate);
+    put32(header + 28, sample_rate * WAV_FRAME_BYTES); // Byte rate
+    put16(header + 32, WAV_FRAME_BYTES);               // Block align
+    put16(header + 34, WAV_BITS);
+    std::copy_n("data", 4, header + 36);
+    put32(header + 40, data_bytes);
+    file.write(header, sizeof(header));
+}
+
+void WavWriter::write(const int16_t* samples, size_t frames) {
+    if (!file.is_open()) {
+        return;
+    }
+
+    char bytes[512 * WAV_FRAME_BYTES];
+    while (frames > 0) {
+        size_t count = std::min<size_t>(frames, 512);
+        for (size_t i = 0; i < count * WAV_CHANNELS; i++) {
+            put16(bytes + i * 2, static_cast<uint16_t>(samples[i]));
+        }
+        file.write(bytes, static_cast<std::streamsize>(count * WAV_FRAME_BYTES));
+        samples += count * WAV_CHANNELS;
+        frames -= count;
+        frames_written += count;
+    }
+}
+
+void WavWriter::close() {
+    if (!file.is_open()) {
+        return;
+    }
+
+    // The data size field is 32 bits; longer recordings keep playing in
+    // most players but report a wrong length
+    uint64_t data_bytes = std::min<uint64_t>(frames_written * WAV_FRAME_BYTES, 0xFFFFFFFFu - WAV_HEADER_BYTES);
+    char sizes[4];
+    put32(sizes, static_cast<uint32_t>(WAV_HEADER_BYTES - 8 + data_bytes));
+    file.seekp(4);
+    file.write(sizes, 4);
+    put32(sizes, static_cast<uint32_t>(data_bytes));
+    file.seekp(40);
+    file.write(sizes, 4);
+    file.close();
+}
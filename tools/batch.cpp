@@ -0,0 +1,198 @@
+// Batch runner: runs every ROM for a fixed number of frames, headless and in
+// parallel, and reports the final frame hash, cycle count and wall time of
+// each as CSV or JSON. Used for regression runs over large ROM sets.
+//
+// Usage: gb-batch [options] <rom>...
+//   --list=FILE      Also run the ROMs listed in FILE, one path per line
+//   --frames=N       Frames to run each ROM for (default 600)
+//   --jobs=N         Worker threads (default: one per core)
+//   --format=F       csv (default) or json
+//   --renderer=R     scanline (default) or fifo
+//   --frame-skip=N   Draw only one frame in every N+1 (the last frames are
+//                    always drawn, so the hash is unaffected)
+//
+// Each ROM gets its own Emulator, with battery RAM not loaded or saved, so a
+// run only depends on the ROM and the frame count. Results are printed in
+// the order the ROMs were given, whatever order they finish in.
+
+#include "emulator.hpp"
+#include "log.hpp"
+#include "tool_util.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct BatchOptions {
+    std::vector<std::string> roms;
+    uint64_t frames = 600;
+    unsigned jobs = 0;  // 0 = hardware concurrency
+    bool json = false;
+    RendererMode renderer = RendererMode::SCANLINE;
+    uint32_t frame_skip = 0;
+};
+
+struct RomResult {
+    std::string status = "not run";  // "ok" or what went wrong
+    uint64_t frames = 0;             // Frames actually completed
+    uint64_t cycles = 0;
+    uint64_t frame_hash = 0;
+    double wall_ms = 0.0;
+};
+
+static RomResult runRom(const std::string& path, const BatchOptions& options) {
+    RomResult result;
+    auto start = std::chrono::steady_clock::now();
+
+    try {
+        Emulator emulator(path, false);
+        GPU& gpu = emulator.getGPU();
+        gpu.setRendererMode(options.renderer);
+        gpu.setFrameSkip(options.frame_skip);
+
+        result.status = "ok";
+        for (; result.frames < options.frames; result.frames++) {
+            // The PPU's frames needn't line up with runFrame()'s, so stop
+            // skipping two frames early to have the final one fully drawn
+            if (result.frames + 2 == options.frames) {
+                gpu.setFrameSkip(0);
+            }
+            if (!emulator.runFrame()) {
+                result.status = "cpu error";
+                break;
+            }
+        }
+        result.cycles = emulator.getCycles();
+        result.frame_hash = emulator.frameHash();
+    } catch (const std::exception& e) {
+        result.status = e.what();
+    }
+
+    result.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+static std::vector<RomResult> runAll(const BatchOptions& options) {
+    std::vector<RomResult> results(options.roms.size());
+    parallelFor(options.roms.size(), options.jobs, [&](size_t i) {
+        results[i] = runRom(options.roms[i], options);
+    });
+    return results;
+}
+
+static std::string hashString(uint64_t hash) {
+    char text[17];
+    std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(hash));
+    return text;
+}
+
+static void printResults(const BatchOptions& options, const std::vector<RomResult>& results) {
+    if (options.json) {
+        std::cout << "[\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const RomResult& r = results[i];
+            std::cout << "  {\"rom\": " << jsonString(options.roms[i])
+                      << ", \"status\": " << jsonString(r.status)
+                      << ", \"frames\": " << r.frames
+                      << ", \"cycles\": " << r.cycles
+                      << ", \"frame_hash\": \"" << hashString(r.frame_hash) << "\""
+                      << ", \"wall_ms\": " << r.wall_ms << "}"
+                      << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        std::cout << "]" << std::endl;
+    } else {
+        std::cout << "rom,status,frames,cycles,frame_hash,wall_ms\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const RomResult& r = results[i];
+            std::cout << csvField(options.roms[i]) << "," << csvField(r.status) << ","
+                      << r.frames << "," << r.cycles << "," << hashString(r.frame_hash) << ","
+                      << r.wall_ms << "\n";
+        }
+        std::cout.flush();
+    }
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <rom>..." << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --list=FILE   Also run the ROMs listed in FILE, one per line" << std::endl;
+    std::cerr << "  --frames=N    Frames to run each ROM for (default 600)" << std::endl;
+    std::cerr << "  --jobs=N      Worker threads (default: one per core)" << std::endl;
+    std::cerr << "  --format=F    Output format: csv (default) or json" << std::endl;
+    std::cerr << "  --renderer=R  Line renderer: scanline (default) or fifo" << std::endl;
+    std::cerr << "  --frame-skip=N Draw one frame in every N+1 (final frames always drawn)" << std::endl;
+}
+
+static bool parseOptions(int argc, char** argv, BatchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        try {
+            if (arg.rfind("--list=", 0) == 0) {
+                if (!readRomList(arg.substr(7), options.roms)) {
+                    return false;
+                }
+            } else if (arg.rfind("--frames=", 0) == 0) {
+                options.frames = std::stoull(arg.substr(9));
+            } else if (arg.rfind("--jobs=", 0) == 0) {
+                options.jobs = static_cast<unsigned>(std::stoul(arg.substr(7)));
+            } else if (arg == "--format=csv") {
+                options.json = false;
+            } else if (arg == "--format=json") {
+                options.json = true;
+            } else if (arg == "--renderer=scanline") {
+                options.renderer = RendererMode::SCANLINE;
+            } else if (arg == "--renderer=fifo") {
+                options.renderer = RendererMode::FIFO;
+            } else if (arg.rfind("--frame-skip=", 0) == 0) {
+                options.frame_skip = static_cast<uint32_t>(std::stoul(arg.substr(13)));
+            } else if (arg.rfind("--", 0) == 0) {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return false;
+            } else {
+                options.roms.push_back(arg);
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid number in: " << arg << std::endl;
+            return false;
+        }
+    }
+
+    if (options.jobs == 0) {
+        options.jobs = defaultJobs();
+    }
+    return !options.roms.empty();
+}
+
+int main(int argc, char** argv) {
+    BatchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // Diagnostics from many emulators at once would only interleave with the results
+    setLogMask(0);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<RomResult> results = runAll(options);
+    double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    printResults(options, results);
+
+    // Summary on stderr so stdout stays machine-readable
+    double busy_ms = 0.0;
+    size_t failed = 0;
+    for (const RomResult& r : results) {
+        busy_ms += r.wall_ms;
+        failed += r.status != "ok";
+    }
+    std::cerr << results.size() << " ROMs, " << failed << " failed, " << options.jobs << " jobs, "
+              << wall_ms << " ms (" << (wall_ms > 0 ? busy_ms / wall_ms : 0.0) << "x parallel)" << std::endl;
+
+    return failed == 0 ? 0 : 2;
+}
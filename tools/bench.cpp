@@ -0,0 +1,443 @@
+// Emulation throughput benchmark. Runs deterministic workloads headless and
+// reports emulated MHz, frames per second and nanoseconds per instruction,
+// split between the CPU, PPU and timer, plus the cost of memory bus accesses.
+//
+// Usage: gb-bench [options] [rom...]
+//   --frames=N     Frames per workload (default 600)
+//   --runs=N       Runs per workload, the fastest is reported (default 3)
+//   --format=F     text (default), csv or json
+//   --no-idle-skip Step through HALT and polling loops instead of skipping
+//                  them (see CPU::setIdleSkip), for comparison
+//   --frame-skip=N Draw only one frame in every N+1 (see GPU::setFrameSkip),
+//                  as turbo does
+//
+// Built-in workloads (ROMs generated below, so results don't depend on files):
+//   cpu            ALU, load/store and call-heavy loop with the LCD off
+//   alu            Register-only ALU stream (flags set on every instruction,
+//                  rarely read) with the LCD off
+//   ppu-sprites    HALTed CPU, LCD on with scrolling BG, window and 40 8x16
+//                  sprites (10 on each of 64 lines), scanline renderer
+//   ppu-sprites-fifo  The same scene drawn by the pixel FIFO renderer
+//   ppu-poll       The same scene with the CPU polling LY for VBlank instead
+//                  of halting, as many games do
+// Every ROM on the command line is run as another workload.
+//
+// PPU and timer time is measured around their scheduler events; what's left
+// is the CPU, including the bus accesses it makes inline. The bus is timed
+// separately by a loop of reads and writes on each path of MemoryBus.
+
+#include "emulator.hpp"
+#include "cpu.hpp"
+#include "memory.hpp"
+#include "scheduler.hpp"
+#include "timer.hpp"
+#include "pixel_kernels.hpp"
+#include "log.hpp"
+#include "rom_builder.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <initializer_list>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// Real DMG clock, for the speed relative to hardware
+constexpr double GB_CLOCK_HZ = 4194304.0;
+
+// Keeps the optimizer from dropping the bus loop results
+static volatile uint32_t sink;
+
+// ROM GENERATION
+
+static std::vector<uint8_t> buildCpuRom() {
+    RomBuilder b;
+    b.emit({0xF3});              // DI
+    b.emit({0xAF, 0xE0, 0x40});  // XOR A; LDH (LCDC),A - LCD off
+    b.emit({0x31, 0xFF, 0xDF});  // LD SP,$DFFF
+
+    uint16_t outer = b.here();
+    b.emit({0x21, 0x00, 0xC0});  // LD HL,$C000
+    b.emit({0x01, 0x00, 0x00});  // LD BC,0 - 65536 inner iterations
+
+    uint16_t inner = b.here();
+    b.emit({0x7E});              // LD A,(HL)
+    b.emit({0x80});              // ADD A,B
+    b.emit({0xA9});              // XOR C
+    b.emit({0x07});              // RLCA
+    b.emit({0x22});              // LD (HL+),A
+    b.emit({0x57});              // LD D,A
+    b.emit({0x7C, 0xE6, 0x0F});  // LD A,H; AND $0F
+    b.emit({0xF6, 0xC0, 0x67});  // OR $C0; LD H,A - keep HL in $C000-$CFFF
+    uint16_t call = b.here();
+    b.emit({0xCD, 0x00, 0x00});  // CALL mix
+    b.emit({0x0D});              // DEC C
+    b.jr(0x20, inner);           // JR NZ,inner
+    b.emit({0x05});              // DEC B
+    b.jr(0x20, inner);           // JR NZ,inner
+    b.jr(0x18, outer);           // JR outer
+
+    // mix: some CB-prefixed ops and 16-bit arithmetic
+    b.patch16(call + 1, b.here());
+    b.emit({0xD5});              // PUSH DE
+    b.emit({0x7A});              // LD A,D
+    b.emit({0xCB, 0x37});        // SWAP A
+    b.emit({0xCB, 0x3F});        // SRL A
+    b.emit({0xCB, 0x5F});        // BIT 3,A
+    b.emit({0x8B});              // ADC A,E
+    b.emit({0x5F});              // LD E,A
+    b.emit({0x13});              // INC DE
+    b.emit({0xD1});              // POP DE
+    b.emit({0xC9});              // RET
+
+    return b.finish("BENCH CPU");
+}
+
+// Register-only ALU stream: every instruction sets flags, few read them, as in
+// the arithmetic-heavy inner loops of games
+static std::vector<uint8_t> buildAluRom() {
+    RomBuilder b;
+    b.emit({0xF3});              // DI
+    b.emit({0xAF, 0xE0, 0x40});  // XOR A; LDH (LCDC),A - LCD off
+    b.emit({0x31, 0xFF, 0xDF});  // LD SP,$DFFF
+    b.emit({0x11, 0x35, 0x7A});  // LD DE,$7A35
+    b.emit({0x21, 0x9C, 0x4E});  // LD HL,$4E9C
+
+    uint16_t outer = b.here();
+    b.emit({0x01, 0x00, 0x00});  // LD BC,0 - 65536 inner iterations
+
+    uint16_t inner = b.here();
+    b.emit({0x80, 0x89, 0x92});  // ADD A,B; ADC A,C; SUB D
+    b.emit({0x9B, 0xAC, 0x14});  // SBC A,E; XOR H; INC D
+    b.emit({0xA5, 0xB0, 0xBB});  // AND L; OR B; CP E
+    b.emit({0x1D, 0x82, 0x27});  // DEC E; ADD A,D; DAA
+    b.emit({0x17, 0x8C, 0x24});  // RLA; ADC A,H; INC H
+    b.emit({0x9D, 0x0F});        // SBC A,L; RRCA
+    b.emit({0xCB, 0x15});        // RL L
+    b.emit({0xD6, 0x37});        // SUB $37
+    b.emit({0x2C, 0x29});        // INC L; ADD HL,HL
+    b.emit({0x0D});              // DEC C
+    b.jr(0x20, inner);           // JR NZ,inner
+    b.emit({0xF5, 0xF1});        // PUSH AF; POP AF
+    b.emit({0x05});              // DEC B
+    b.jr(0x20, inner);           // JR NZ,inner
+    b.jr(0x18, outer);           // JR outer
+
+    return b.finish("BENCH ALU");
+}
+
+// With poll_ly the CPU waits for VBlank by polling LY instead of halting
+// WORKLOADS
+
+struct Workload {
+    std::string name;
+    std::vector<uint8_t> rom;  // Empty = load rom_path
+    std::string rom_path;
+    RendererMode renderer = RendererMode::SCANLINE;
+};
+
+struct WorkloadResult {
+    std::string name;
+    std::string error;      // Empty on success
+    uint64_t frames = 0;
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint64_t skipped_cycles = 0;  // Idle time fast-forwarded
+    double wall_ns = 0.0;
+    double ppu_ns = 0.0;
+    double timer_ns = 0.0;
+
+    double seconds() const { return wall_ns * 1e-9; }
+    double emulatedMHz() const { return cycles / seconds() / 1e6; }
+    double fps() const { return frames / seconds(); }
+    double speed() const { return cycles / seconds() / GB_CLOCK_HZ; }
+    double perInstruction(double ns) const { return instructions ? ns / instructions : 0.0; }
+    double cpuNs() const { return std::max(0.0, wall_ns - ppu_ns - timer_ns); }
+    double idlePercent() const { return cycles ? 100.0 * skipped_cycles / cycles : 0.0; }
+};
+
+// Average cost of one Clock::now() call, taken off every timed event
+static double clockOverheadNs() {
+    constexpr int samples = 100000;
+    auto start = Clock::now();
+    for (int i = 0; i < samples; i++) {
+        sink = static_cast<uint32_t>(Clock::now().time_since_epoch().count());
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / samples;
+}
+
+static WorkloadResult runWorkload(const Workload& workload, uint64_t frames, bool idle_skip, uint32_t frame_skip,
+                                  double clock_overhead) {
+    WorkloadResult result;
+    result.name = workload.name;
+
+    try {
+        std::unique_ptr<Emulator> owner = workload.rom.empty()
+            ? std::make_unique<Emulator>(workload.rom_path, false)
+            : std::make_unique<Emulator>(workload.rom);
+        Emulator& emulator = *owner;
+        GPU& gpu = emulator.getGPU();
+        Timer& timer = emulator.getTimer();
+        Scheduler& scheduler = emulator.getScheduler();
+        gpu.setRendererMode(workload.renderer);
+        gpu.setFrameSkip(frame_skip);
+        emulator.getCPU().setIdleSkip(idle_skip);
+
+        // Time the PPU and timer at their scheduler events
+        double ppu_ns = 0.0;
+        double timer_ns = 0.0;
+        uint64_t ppu_events = 0;
+        uint64_t timer_events = 0;
+        scheduler.setHandler(EventType::PPU_MODE, [&](uint64_t now) {
+            auto start = Clock::now();
+            gpu.sync(now);
+            ppu_ns += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            ppu_events++;
+        });
+        scheduler.setHandler(EventType::TIMER_OVERFLOW, [&](uint64_t now) {
+            auto start = Clock::now();
+            timer.sync(now);
+            timer_ns += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            timer_events++;
+        });
+
+        uint64_t start_cycles = emulator.getCycles();
+        uint64_t start_instructions = emulator.getCPU().getInstructionCount();
+        uint64_t start_skipped = emulator.getCPU().getSkippedCycles();
+        auto start = Clock::now();
+        for (uint64_t frame = 0; frame < frames; frame++) {
+            if (!emulator.runFrame()) {
+                result.error = "cpu error";
+                break;
+            }
+            result.frames++;
+        }
+        result.wall_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+        result.cycles = emulator.getCycles() - start_cycles;
+        result.instructions = emulator.getCPU().getInstructionCount() - start_instructions;
+        result.skipped_cycles = emulator.getCPU().getSkippedCycles() - start_skipped;
+
+        // Each timed event also paid for roughly one clock read
+        result.ppu_ns = std::max(0.0, ppu_ns - ppu_events * clock_overhead);
+        result.timer_ns = std::max(0.0, timer_ns - timer_events * clock_overhead);
+    } catch (const std::exception& e) {
+        result.error = e.what();
+    }
+
+    return result;
+}
+
+// BUS
+
+struct BusResult {
+    const char* name;
+    double ns;  // Per access
+};
+
+static std::vector<BusResult> benchBus() {
+    // The CPU ROM leaves the LCD off, so VRAM and OAM are always accessible
+    Emulator emulator(buildCpuRom());
+    MemoryBus& memory = emulator.getMemory();
+    emulator.runFrame();
+
+    constexpr uint32_t accesses = 1u << 24;
+    static const uint16_t io_registers[8] = {0xFF04, 0xFF05, 0xFF40, 0xFF41, 0xFF42, 0xFF44, 0xFF47, 0xFF0F};
+
+    // Two passes of each, keeping the faster, so a cold cache or a preempted
+    // pass doesn't skew the figure
+    auto time = [&](const char* name, auto access) {
+        double best = 0.0;
+        for (int pass = 0; pass < 2; pass++) {
+            auto start = Clock::now();
+            uint32_t sum = 0;
+            for (uint32_t i = 0; i < accesses; i++) {
+                sum += access(i * 0x9E37u);
+            }
+            sink = sum;
+            double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            best = pass == 0 ? ns : std::min(best, ns);
+        }
+        return BusResult{name, best / accesses};
+    };
+
+    std::vector<BusResult> results;
+    results.push_back(time("read_rom", [&](uint32_t x) { return memory.read(x & 0x7FFF); }));
+    results.push_back(time("read_wram", [&](uint32_t x) { return memory.read(0xC000 | (x & 0x1FFF)); }));
+    results.push_back(time("read_io", [&](uint32_t x) { return memory.read(io_registers[x & 7]); }));
+    results.push_back(time("write_wram", [&](uint32_t x) {
+        memory.write(0xC000 | (x & 0x1FFF), static_cast<uint8_t>(x));
+        return 0u;
+    }));
+    results.push_back(time("write_vram", [&](uint32_t x) {
+        memory.write(0x8000 | (x & 0x17FF), static_cast<uint8_t>(x));
+        return 0u;
+    }));
+    return results;
+}
+
+// OUTPUT
+
+static void printText(const std::vector<WorkloadResult>& results, const std::vector<BusResult>& bus) {
+    std::cout << "Pixel kernels: " << pixelKernelName() << "\n\n";
+    std::cout << std::left << std::setw(20) << "workload" << std::right
+              << std::setw(8) << "MHz" << std::setw(9) << "fps" << std::setw(8) << "speed"
+              << std::setw(11) << "ns/instr" << std::setw(10) << "cpu" << std::setw(10) << "ppu"
+              << std::setw(8) << "timer" << std::setw(7) << "idle" << "\n";
+    std::cout << std::fixed;
+    for (const WorkloadResult& r : results) {
+        std::cout << std::left << std::setw(20) << r.name << std::right;
+        if (!r.error.empty()) {
+            std::cout << "  " << r.error << "\n";
+            continue;
+        }
+        std::cout << std::setprecision(1) << std::setw(8) << r.emulatedMHz() << std::setw(9) << r.fps()
+                  << std::setw(7) << r.speed() << "x" << std::setprecision(2)
+                  << std::setw(11) << r.perInstruction(r.wall_ns) << std::setw(10) << r.perInstruction(r.cpuNs())
+                  << std::setw(10) << r.perInstruction(r.ppu_ns) << std::setw(8) << r.perInstruction(r.timer_ns)
+                  << std::setprecision(1) << std::setw(6) << r.idlePercent() << "%\n";
+    }
+    std::cout << "\nMemory bus (ns/access):";
+    for (const BusResult& b : bus) {
+        std::cout << "  " << b.name << " " << std::setprecision(2) << b.ns;
+    }
+    std::cout << std::endl;
+}
+
+// One "workload,metric,value" row per number, easy to load anywhere
+static void printCsv(const std::vector<WorkloadResult>& results, const std::vector<BusResult>& bus) {
+    std::cout << "workload,metric,value\n";
+    std::cout << std::setprecision(6);
+    for (const WorkloadResult& r : results) {
+        if (!r.error.empty()) {
+            std::cout << r.name << ",error,\"" << r.error << "\"\n";
+            continue;
+        }
+        std::cout << r.name << ",frames," << r.frames << "\n"
+                  << r.name << ",cycles," << r.cycles << "\n"
+                  << r.name << ",instructions," << r.instructions << "\n"
+                  << r.name << ",wall_ms," << r.wall_ns * 1e-6 << "\n"
+                  << r.name << ",emulated_mhz," << r.emulatedMHz() << "\n"
+                  << r.name << ",fps," << r.fps() << "\n"
+                  << r.name << ",ns_per_instr," << r.perInstruction(r.wall_ns) << "\n"
+                  << r.name << ",cpu_ns_per_instr," << r.perInstruction(r.cpuNs()) << "\n"
+                  << r.name << ",ppu_ns_per_instr," << r.perInstruction(r.ppu_ns) << "\n"
+                  << r.name << ",timer_ns_per_instr," << r.perInstruction(r.timer_ns) << "\n"
+                  << r.name << ",idle_skipped_pct," << r.idlePercent() << "\n";
+    }
+    for (const BusResult& b : bus) {
+        std::cout << "bus," << b.name << "_ns," << b.ns << "\n";
+    }
+    std::cout.flush();
+}
+
+static void printJson(const std::vector<WorkloadResult>& results, const std::vector<BusResult>& bus) {
+    std::cout << std::setprecision(6);
+    std::cout << "{\n  \"pixel_kernels\": \"" << pixelKernelName() << "\",\n  \"workloads\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const WorkloadResult& r = results[i];
+        std::cout << "    {\"name\": \"" << r.name << "\"";
+        if (!r.error.empty()) {
+            std::cout << ", \"error\": \"" << r.error << "\"";
+        } else {
+            std::cout << ", \"frames\": " << r.frames << ", \"cycles\": " << r.cycles
+                      << ", \"instructions\": " << r.instructions << ", \"wall_ms\": " << r.wall_ns * 1e-6
+                      << ", \"emulated_mhz\": " << r.emulatedMHz() << ", \"fps\": " << r.fps()
+                      << ", \"ns_per_instr\": " << r.perInstruction(r.wall_ns)
+                      << ", \"cpu_ns_per_instr\": " << r.perInstruction(r.cpuNs())
+                      << ", \"ppu_ns_per_instr\": " << r.perInstruction(r.ppu_ns)
+                      << ", \"timer_ns_per_instr\": " << r.perInstruction(r.timer_ns)
+                      << ", \"idle_skipped_pct\": " << r.idlePercent();
+        }
+        std::cout << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    std::cout << "  ],\n  \"bus_ns_per_access\": {";
+    for (size_t i = 0; i < bus.size(); i++) {
+        std::cout << (i ? ", " : "") << "\"" << bus[i].name << "\": " << bus[i].ns;
+    }
+    std::cout << "}\n}" << std::endl;
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] [rom...]" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --frames=N    Frames per workload (default 600)" << std::endl;
+    std::cerr << "  --runs=N      Runs per workload, fastest reported (default 3)" << std::endl;
+    std::cerr << "  --format=F    Output format: text (default), csv or json" << std::endl;
+    std::cerr << "  --no-idle-skip Step through HALT and polling loops, for comparison" << std::endl;
+    std::cerr << "  --frame-skip=N Draw one frame in every N+1, as turbo does" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    uint64_t frames = 600;
+    int runs = 3;
+    std::string format = "text";
+    bool idle_skip = true;
+    uint32_t frame_skip = 0;
+
+    std::vector<Workload> workloads;
+    workloads.push_back({"cpu", buildCpuRom(), "", RendererMode::SCANLINE});
+    workloads.push_back({"alu", buildAluRom(), "", RendererMode::SCANLINE});
+    workloads.push_back({"ppu-sprites", buildSpriteRom(false), "", RendererMode::SCANLINE});
+    workloads.push_back({"ppu-sprites-fifo", buildSpriteRom(false), "", RendererMode::FIFO});
+    workloads.push_back({"ppu-poll", buildSpriteRom(true), "", RendererMode::SCANLINE});
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        try {
+            if (arg.rfind("--frames=", 0) == 0) {
+                frames = std::stoull(arg.substr(9));
+            } else if (arg.rfind("--runs=", 0) == 0) {
+                runs = std::max(1, std::stoi(arg.substr(7)));
+            } else if (arg == "--format=text" || arg == "--format=csv" || arg == "--format=json") {
+                format = arg.substr(9);
+            } else if (arg == "--no-idle-skip") {
+                idle_skip = false;
+            } else if (arg.rfind("--frame-skip=", 0) == 0) {
+                frame_skip = static_cast<uint32_t>(std::stoul(arg.substr(13)));
+            } else if (arg.rfind("--", 0) == 0) {
+                printUsage(argv[0]);
+                return 1;
+            } else {
+                workloads.push_back({arg, {}, arg, RendererMode::SCANLINE});
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid number in: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    setLogMask(0);
+    double clock_overhead = clockOverheadNs();
+
+    std::vector<WorkloadResult> results;
+    for (const Workload& workload : workloads) {
+        WorkloadResult best;
+        for (int run = 0; run < runs; run++) {
+            WorkloadResult result = runWorkload(workload, frames, idle_skip, frame_skip, clock_overhead);
+            if (run == 0 || (result.error.empty() && result.wall_ns < best.wall_ns)) {
+                best = result;
+            }
+        }
+        results.push_back(best);
+    }
+    std::vector<BusResult> bus = benchBus();
+
+    if (format == "csv") {
+        printCsv(results, bus);
+    } else if (format == "json") {
+        printJson(results, bus);
+    } else {
+        printText(results, bus);
+    }
+
+    bool failed = std::any_of(results.begin(), results.end(),
+                              [](const WorkloadResult& r) { return !r.error.empty(); });
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,140 @@
+// Interrupt timing check. Runs a ROM that arms the timer and then waits for
+// its interrupt, alternately in HALT and in a loop polling a RAM flag the
+// handler sets, with the CPU's idle fast-forward on and then off. The handler
+// logs TIMA, so an interrupt taken even a few cycles late shows up in the log.
+// Both runs must log the same values and end on the same cycle.
+//
+// Usage: gb-interrupt-test [options]
+//   --frames=N     Frames run each way (default 60)
+//
+// Exits with 1 if the two runs differ.
+
+#include "emulator.hpp"
+#include "cpu.hpp"
+#include "memory.hpp"
+#include "log.hpp"
+#include "rom_builder.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+constexpr uint16_t LOG_START = 0xC000;  // TIMA as seen by each interrupt
+constexpr uint16_t LOG_END = 0xD000;    // Also the flag the polling loop waits on
+
+// The timer is restarted from a different TIMA value each time (from L, so
+// 64 to 1024 cycles away), which puts the overflow at every point between
+// the scanline events the run was sliced at before the write
+static std::vector<uint8_t> buildTimerRom() {
+    RomBuilder b;
+
+    // Timer handler: log TIMA and set the flag
+    b.org(0x50);
+    b.emit({0xF0, 0x05, 0x22});        // LDH A,(TIMA); LD (HL+),A
+    b.emit({0x3E, 0x01, 0xEA, 0x00, 0xD0});  // LD A,1; LD ($D000),A
+    b.emit({0xD9});                    // RETI
+
+    b.org(0x150);
+    b.emit({0xF3});                    // DI
+    b.emit({0x31, 0xFF, 0xDF});        // LD SP,$DFFF
+    b.emit({0x21, 0x00, 0xC0});        // LD HL,$C000
+    b.emit({0x3E, 0x04, 0xE0, 0xFF});  // IE = timer
+    b.emit({0x3E, 0x05, 0xE0, 0x07});  // TAC: on, 16 cycles per tick
+
+    uint16_t loop = b.here();
+
+    // Wait in HALT
+    b.emit({0xAF, 0xE0, 0x0F});        // XOR A; LDH (IF),A
+    b.emit({0x7D, 0xF6, 0xC0, 0xE0, 0x05});  // LD A,L; OR $C0; LDH (TIMA),A
+    b.emit({0xFB, 0x76, 0x00, 0xF3});  // EI; HALT; NOP; DI
+
+    // Wait polling the flag
+    b.emit({0xAF, 0xEA, 0x00, 0xD0});  // XOR A; LD ($D000),A
+    b.emit({0xE0, 0x0F});              // LDH (IF),A
+    b.emit({0x7D, 0xF6, 0xC0, 0xE0, 0x05});  // LD A,L; OR $C0; LDH (TIMA),A
+    b.emit({0xFB});                    // EI
+    uint16_t poll = b.here();
+    b.emit({0xFA, 0x00, 0xD0, 0xA7});  // LD A,($D000); AND A
+    b.jr(0x28, poll);                  // JR Z,poll
+    b.emit({0xF3});                    // DI
+
+    // Start the log over once it's full
+    b.emit({0x7C, 0xFE, 0xD0});        // LD A,H; CP $D0
+    b.jr(0x20, loop);                  // JR NZ,loop
+    b.emit({0x21, 0x00, 0xC0});        // LD HL,$C000
+    b.jr(0x18, loop);                  // JR loop
+
+    return b.finish("IRQ TIMING");
+}
+
+struct TimingRun {
+    std::vector<uint8_t> log;
+    uint64_t cycles;
+    uint64_t skipped;
+};
+
+static TimingRun run(const std::vector<uint8_t>& rom, bool idle_skip, int frames) {
+    Emulator emulator(rom);
+    emulator.getCPU().setIdleSkip(idle_skip);
+    for (int i = 0; i < frames; i++) {
+        emulator.runFrame();
+    }
+
+    TimingRun result;
+    for (uint16_t addr = LOG_START; addr < LOG_END; addr++) {
+        result.log.push_back(emulator.getMemory().read(addr));
+    }
+    result.cycles = emulator.getCycles();
+    result.skipped = emulator.getCPU().getSkippedCycles();
+    return result;
+}
+
+int main(int argc, char** argv) {
+    int frames = 60;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--frames=", 0) == 0) {
+            frames = std::max(1, std::atoi(arg.c_str() + 9));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--frames=N]" << std::endl;
+            return 2;
+        }
+    }
+
+    setLogMask(0);
+
+    try {
+        std::vector<uint8_t> rom = buildTimerRom();
+        TimingRun skipped = run(rom, true, frames);
+        TimingRun stepped = run(rom, false, frames);
+
+        int problems = 0;
+        if (skipped.skipped == 0) {
+            std::cerr << "idle skip never kicked in" << std::endl;
+            problems++;
+        }
+        if (skipped.cycles != stepped.cycles) {
+            std::cerr << "ended on cycle " << skipped.cycles << " with idle skip, "
+                      << stepped.cycles << " without" << std::endl;
+            problems++;
+        }
+        for (size_t i = 0; i < skipped.log.size(); i++) {
+            if (skipped.log[i] != stepped.log[i]) {
+                std::cerr << "interrupt " << i << ": TIMA " << int(skipped.log[i]) << " with idle skip, "
+                          << int(stepped.log[i]) << " without" << std::endl;
+                problems++;
+                break;
+            }
+        }
+
+        std::cout << frames << " frames, " << skipped.skipped << " cycles skipped: "
+                  << (problems == 0 ? "passed" : "timing differs") << std::endl;
+        return problems == 0 ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
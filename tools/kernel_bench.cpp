@@ -0,0 +1,130 @@
+// Microbenchmark for the PPU pixel kernels (see pixel_kernels.hpp).
+// Runs every compiled-in kernel over the same random data, checks that it
+// matches the scalar output and reports the time per pixel.
+//
+// Usage: gb-kernel-bench [iterations]
+
+#include "pixel_kernels.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using DecodeKernel = void (*)(const uint8_t*, int, uint8_t*);
+using PaletteKernel = void (*)(const uint8_t*, const uint32_t*, uint32_t*, int);
+
+struct DecodeVariant {
+    const char* name;
+    DecodeKernel kernel;
+};
+
+struct PaletteVariant {
+    const char* name;
+    PaletteKernel kernel;
+};
+
+// All 384 tiles of VRAM tile data, decoded as a whole
+constexpr int TILE_ROWS = 384 * 8;
+
+// One frame of background indices, converted a line at a time like the renderer does
+constexpr int LINE_WIDTH = 160;
+constexpr int FRAME_LINES = 144;
+
+// Keeps the optimizer from dropping the kernels' output
+static volatile uint32_t sink;
+
+template <typename Fn>
+static double timeNs(Fn fn, int iterations) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        fn();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 2000;
+    if (iterations <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [iterations]" << std::endl;
+        return 1;
+    }
+    
+    std::mt19937 rng(12345);
+    std::vector<uint8_t> tile_data(TILE_ROWS * 2);
+    std::vector<uint8_t> indices(LINE_WIDTH * FRAME_LINES);
+    for (auto& byte : tile_data) byte = static_cast<uint8_t>(rng());
+    for (auto& index : indices) index = static_cast<uint8_t>(rng() & 0x03);
+    const uint32_t colors[4] = {0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555, 0xFF000000};
+    
+    std::vector<DecodeVariant> decoders = {{"scalar", decodeTileRowsScalar}};
+    std::vector<PaletteVariant> palettes = {{"scalar", applyPaletteScalar}};
+#if defined(__SSE2__)
+    decoders.push_back({"sse2", decodeTileRowsSSE2});
+    palettes.push_back({"sse2", applyPaletteSSE2});
+#endif
+#if defined(__AVX2__)
+    decoders.push_back({"avx2", decodeTileRowsAVX2});
+    palettes.push_back({"avx2", applyPaletteAVX2});
+#endif
+    
+    std::cout << "Default kernels: " << pixelKernelName() << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    bool all_match = true;
+    
+    // Tile row decode
+    std::vector<uint8_t> expected_rows(TILE_ROWS * 8);
+    std::vector<uint8_t> rows(TILE_ROWS * 8);
+    decodeTileRowsScalar(tile_data.data(), TILE_ROWS, expected_rows.data());
+    double scalar_decode_ns = 0.0;
+    
+    for (const auto& variant : decoders) {
+        std::memset(rows.data(), 0xFF, rows.size());
+        variant.kernel(tile_data.data(), TILE_ROWS, rows.data());
+        bool match = rows == expected_rows;
+        all_match = all_match && match;
+        
+        double ns = timeNs([&] {
+            variant.kernel(tile_data.data(), TILE_ROWS, rows.data());
+            sink = sink + rows[0];
+        }, iterations) / (static_cast<double>(iterations) * TILE_ROWS * 8);
+        if (scalar_decode_ns == 0.0) scalar_decode_ns = ns;
+        
+        std::cout << "decodeTileRows  " << std::setw(6) << variant.name << ": "
+                  << ns << " ns/pixel (" << std::setprecision(2) << scalar_decode_ns / ns << "x)"
+                  << std::setprecision(3) << (match ? "" : "  MISMATCH") << std::endl;
+    }
+    
+    // Palette application into a frame buffer
+    std::vector<uint32_t> expected_frame(LINE_WIDTH * FRAME_LINES);
+    std::vector<uint32_t> frame(LINE_WIDTH * FRAME_LINES);
+    applyPaletteScalar(indices.data(), colors, expected_frame.data(), LINE_WIDTH * FRAME_LINES);
+    double scalar_palette_ns = 0.0;
+    
+    for (const auto& variant : palettes) {
+        auto run_frame = [&] {
+            for (int line = 0; line < FRAME_LINES; line++) {
+                variant.kernel(&indices[line * LINE_WIDTH], colors, &frame[line * LINE_WIDTH], LINE_WIDTH);
+            }
+            sink = sink + frame[0];
+        };
+        
+        std::fill(frame.begin(), frame.end(), 0);
+        run_frame();
+        bool match = frame == expected_frame;
+        all_match = all_match && match;
+        
+        double ns = timeNs(run_frame, iterations) / (static_cast<double>(iterations) * LINE_WIDTH * FRAME_LINES);
+        if (scalar_palette_ns == 0.0) scalar_palette_ns = ns;
+        
+        std::cout << "applyPalette    " << std::setw(6) << variant.name << ": "
+                  << ns << " ns/pixel (" << std::setprecision(2) << scalar_palette_ns / ns << "x)"
+                  << std::setprecision(3) << (match ? "" : "  MISMATCH") << std::endl;
+    }
+    
+    return all_match ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+// Rewind regression check. Records snapshots with a RewindBuffer while the
+// LCD is switched off and back on at different points of a frame, which moves
+// the frame boundaries onto lines with sprites on them, then steps all the
+// way back and checks every frame comes back byte for byte.
+//
+// Usage: gb-rewind-test [options]
+//   --frames=N     Frames recorded after each LCD phase shift (default 90)
+//
+// Exits with 1 if any frame was dropped or restored wrongly.
+
+#include "emulator.hpp"
+#include "memory.hpp"
+#include "rewind.hpp"
+#include "savestate.hpp"
+#include "log.hpp"
+#include "rom_builder.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+constexpr uint16_t LCDC_REG = 0xFF40;
+constexpr uint8_t LCDC_ON = 0xF7;   // What the sprite ROM sets
+constexpr uint8_t LCDC_OFF = 0x77;
+constexpr int LINES_PER_FRAME = 154;
+constexpr int PHASE_STEP = 7;       // Lines between tested phases
+
+// Turn the LCD off for `lines` lines plus a few cycles, so it comes back on
+// at a different point relative to the emulator's frames
+static void shiftLcdPhase(Emulator& emulator, int lines) {
+    emulator.getMemory().write(LCDC_REG, LCDC_OFF);
+    emulator.runUntil(emulator.getCycles() + 456 * lines + 40);
+    emulator.getMemory().write(LCDC_REG, LCDC_ON);
+}
+
+static std::vector<uint8_t> takeSnapshot(SaveState& state) {
+    std::vector<uint8_t> data(state.size());
+    data.resize(state.snapshot(data.data(), data.size()));
+    return data;
+}
+
+// Returns the number of problems found
+static int checkPhase(int lines, int frames) {
+    Emulator emulator(buildSpriteRom(false));
+    SaveState& state = emulator.getSaveState();
+    for (int i = 0; i < 5; i++) {
+        emulator.runFrame();
+    }
+
+    // Large enough that nothing is evicted
+    RewindBuffer rewind(state, 64u << 20, 30);
+    std::vector<std::vector<uint8_t>> recorded;
+    int problems = 0;
+
+    shiftLcdPhase(emulator, lines);
+    for (int i = 0; i < frames; i++) {
+        emulator.runFrame();
+        rewind.push();
+        recorded.push_back(takeSnapshot(state));
+        if (recorded.back().empty()) {
+            std::cerr << "phase " << lines << ": snapshot of frame " << i << " failed" << std::endl;
+            problems++;
+        }
+    }
+
+    if (rewind.droppedFrames() != 0 || rewind.frameCount() != recorded.size()) {
+        std::cerr << "phase " << lines << ": recorded " << rewind.frameCount() << " of "
+                  << recorded.size() << " frames, " << rewind.droppedFrames() << " dropped" << std::endl;
+        return problems + 1;
+    }
+
+    // Each stepBack() restores the frame before the newest one left
+    for (size_t i = recorded.size() - 1; i > 0; i--) {
+        if (!rewind.stepBack()) {
+            std::cerr << "phase " << lines << ": stepping back to frame " << i - 1 << " failed" << std::endl;
+            return problems + 1;
+        }
+        if (takeSnapshot(state) != recorded[i - 1]) {
+            std::cerr << "phase " << lines << ": frame " << i - 1 << " restored wrongly" << std::endl;
+            problems++;
+        }
+    }
+    return problems;
+}
+
+int main(int argc, char** argv) {
+    int frames = 90;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--frames=", 0) == 0) {
+            frames = std::max(2, std::atoi(arg.c_str() + 9));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--frames=N]" << std::endl;
+            return 2;
+        }
+    }
+
+    setLogMask(0);
+
+    int problems = 0;
+    int phases = 0;
+    try {
+        for (int lines = 0; lines < LINES_PER_FRAME; lines += PHASE_STEP) {
+            problems += checkPhase(lines, frames);
+            phases++;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << phases << " LCD phases, " << frames << " frames each: "
+              << (problems == 0 ? "passed" : std::to_string(problems) + " problems") << std::endl;
+    return problems == 0 ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// ROMs generated in code for the tools, so benchmarks and checks don't
+// depend on ROM files.
+
+// Minimal assembler: raw opcodes plus the helpers needed for labels
+class RomBuilder {
+public:
+    RomBuilder() : rom(0x8000, 0x00) {
+        // Entry point: NOP; JP $0150
+        org(0x100);
+        emit({0x00, 0xC3, 0x50, 0x01});
+        org(0x150);
+    }
+
+    void org(uint16_t address) { pc = address; }
+    uint16_t here() const { return pc; }
+
+    void emit(std::initializer_list<uint8_t> bytes) {
+        for (uint8_t byte : bytes) {
+            rom[pc++] = byte;
+        }
+    }
+
+    // JR-style opcode (JR, JR NZ, ...) to a label
+    void jr(uint8_t opcode, uint16_t target) {
+        int offset = static_cast<int>(target) - (pc + 2);
+        emit({opcode, static_cast<uint8_t>(offset)});
+    }
+
+    void patch16(uint16_t address, uint16_t value) {
+        rom[address] = static_cast<uint8_t>(value);
+        rom[address + 1] = static_cast<uint8_t>(value >> 8);
+    }
+
+    // Fill in the header: title, ROM only, 32KB, header checksum
+    std::vector<uint8_t> finish(const std::string& title) {
+        for (size_t i = 0; i < title.size() && i < 15; i++) {
+            rom[0x134 + i] = static_cast<uint8_t>(title[i]);
+        }
+        uint8_t checksum = 0;
+        for (int i = 0x134; i <= 0x14C; i++) {
+            checksum = checksum - rom[i] - 1;
+        }
+        rom[0x14D] = checksum;
+        return rom;
+    }
+
+private:
+    std::vector<uint8_t> rom;
+    uint16_t pc = 0;
+};
+
+// Scrolling background, a window and 40 8x16 sprites (10 on each of 64
+// lines). The CPU either HALTs between VBlank interrupts or, with poll_ly,
+// polls LY for VBlank as many games do
+inline std::vector<uint8_t> buildSpriteRom(bool poll_ly) {
+    RomBuilder b;
+
+    // VBlank handler: scroll the background one pixel per frame
+    b.org(0x40);
+    b.emit({0xF0, 0x43, 0x3C, 0xE0, 0x43});  // LDH A,(SCX); INC A; LDH (SCX),A
+    b.emit({0xD9});                          // RETI
+
+    b.org(0x150);
+    b.emit({0xF3});              // DI
+    b.emit({0x31, 0xFF, 0xDF});  // LD SP,$DFFF
+    b.emit({0xAF, 0xE0, 0x40});  // XOR A; LDH (LCDC),A - LCD off while VRAM is filled
+
+    // Tile data $8000-$97FF: a pattern that differs from tile to tile
+    b.emit({0x21, 0x00, 0x80});  // LD HL,$8000
+    b.emit({0x01, 0x00, 0x18});  // LD BC,$1800
+    uint16_t tiles = b.here();
+    b.emit({0x7D, 0xAC, 0x07});  // LD A,L; XOR H; RLCA
+    b.emit({0x22, 0x0B});        // LD (HL+),A; DEC BC
+    b.emit({0x78, 0xB1});        // LD A,B; OR C
+    b.jr(0x20, tiles);           // JR NZ,tiles
+
+    // Both tile maps $9800-$9FFF
+    b.emit({0x21, 0x00, 0x98});  // LD HL,$9800
+    b.emit({0x01, 0x00, 0x08});  // LD BC,$0800
+    uint16_t maps = b.here();
+    b.emit({0x7D, 0x84});        // LD A,L; ADD A,H
+    b.emit({0x22, 0x0B});        // LD (HL+),A; DEC BC
+    b.emit({0x78, 0xB1});        // LD A,B; OR C
+    b.jr(0x20, maps);            // JR NZ,maps
+
+    // OAM from the table at $1000
+    b.emit({0x21, 0x00, 0xFE});  // LD HL,$FE00
+    b.emit({0x11, 0x00, 0x10});  // LD DE,$1000
+    b.emit({0x06, 0xA0});        // LD B,160
+    uint16_t oam = b.here();
+    b.emit({0x1A, 0x13});        // LD A,(DE); INC DE
+    b.emit({0x22, 0x05});        // LD (HL+),A; DEC B
+    b.jr(0x20, oam);             // JR NZ,oam
+
+    b.emit({0x3E, 0xE4, 0xE0, 0x47, 0xE0, 0x48});  // BGP = OBP0 = $E4
+    b.emit({0x3E, 0x1B, 0xE0, 0x49});              // OBP1 = $1B
+    b.emit({0x3E, 0x60, 0xE0, 0x4A});              // WY = 96
+    b.emit({0x3E, 0x57, 0xE0, 0x4B});              // WX = 87
+    b.emit({0x3E, 0xF7, 0xE0, 0x40});              // LCDC: on, window, 8x16 sprites, BG
+
+    if (poll_ly) {
+        uint16_t frame = b.here();
+        uint16_t wait_vblank = b.here();
+        b.emit({0xF0, 0x44, 0xFE, 0x90});        // LDH A,(LY); CP 144
+        b.jr(0x20, wait_vblank);                 // JR NZ,wait_vblank
+        b.emit({0xF0, 0x43, 0x3C, 0xE0, 0x43});  // LDH A,(SCX); INC A; LDH (SCX),A
+        uint16_t wait_line = b.here();
+        b.emit({0xF0, 0x44, 0xFE, 0x90});        // LDH A,(LY); CP 144
+        b.jr(0x28, wait_line);                   // JR Z,wait_line
+        b.jr(0x18, frame);                       // JR frame
+    } else {
+        b.emit({0x3E, 0x01, 0xE0, 0xFF});        // IE = VBlank
+        b.emit({0xAF, 0xE0, 0x0F});              // IF = 0
+        b.emit({0xFB});                          // EI
+
+        uint16_t idle = b.here();
+        b.emit({0x76, 0x00});                    // HALT; NOP
+        b.jr(0x18, idle);                        // JR idle
+    }
+
+    // 40 sprites in four rows of ten, overlapping a little, with every
+    // combination of flips and both palettes
+    b.org(0x1000);
+    for (int i = 0; i < 40; i++) {
+        uint8_t y = static_cast<uint8_t>(16 + (i / 10) * 36);
+        uint8_t x = static_cast<uint8_t>(8 + (i % 10) * 14 + (i / 10) * 3);
+        uint8_t tile = static_cast<uint8_t>(i * 2);
+        uint8_t attrs = static_cast<uint8_t>(((i & 3) << 5) | ((i & 4) << 2));
+        b.emit({y, x, tile, attrs});
+    }
+
+    return b.finish("BENCH SPRITES");
+}
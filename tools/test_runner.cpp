@@ -0,0 +1,268 @@
+// Test ROM runner: runs blargg and mooneye test ROMs headless, in parallel,
+// and reports which passed. Meant to be run after every change to the CPU or
+// anything else on the emulation path.
+//
+// Usage: gb-test-runner [options] <rom>...
+//   --list=FILE      Also run the ROMs listed in FILE, one path per line
+//   --timeout=N      Give up on a ROM after N emulated cycles (default 120
+//                    emulated seconds)
+//   --jobs=N         Worker threads (default: one per core)
+//   --format=F       text (default), csv or json
+//   --verbose        Print each ROM's serial output after the results
+//
+// A ROM has finished when either
+//   - its serial output contains "Passed" or "Failed" (blargg), or
+//   - B, C, D, E, H, L hold the Fibonacci numbers 3, 5, 8, 13, 21, 34
+//     (mooneye pass) or are all 0x42 (mooneye fail). Mooneye tests also send
+//     those six bytes over serial, which is checked as well.
+// The result is checked once per emulated frame.
+
+#include "emulator.hpp"
+#include "cpu.hpp"
+#include "serial.hpp"
+#include "log.hpp"
+#include "tool_util.hpp"
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+constexpr uint64_t DEFAULT_TIMEOUT_CYCLES = 120ull * 4194304;
+
+enum class Outcome { PASSED, FAILED, TIMEOUT, ERROR };
+
+static const char* outcomeName(Outcome outcome) {
+    switch (outcome) {
+        case Outcome::PASSED: return "passed";
+        case Outcome::FAILED: return "failed";
+        case Outcome::TIMEOUT: return "timeout";
+        default: return "error";
+    }
+}
+
+struct TestOptions {
+    std::vector<std::string> roms;
+    uint64_t timeout_cycles = DEFAULT_TIMEOUT_CYCLES;
+    unsigned jobs = 0;  // 0 = hardware concurrency
+    std::string format = "text";
+    bool verbose = false;
+};
+
+struct TestResult {
+    Outcome outcome = Outcome::ERROR;
+    std::string detail;   // Last line of serial output, or what went wrong
+    std::string output;   // Everything sent over serial
+    uint64_t cycles = 0;
+    double wall_ms = 0.0;
+};
+
+// Mooneye's result signature in B, C, D, E, H, L
+static const uint8_t MOONEYE_PASS[6] = {3, 5, 8, 13, 21, 34};
+static const uint8_t MOONEYE_FAIL[6] = {0x42, 0x42, 0x42, 0x42, 0x42, 0x42};
+
+static bool matches(const uint8_t* values, const uint8_t* signature) {
+    for (int i = 0; i < 6; i++) {
+        if (values[i] != signature[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool outputEndsWith(const std::string& output, const uint8_t* signature) {
+    return output.size() >= 6 && matches(reinterpret_cast<const uint8_t*>(output.data() + output.size() - 6), signature);
+}
+
+// Whether the ROM has reported a result yet
+static bool checkFinished(Emulator& emulator, Outcome& outcome) {
+    const std::string& output = emulator.getSerial().getOutput();
+    if (output.find("Failed") != std::string::npos || outputEndsWith(output, MOONEYE_FAIL)) {
+        outcome = Outcome::FAILED;
+        return true;
+    }
+    if (output.find("Passed") != std::string::npos || outputEndsWith(output, MOONEYE_PASS)) {
+        outcome = Outcome::PASSED;
+        return true;
+    }
+
+    const CPU& cpu = emulator.getCPU();
+    uint8_t registers[6] = {
+        static_cast<uint8_t>(cpu.getRegisterBC() >> 8), static_cast<uint8_t>(cpu.getRegisterBC()),
+        static_cast<uint8_t>(cpu.getRegisterDE() >> 8), static_cast<uint8_t>(cpu.getRegisterDE()),
+        static_cast<uint8_t>(cpu.getRegisterHL() >> 8), static_cast<uint8_t>(cpu.getRegisterHL()),
+    };
+    if (matches(registers, MOONEYE_PASS)) {
+        outcome = Outcome::PASSED;
+        return true;
+    }
+    if (matches(registers, MOONEYE_FAIL)) {
+        outcome = Outcome::FAILED;
+        return true;
+    }
+    return false;
+}
+
+// Last non-empty line of the serial output, printable characters only
+static std::string lastLine(const std::string& output) {
+    std::string line;
+    std::string current;
+    for (char c : output) {
+        if (c == '\n' || c == '\r') {
+            if (!current.empty()) {
+                line = current;
+            }
+            current.clear();
+        } else if (c >= 0x20 && c < 0x7F) {
+            current += c;
+        }
+    }
+    return current.empty() ? line : current;
+}
+
+static TestResult runTest(const std::string& path, const TestOptions& options) {
+    TestResult result;
+    auto start = std::chrono::steady_clock::now();
+
+    try {
+        Emulator emulator(path, false);
+        result.outcome = Outcome::TIMEOUT;
+
+        Outcome outcome;
+        while (emulator.getCycles() < options.timeout_cycles) {
+            if (!emulator.runFrame()) {
+                result.outcome = Outcome::ERROR;
+                result.detail = "cpu error";
+                break;
+            }
+            if (checkFinished(emulator, outcome)) {
+                result.outcome = outcome;
+                break;
+            }
+        }
+
+        result.cycles = emulator.getCycles();
+        result.output = emulator.getSerial().getOutput();
+        if (result.detail.empty()) {
+            result.detail = lastLine(result.output);
+        }
+    } catch (const std::exception& e) {
+        result.detail = e.what();
+    }
+
+    result.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+static void printResults(const TestOptions& options, const std::vector<TestResult>& results) {
+    if (options.format == "json") {
+        std::cout << "[\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const TestResult& r = results[i];
+            std::cout << "  {\"rom\": " << jsonString(options.roms[i])
+                      << ", \"result\": \"" << outcomeName(r.outcome) << "\""
+                      << ", \"cycles\": " << r.cycles
+                      << ", \"wall_ms\": " << r.wall_ms
+                      << ", \"detail\": " << jsonString(r.detail) << "}"
+                      << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        std::cout << "]" << std::endl;
+    } else if (options.format == "csv") {
+        std::cout << "rom,result,cycles,wall_ms,detail\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const TestResult& r = results[i];
+            std::cout << csvField(options.roms[i]) << "," << outcomeName(r.outcome) << ","
+                      << r.cycles << "," << r.wall_ms << "," << csvField(r.detail) << "\n";
+        }
+        std::cout.flush();
+    } else {
+        for (size_t i = 0; i < results.size(); i++) {
+            const TestResult& r = results[i];
+            std::cout << outcomeName(r.outcome) << "  " << options.roms[i];
+            if (r.outcome != Outcome::PASSED && !r.detail.empty()) {
+                std::cout << "  (" << r.detail << ")";
+            }
+            std::cout << "\n";
+        }
+        std::cout.flush();
+    }
+
+    if (options.verbose) {
+        for (size_t i = 0; i < results.size(); i++) {
+            std::cerr << "=== " << options.roms[i] << "\n" << results[i].output << "\n";
+        }
+    }
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <rom>..." << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --list=FILE   Also run the ROMs listed in FILE, one per line" << std::endl;
+    std::cerr << "  --timeout=N   Emulated cycles before a ROM times out (default 120 s worth)" << std::endl;
+    std::cerr << "  --jobs=N      Worker threads (default: one per core)" << std::endl;
+    std::cerr << "  --format=F    Output format: text (default), csv or json" << std::endl;
+    std::cerr << "  --verbose     Print every ROM's serial output" << std::endl;
+}
+
+static bool parseOptions(int argc, char** argv, TestOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        try {
+            if (arg.rfind("--list=", 0) == 0) {
+                if (!readRomList(arg.substr(7), options.roms)) {
+                    return false;
+                }
+            } else if (arg.rfind("--timeout=", 0) == 0) {
+                options.timeout_cycles = std::stoull(arg.substr(10));
+            } else if (arg.rfind("--jobs=", 0) == 0) {
+                options.jobs = static_cast<unsigned>(std::stoul(arg.substr(7)));
+            } else if (arg == "--format=text" || arg == "--format=csv" || arg == "--format=json") {
+                options.format = arg.substr(9);
+            } else if (arg == "--verbose") {
+                options.verbose = true;
+            } else if (arg.rfind("--", 0) == 0) {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return false;
+            } else {
+                options.roms.push_back(arg);
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid number in: " << arg << std::endl;
+            return false;
+        }
+    }
+
+    if (options.jobs == 0) {
+        options.jobs = defaultJobs();
+    }
+    return !options.roms.empty();
+}
+
+int main(int argc, char** argv) {
+    TestOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    setLogMask(0);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<TestResult> results(options.roms.size());
+    parallelFor(options.roms.size(), options.jobs, [&](size_t i) {
+        results[i] = runTest(options.roms[i], options);
+    });
+    double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    printResults(options, results);
+
+    size_t passed = 0;
+    for (const TestResult& r : results) {
+        passed += r.outcome == Outcome::PASSED;
+    }
+    std::cerr << passed << "/" << results.size() << " passed in " << wall_ms << " ms" << std::endl;
+
+    return passed == results.size() ? 0 : 1;
+}
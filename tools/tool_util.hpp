@@ -0,0 +1,92 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Helpers shared by the command line tools that run many ROMs at once.
+
+// One worker per core
+inline unsigned defaultJobs() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Call fn(i) for every i in [0, count) on up to `jobs` threads, the calling
+// thread included. Workers claim the next index from a shared counter, so a
+// thread that drew short jobs just takes more of them
+template <typename Fn>
+void parallelFor(size_t count, unsigned jobs, Fn fn) {
+    std::atomic<size_t> next{0};
+    auto worker = [&] {
+        for (size_t i = next++; i < count; i = next++) {
+            fn(i);
+        }
+    };
+
+    unsigned threads_wanted = static_cast<unsigned>(std::min<size_t>(jobs, count));
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < threads_wanted; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// Append the ROM paths listed in a file, one per line (blank lines skipped)
+inline bool readRomList(const std::string& path, std::vector<std::string>& roms) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open ROM list: " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty()) {
+            roms.push_back(line);
+        }
+    }
+    return true;
+}
+
+// Quote a CSV field if it needs it
+inline std::string csvField(const std::string& value) {
+    if (value.find_first_of(",\"\n") == std::string::npos) {
+        return value;
+    }
+    std::string quoted = "\"";
+    for (char c : value) {
+        if (c == '"') {
+            quoted += '"';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// A JSON string literal
+inline std::string jsonString(const std::string& value) {
+    std::string quoted = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escape[7];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            quoted += escape;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}